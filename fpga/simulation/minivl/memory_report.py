@@ -0,0 +1,94 @@
+"""Lists the memories of an elaborated design with an estimate of their Cyclone V M10K blocks.
+
+Not a Quartus fitter report: every array read only by clocked processes is assumed to become
+M10K, and arrays read combinationally (which M10K cannot do) are counted as logic. The blocks
+are given for the cheapest simple dual-port configuration and for 8K x 1 slices, the deepest
+one, which Quartus may pick to avoid output multiplexers. Small memories may go to MLABs.
+
+Usage: python3 memory_report.py [-GNAME=value] --top-module pdi_sim_top files.v...
+"""
+import math
+import os
+import sys
+
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from velab import Design, Gen  # noqa: E402
+from vparse import parse_file  # noqa: E402
+
+# Depth x width configurations of one M10K (10240 bits) in simple dual-port mode
+M10K_CONFIGS = ((8192, 1), (4096, 2), (2048, 4), (1024, 8), (1024, 10), (512, 16), (512, 20),
+                (256, 32), (256, 40))
+M10K_DEVICE = 397  # 5CSEMA5F31C6
+
+
+def m10k_blocks(depth, width):
+    return min(math.ceil(depth / d) * math.ceil(width / w) for d, w in M10K_CONFIGS)
+
+
+def m10k_deep(depth, width):
+    return math.ceil(depth / 8192) * width
+
+
+def main(argv):
+    top = None
+    overrides = {}
+    files = []
+    i = 0
+    while i < len(argv):
+        if argv[i] == "--top-module":
+            i += 1
+            top = argv[i]
+        elif argv[i].startswith("-G"):
+            k, v = argv[i][2:].split("=", 1)
+            overrides[k] = int(v, 0)
+        else:
+            files.append(argv[i])
+        i += 1
+
+    modules = {}
+    for f in files:
+        modules.update(parse_file(f))
+    design = Design(modules)
+    design.elaborate(top, "", overrides)
+
+    # Arrays read by continuous assignments or always @(*) have an asynchronous read port
+    gen = Gen(design)
+    async_read = set()
+    for kind, payload in design.comb:
+        gen.reads, gen.writes = set(), set()
+        if kind == "assign":
+            lhs, lscope, rhs, rscope = payload
+            gen.assign(lhs, lscope, rhs, rscope, True, [], "")
+        else:
+            gen.stmt(payload[0], payload[1], [], "")
+        async_read |= gen.reads
+
+    total = 0
+    total_deep = 0
+    print(f"{'memory':<40} {'depth':>6} {'width':>5} {'bits':>8} {'M10K':>5} {'8Kx1':>5}")
+    for cname, sig in sorted(design.sigs.items()):
+        if not sig.dims:
+            continue
+        # Small arrays read combinationally become registers and multiplexers
+        if cname in async_read and sig.size * sig.width < 1024:
+            kind = "logic"
+            blocks = deep = 0
+        elif cname in async_read:
+            kind = "async read, not M10K"
+            blocks = deep = 0
+        else:
+            kind = ""
+            blocks = m10k_blocks(sig.size, sig.width)
+            deep = m10k_deep(sig.size, sig.width)
+        total += blocks
+        total_deep += deep
+        name = cname.replace("__", ".")
+        print(f"{name:<40} {sig.size:>6} {sig.width:>5} {sig.size * sig.width:>8} "
+              f"{blocks if blocks else '-':>5} {deep if deep else '-':>5} {kind}".rstrip())
+    print(f"Estimated M10K: {total} to {total_deep} of {M10K_DEVICE} "
+          f"({total / M10K_DEVICE:.0%} to {total_deep / M10K_DEVICE:.0%})")
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
@@ -0,0 +1,728 @@
+"""Flattening elaborator and C++ code generator for the subset parsed by vparse.
+
+Not Verilator: a small two-state cycle simulator that follows the IEEE 1364 expression sizing
+rules, blocking/nonblocking semantics and edge-triggered scheduling closely enough to run the
+synthesizable RTL of this project against the Verilator C++ interface used by spi_sim.cpp.
+"""
+import math
+
+
+class Sig:
+    """Storage of one flat net/variable; views (port aliases) share cname."""
+
+    def __init__(self, cname, width, signed, dims=None, lsb=0):
+        self.cname = cname
+        self.width = width
+        self.signed = signed
+        self.dims = dims or []  # list of (low, size)
+        self.lsb = lsb
+
+    @property
+    def size(self):
+        n = 1
+        for _, s in self.dims:
+            n *= s
+        return n
+
+
+class Func:
+    def __init__(self, cname, width, signed, inputs, decls, body, scope):
+        self.cname, self.width, self.signed = cname, width, signed
+        self.inputs, self.decls, self.body, self.scope = inputs, decls, body, scope
+
+
+class Scope:
+    def __init__(self, parent, prefix, module=None):
+        self.parent = parent
+        self.prefix = prefix
+        self.names = {}
+        self.module = module
+
+    def lookup(self, name):
+        s = self
+        while s is not None:
+            if name in s.names:
+                return s.names[name]
+            s = s.parent
+        raise KeyError(name)
+
+
+def ctype(width):
+    if width <= 8:
+        return "uint8_t"
+    if width <= 16:
+        return "uint16_t"
+    if width <= 32:
+        return "uint32_t"
+    if width <= 64:
+        return "uint64_t"
+    return "VW"
+
+
+def mask(w):
+    return (1 << w) - 1
+
+
+def clog2(v):
+    return 0 if v <= 1 else (v - 1).bit_length()
+
+
+class Design:
+    def __init__(self, modules):
+        self.modules = modules
+        self.sigs = {}          # cname -> Sig (storage)
+        self.comb = []          # ("assign", (lhs, lhs scope, rhs, rhs scope)) or ("block", ...)
+        self.seq = []           # ([(edge, cname)], stmt, scope)
+        self.funcs = []
+
+    # ------------------------------------------------------------ constants
+    def const(self, e, scope):
+        k = e[0]
+        if k == "num":
+            return e[1]
+        if k == "id":
+            v = scope.lookup(e[1])
+            if isinstance(v, int):
+                return v
+            raise ValueError(f"{e[1]} is not constant")
+        if k == "un":
+            v = self.const(e[2], scope)
+            return {"-": -v, "+": v, "!": int(not v), "~": ~v}[e[1]]
+        if k == "bin":
+            a, b = self.const(e[2], scope), self.const(e[3], scope)
+            op = e[1]
+            if op == "/":
+                return int(a / b)
+            if op == "%":
+                return int(math.fmod(a, b))
+            return {
+                "+": a + b, "-": a - b, "*": a * b, "**": a ** b, "<<": a << b, ">>": a >> b,
+                "<": int(a < b), "<=": int(a <= b), ">": int(a > b), ">=": int(a >= b),
+                "==": int(a == b), "!=": int(a != b), "&&": int(bool(a and b)),
+                "||": int(bool(a or b)), "&": a & b, "|": a | b, "^": a ^ b,
+            }[op]
+        if k == "cond":
+            return self.const(e[2] if self.const(e[1], scope) else e[3], scope)
+        if k == "call" and e[1] == "$clog2":
+            return clog2(self.const(e[2][0], scope))
+        raise ValueError(f"not a constant expression: {e}")
+
+    # ------------------------------------------------------------ elaboration
+    def elaborate(self, modname, prefix, overrides):
+        mod = self.modules[modname]
+        scope = Scope(None, prefix, mod)
+        # Parameters first, in order, with overrides applied to non-local ones
+        for it in mod["items"]:
+            if it[0] == "param":
+                _, name, e, local, rng, signed = it
+                if not local and name in overrides:
+                    scope.names[name] = overrides[name]
+                else:
+                    scope.names[name] = self.const(e, scope)
+        self.items(mod["items"], scope, prefix)
+        return scope
+
+    def declare(self, scope, prefix, name, width, signed, dims, lsb=0):
+        cname = (prefix + name).replace(".", "__")
+        sig = Sig(cname, width, signed, dims, lsb)
+        self.sigs[cname] = sig
+        scope.names[name] = sig
+        return sig
+
+    def items(self, items, scope, prefix):
+        # Declarations before use: functions, tasks and nets first
+        for it in items:
+            k = it[0]
+            if k == "decl":
+                _, kind, signed, rng, name, dims, init, direction = it
+                if name in scope.names and not isinstance(scope.names[name], int):
+                    continue
+                width, lsb = 1, 0
+                if rng is not None:
+                    msb, lsb = self.const(rng[0], scope), self.const(rng[1], scope)
+                    assert msb >= lsb, f"ascending vector range on {name}"
+                    width = msb - lsb + 1
+                d = []
+                for a, b in dims:
+                    a, b = self.const(a, scope), self.const(b, scope)
+                    d.append((min(a, b), abs(a - b) + 1))
+                self.declare(scope, prefix, name, width, signed, d, lsb)
+            elif k == "genvar":
+                scope.names[it[1]] = 0
+            elif k == "function":
+                _, fname, rng, signed, inputs, decls, body = it
+                width = 1
+                if rng is not None:
+                    width = self.const(rng[0], scope) - self.const(rng[1], scope) + 1
+                f = Func((prefix + fname).replace(".", "__"), width, signed, [], decls, body,
+                         scope)
+                for iname, irng, isigned in inputs:
+                    iw = 1
+                    if irng is not None:
+                        iw = self.const(irng[0], scope) - self.const(irng[1], scope) + 1
+                    f.inputs.append((iname, iw, isigned))
+                scope.names[fname] = f
+                self.funcs.append(f)
+            elif k == "task":
+                scope.names[it[1]] = ("task", it[2])
+        for it in items:
+            k = it[0]
+            if k == "decl":
+                init = it[6]
+                if init is not None:
+                    assert it[1] == "wire", f"variable initializer on {it[4]}"
+                    self.comb.append(("assign", (("id", it[4]), scope, init, scope)))
+            elif k == "cassign":
+                self.comb.append(("assign", (it[1], scope, it[2], scope)))
+            elif k == "always":
+                sens, stmt = it[1], it[2]
+                if sens == "*" or all(e is None for e, _ in sens):
+                    self.comb.append(("block", (stmt, scope)))
+                else:
+                    resolved = []
+                    for edge, name in sens:
+                        assert edge is not None, "mixed edge/level sensitivity"
+                        resolved.append((edge, scope.lookup(name).cname))
+                    self.seq.append((resolved, stmt, scope))
+            elif k == "initial":
+                raise NotImplementedError("initial blocks")
+            elif k == "genfor":
+                _, var, init, cond, step, label, body = it
+                v = self.const(init, scope)
+                while True:
+                    scope.names[var] = v
+                    if not self.const(cond, scope):
+                        break
+                    sub = Scope(scope, f"{prefix}{label}_{v}.")
+                    sub.names[var] = v
+                    self.items(body, sub, sub.prefix)
+                    v = self.const(step, scope)
+            elif k == "inst":
+                _, modname, params, iname, conns = it
+                mod = self.modules[modname]
+                overrides = {}
+                formal = [p[1] for p in mod["items"] if p[0] == "param" and not p[3]]
+                for i, (pname, e) in enumerate(params):
+                    overrides[pname if pname else formal[i]] = self.const(e, scope)
+                child_prefix = f"{prefix}{iname}."
+                child = Scope(None, child_prefix, mod)
+                for p in mod["items"]:
+                    if p[0] == "param":
+                        _, pn, pe, local, rng, signed = p
+                        child.names[pn] = overrides[pn] if (not local and pn in overrides) \
+                            else self.const(pe, child)
+                ports = {p[4]: p for p in mod["items"] if p[0] == "decl" and p[7]}
+                byname = {}
+                for i, (pname, e) in enumerate(conns):
+                    byname[pname if pname else mod["ports"][i]] = e
+                # Alias ports bound to whole parent nets of the same width
+                for pname, e in byname.items():
+                    p = ports[pname]
+                    if e is None or e[0] != "id":
+                        continue
+                    outer = scope.lookup(e[1])
+                    if isinstance(outer, int) or outer.dims:
+                        continue
+                    w = 1
+                    if p[3] is not None:
+                        w = self.const(p[3][0], child) - self.const(p[3][1], child) + 1
+                    if w == outer.width and outer.lsb == 0:
+                        child.names[pname] = Sig(outer.cname, w, p[2], [], 0)
+                self.items(mod["items"], child, child_prefix)
+                for pname, e in byname.items():
+                    if e is None:
+                        continue
+                    p = ports[pname]
+                    inner = child.names[pname]
+                    if e[0] == "id" and not isinstance(scope.lookup(e[1]), int) \
+                            and scope.lookup(e[1]).cname == inner.cname:
+                        continue
+                    if p[7] == "input":
+                        self.comb.append(("assign", (("id", pname), child, e, scope)))
+                    else:
+                        self.comb.append(("assign", (e, scope, ("id", pname), child)))
+
+
+# ====================================================================== code generation
+
+class Gen:
+    def __init__(self, design):
+        self.d = design
+        self.reads = None
+        self.writes = None
+        self.nba = set()
+        self.nba_mem = set()
+        self.blocking_in_seq = set()
+        self.tmp = 0
+
+    def newtmp(self):
+        self.tmp += 1
+        return f"_t{self.tmp}"
+
+    def note_read(self, cname):
+        if self.reads is not None:
+            self.reads.add(cname)
+
+    # ------------------------------------------------------------ self-determined types
+    def info(self, e, scope):
+        k = e[0]
+        if k == "num":
+            return (e[2] or 32, e[3])
+        if k == "id":
+            v = scope.lookup(e[1])
+            if isinstance(v, int):
+                return (32, True)
+            return (v.width, v.signed)
+        if k == "index":
+            sig, idxs = self.mem_path(e, scope)
+            if sig is not None and len(idxs) == len(sig.dims):
+                return (sig.width, sig.signed)
+            return (1, False)
+        if k == "range":
+            return (self.d.const(e[2], scope) - self.d.const(e[3], scope) + 1, False)
+        if k == "ipart":
+            return (self.d.const(e[3], scope), False)
+        if k == "un":
+            if e[1] in ("-", "~", "+"):
+                return self.info(e[2], scope)
+            return (1, False)
+        if k == "bin":
+            op = e[1]
+            if op in ("<", "<=", ">", ">=", "==", "!=", "===", "!==", "&&", "||"):
+                return (1, False)
+            if op in ("<<", ">>", "<<<", ">>>", "**"):
+                return self.info(e[2], scope)
+            (wa, sa), (wb, sb) = self.info(e[2], scope), self.info(e[3], scope)
+            return (max(wa, wb), sa and sb)
+        if k == "cond":
+            (wa, sa), (wb, sb) = self.info(e[2], scope), self.info(e[3], scope)
+            return (max(wa, wb), sa and sb)
+        if k == "concat":
+            return (sum(self.info(p, scope)[0] for p in e[1]), False)
+        if k == "repl":
+            n = self.d.const(e[1], scope)
+            return (n * sum(self.info(p, scope)[0] for p in e[2]), False)
+        if k == "call":
+            if e[1] == "$clog2":
+                return (32, True)
+            f = scope.lookup(e[1])
+            return (f.width, f.signed)
+        raise NotImplementedError(k)
+
+    def mem_path(self, e, scope):
+        """For index chains rooted at an array, returns (sig, [index expressions])."""
+        idxs = []
+        while e[0] == "index":
+            idxs.append(e[2])
+            e = e[1]
+        if e[0] != "id":
+            return None, None
+        v = scope.lookup(e[1])
+        if isinstance(v, int) or not v.dims:
+            return None, None
+        idxs.reverse()
+        return v, idxs
+
+    # ------------------------------------------------------------ expressions
+    @staticmethod
+    def ext(code, w, s, W, S):
+        """Extends a w-bit value to the context width W."""
+        if W > 64:
+            raise NotImplementedError("wide extension")
+        if W == w:
+            return code
+        if W < w:
+            return f"({code} & {hex(mask(W))}ULL)"
+        if S and s:
+            return f"sext({code}, {w}, {W})"
+        return code
+
+    def mem_index(self, sig, idxs, scope):
+        """Flat index code and bounds check of an array element."""
+        parts = []
+        checks = []
+        stride = 1
+        strides = []
+        for low, size in reversed(sig.dims):
+            strides.append(stride)
+            stride *= size
+        strides.reverse()
+        for (low, size), ie, st in zip(sig.dims, idxs, strides):
+            try:
+                c = self.d.const(ie, scope) - low
+                if not 0 <= c < size:
+                    return None, None
+                parts.append(str(c * st))
+            except (ValueError, KeyError, NotImplementedError, TypeError):
+                w, s = self.info(ie, scope)
+                t = f"((uint64_t)({self.expr(ie, scope, max(w, 1), False)}) - {low}ULL)"
+                checks.append(f"{t} < {size}ULL")
+                parts.append(f"{t} * {st}" if st != 1 else t)
+        return " + ".join(parts) if parts else "0", " && ".join(checks)
+
+    def expr(self, e, scope, W, S):
+        """C++ code of e evaluated in a context of W bits (<= 64), masked to W bits."""
+        k = e[0]
+        if k == "num":
+            w = e[2] or 32
+            v = e[1] & mask(w)
+            if S and e[3] and w < W and (v >> (w - 1)) & 1:
+                v |= mask(W) ^ mask(w)
+            return f"{hex(v & mask(W))}ULL"
+        if k == "id":
+            v = scope.lookup(e[1])
+            if isinstance(v, int):
+                return self.expr(("num", v & mask(32), 32, True), scope, W, S)
+            assert not v.dims, f"whole array {e[1]} used as a value"
+            self.note_read(v.cname)
+            if v.width > 64:
+                return f"{v.cname}.lo({W})"
+            return self.ext(f"(uint64_t){v.cname}", v.width, v.signed, W, S)
+        if k == "index":
+            sig, idxs = self.mem_path(e, scope)
+            if sig is not None:
+                self.note_read(sig.cname)
+                extra = idxs[len(sig.dims):]
+                flat, check = self.mem_index(sig, idxs[:len(sig.dims)], scope)
+                if flat is None:
+                    code = "0ULL"
+                elif check:
+                    code = f"(({check}) ? (uint64_t){sig.cname}[{flat}] : 0ULL)"
+                else:
+                    code = f"(uint64_t){sig.cname}[{flat}]"
+                if not extra:
+                    return self.ext(code, sig.width, sig.signed, W, S)
+                assert len(extra) == 1
+                bit = self.expr(extra[0], scope, 64, False)
+                return f"(({code} >> ({bit} & 63)) & 1ULL)"
+            # Bit select of a vector
+            base = e[1]
+            bw, bs = self.info(base, scope)
+            lsb = 0
+            if base[0] == "id":
+                bsig = scope.lookup(base[1])
+                lsb = bsig.lsb
+                if bw > 64:
+                    self.note_read(bsig.cname)
+                    iw, _ = self.info(e[2], scope)
+                    return f"{bsig.cname}.get({self.expr(e[2], scope, max(iw, 1), False)}, 1)"
+            iw, _ = self.info(e[2], scope)
+            idx = self.expr(e[2], scope, max(iw, 32), False)
+            b = self.expr(base, scope, bw, False)
+            return f"bitsel({b}, {idx} - {lsb}ULL, {bw})"
+        if k in ("range", "ipart"):
+            base = e[1]
+            bw, bs = self.info(base, scope)
+            lsb = 0
+            if base[0] == "id":
+                lsb = scope.lookup(base[1]).lsb
+            if k == "range":
+                hi, lo = self.d.const(e[2], scope), self.d.const(e[3], scope)
+                w = hi - lo + 1
+                start = f"{lo - lsb}ULL"
+            else:
+                w = self.d.const(e[3], scope)
+                sw, _ = self.info(e[2], scope)
+                st = self.expr(e[2], scope, max(sw, 32), False)
+                if e[4] == "+:":
+                    start = f"({st} - {lsb}ULL)"
+                else:
+                    start = f"({st} - {w - 1 + lsb}ULL)"
+            if bw > 64:
+                assert base[0] == "id"
+                sig = scope.lookup(base[1])
+                self.note_read(sig.cname)
+                return self.ext(f"{sig.cname}.get({start}, {w})", w, False, W, S)
+            b = self.expr(base, scope, bw, False)
+            return self.ext(f"partsel({b}, {start}, {w})", w, False, W, S)
+        if k == "un":
+            op = e[1]
+            if op == "+":
+                return self.expr(e[2], scope, W, S)
+            if op == "-":
+                return f"((0ULL - {self.expr(e[2], scope, W, S)}) & {hex(mask(W))}ULL)"
+            if op == "~":
+                return f"((~{self.expr(e[2], scope, W, S)}) & {hex(mask(W))}ULL)"
+            w, s = self.info(e[2], scope)
+            a = self.expr(e[2], scope, w, s)
+            code = {
+                "!": f"({a} == 0ULL)",
+                "&": f"({a} == {hex(mask(w))}ULL)",
+                "|": f"({a} != 0ULL)",
+                "^": f"(uint64_t)__builtin_parityll({a})",
+                "~&": f"({a} != {hex(mask(w))}ULL)",
+                "~|": f"({a} == 0ULL)",
+                "~^": f"(uint64_t)!__builtin_parityll({a})",
+                "^~": f"(uint64_t)!__builtin_parityll({a})",
+            }[op]
+            return f"(uint64_t){code}"
+        if k == "bin":
+            op = e[1]
+            m = f"{hex(mask(W))}ULL"
+            if op in ("+", "-", "*", "&", "|", "^", "~^", "^~"):
+                a = self.expr(e[2], scope, W, S)
+                b = self.expr(e[3], scope, W, S)
+                if op in ("~^", "^~"):
+                    return f"((~({a} ^ {b})) & {m})"
+                if op in ("&", "|", "^"):
+                    return f"({a} {op} {b})"
+                return f"(({a} {op} {b}) & {m})"
+            if op in ("/", "%"):
+                a = self.expr(e[2], scope, W, S)
+                b = self.expr(e[3], scope, W, S)
+                fn = ("sdiv" if op == "/" else "smod") if S else ("udiv" if op == "/" else "umod")
+                return f"{fn}({a}, {b}, {W})"
+            if op in ("<", "<=", ">", ">=", "==", "!=", "===", "!=="):
+                (wa, sa), (wb, sb) = self.info(e[2], scope), self.info(e[3], scope)
+                wc, sc = max(wa, wb), sa and sb
+                cop = {"===": "==", "!==": "!="}.get(op, op)
+                if wc > 64:
+                    raise NotImplementedError("wide compare")
+                a = self.expr(e[2], scope, wc, sc)
+                b = self.expr(e[3], scope, wc, sc)
+                if sc:
+                    return f"(uint64_t)(sval({a}, {wc}) {cop} sval({b}, {wc}))"
+                return f"(uint64_t)({a} {cop} {b})"
+            if op in ("&&", "||"):
+                (wa, sa), (wb, sb) = self.info(e[2], scope), self.info(e[3], scope)
+                a = self.expr(e[2], scope, wa, sa)
+                b = self.expr(e[3], scope, wb, sb)
+                return f"(uint64_t)(({a} != 0ULL) {op} ({b} != 0ULL))"
+            if op in ("<<", ">>", "<<<", ">>>"):
+                a = self.expr(e[2], scope, W, S)
+                wb, _ = self.info(e[3], scope)
+                b = self.expr(e[3], scope, wb, False)
+                if op in ("<<", "<<<"):
+                    return f"shl({a}, {b}, {W})"
+                if op == ">>>" and S:
+                    return f"sshr({a}, {b}, {W})"
+                return f"shr({a}, {b})"
+            raise NotImplementedError(op)
+        if k == "cond":
+            cw, cs = self.info(e[1], scope)
+            c = self.expr(e[1], scope, cw, cs)
+            t = self.expr(e[2], scope, W, S)
+            f = self.expr(e[3], scope, W, S)
+            return f"(({c} != 0ULL) ? {t} : {f})"
+        if k in ("concat", "repl"):
+            parts = e[1] if k == "concat" else e[2]
+            n = 1 if k == "concat" else self.d.const(e[1], scope)
+            total, _ = self.info(e, scope)
+            assert total <= 64, "wide concatenation outside an assignment to a wide variable"
+            codes = []
+            off = 0
+            for _ in range(n):
+                for p in reversed(parts):
+                    pw, ps = self.info(p, scope)
+                    codes.append(f"({self.expr(p, scope, pw, False)} << {off})" if off else
+                                 self.expr(p, scope, pw, False))
+                    off += pw
+            return self.ext("(" + " | ".join(codes) + ")", total, False, W, S)
+        if k == "call":
+            f = scope.lookup(e[1])
+            args = []
+            for (iname, iw, isg), a in zip(f.inputs, e[2]):
+                aw, asg = self.info(a, scope)
+                cw = max(aw, iw)
+                args.append(f"({self.expr(a, scope, cw, asg)} & {hex(mask(iw))}ULL)")
+            return self.ext(f"{f.cname}({', '.join(args)})", f.width, f.signed, W, S)
+        raise NotImplementedError(k)
+
+    def wide_expr(self, e, scope, W):
+        """C++ code of type VW for contexts wider than 64 bits (unsigned only)."""
+        k = e[0]
+        if k == "id":
+            v = scope.lookup(e[1])
+            self.note_read(v.cname)
+            if v.width > 64:
+                return v.cname
+            return f"VW({self.expr(e, scope, v.width, False)})"
+        if k == "num":
+            return f"VW({hex(e[1])}ULL)"
+        if k == "concat":
+            code = None
+            off = 0
+            for p in reversed(e[1]):
+                pw, _ = self.info(p, scope)
+                assert pw <= 64
+                part = f"VW({self.expr(p, scope, pw, False)}).shl({off})"
+                code = part if code is None else f"{code}.bor({part})"
+                off += pw
+            return code
+        if k == "bin" and e[1] == "<<":
+            wb, _ = self.info(e[3], scope)
+            return f"{self.wide_expr(e[2], scope, W)}.shl({self.expr(e[3], scope, wb, False)})"
+        if k == "bin" and e[1] in ("|", "&"):
+            fn = "bor" if e[1] == "|" else "band"
+            return f"{self.wide_expr(e[2], scope, W)}.{fn}({self.wide_expr(e[3], scope, W)})"
+        raise NotImplementedError(f"wide {k}")
+
+    # ------------------------------------------------------------ statements
+    def target(self, sig, blocking):
+        if blocking:
+            return sig.cname
+        self.nba.add(sig.cname)
+        return sig.cname + "__n"
+
+    def assign(self, lhs, lscope, rhs, rscope, blocking, out, ind):
+        if lhs[0] == "id":
+            sig = lscope.lookup(lhs[1])
+            if self.writes is not None:
+                self.writes.add(sig.cname)
+            rw, rs = self.info(rhs, rscope)
+            W = max(sig.width, rw)
+            tgt = self.target(sig, blocking)
+            if sig.width > 64:
+                out.append(f"{ind}{tgt} = {self.wide_expr(rhs, rscope, W)}.trunc({sig.width});")
+                return
+            val = self.expr(rhs, rscope, W, rs)
+            if W > sig.width:
+                val = f"({val} & {hex(mask(sig.width))}ULL)"
+            out.append(f"{ind}{tgt} = ({ctype(sig.width)}){val};")
+            return
+        if lhs[0] in ("index", "range", "ipart"):
+            msig, idxs = self.mem_path(lhs, lscope) if lhs[0] == "index" else (None, None)
+            if msig is not None:
+                assert len(idxs) == len(msig.dims), "bit select of an array element"
+                if self.writes is not None:
+                    self.writes.add(msig.cname)
+                flat, check = self.mem_index(msig, idxs, lscope)
+                if flat is None:
+                    return
+                rw, rs = self.info(rhs, rscope)
+                W = max(msig.width, rw)
+                val = self.expr(rhs, rscope, W, rs)
+                val = f"({ctype(msig.width)})({val} & {hex(mask(msig.width))}ULL)"
+                if blocking:
+                    stmt = f"{msig.cname}[{flat}] = {val};"
+                else:
+                    self.nba_mem.add(msig.cname)
+                    stmt = f"{msig.cname}__q.push({flat}, {val});"
+                if check:
+                    out.append(f"{ind}if ({check}) {stmt}")
+                else:
+                    out.append(f"{ind}{stmt}")
+                return
+            base = lhs[1]
+            assert base[0] == "id", "nested select on the left-hand side"
+            sig = lscope.lookup(base[1])
+            assert sig.width <= 64
+            if self.writes is not None:
+                self.writes.add(sig.cname)
+            if lhs[0] == "index":
+                w = 1
+                iw, _ = self.info(lhs[2], lscope)
+                start = f"({self.expr(lhs[2], lscope, max(iw, 32), False)} - {sig.lsb}ULL)"
+            elif lhs[0] == "range":
+                hi, lo = self.d.const(lhs[2], lscope), self.d.const(lhs[3], lscope)
+                w = hi - lo + 1
+                start = f"{lo - sig.lsb}ULL"
+            else:
+                w = self.d.const(lhs[3], lscope)
+                sw, _ = self.info(lhs[2], lscope)
+                st = self.expr(lhs[2], lscope, max(sw, 32), False)
+                start = f"({st} - {sig.lsb}ULL)" if lhs[4] == "+:" else \
+                    f"({st} - {w - 1 + sig.lsb}ULL)"
+            rw, rs = self.info(rhs, rscope)
+            val = self.expr(rhs, rscope, max(w, rw), rs)
+            tgt = self.target(sig, blocking)
+            out.append(f"{ind}{tgt} = ({ctype(sig.width)})partset({tgt}, {start}, {w}, "
+                       f"{val}, {sig.width});")
+            return
+        raise NotImplementedError(f"lhs {lhs[0]}")
+
+    def stmt(self, s, scope, out, ind):
+        k = s[0]
+        if k == "null":
+            return
+        if k == "block":
+            for x in s[1]:
+                self.stmt(x, scope, out, ind)
+            return
+        if k == "assign":
+            self.assign(s[1], scope, s[2], scope, s[3], out, ind)
+            return
+        if k == "if":
+            cw, cs = self.info(s[1], scope)
+            out.append(f"{ind}if ({self.expr(s[1], scope, cw, cs)} != 0ULL) {{")
+            self.stmt(s[2], scope, out, ind + "\t")
+            if s[3] is not None:
+                out.append(f"{ind}}} else {{")
+                self.stmt(s[3], scope, out, ind + "\t")
+            out.append(f"{ind}}}")
+            return
+        if k == "case":
+            widths = [self.info(s[1], scope)]
+            for labels, _ in s[2]:
+                for l in labels or []:
+                    widths.append(self.info(l, scope))
+            wc = max(w for w, _ in widths)
+            sc = all(x for _, x in widths)
+            t = self.newtmp()
+            out.append(f"{ind}{{ const uint64_t {t} = {self.expr(s[1], scope, wc, sc)};")
+            first = True
+            default = None
+            for labels, body in s[2]:
+                if labels is None:
+                    default = body
+                    continue
+                conds = " || ".join(f"{t} == {self.expr(l, scope, wc, sc)}" for l in labels)
+                out.append(f"{ind}{'if' if first else '} else if'} ({conds}) {{")
+                self.stmt(body, scope, out, ind + "\t")
+                first = False
+            if default is not None:
+                if first:
+                    out.append(f"{ind}{{")
+                else:
+                    out.append(f"{ind}}} else {{")
+                self.stmt(default, scope, out, ind + "\t")
+                out.append(f"{ind}}}")
+            elif not first:
+                out.append(f"{ind}}}")
+            out.append(f"{ind}}}")
+            return
+        if k == "taskcall":
+            task = scope.lookup(s[1])
+            assert isinstance(task, tuple) and task[0] == "task"
+            self.stmt(task[1], scope, out, ind)
+            return
+        if k == "for":
+            _, init, cond, step, body = s
+            self.stmt(init, scope, out, ind)
+            cw, cs = self.info(cond, scope)
+            out.append(f"{ind}for (int _guard = 0; {self.expr(cond, scope, cw, cs)} != 0ULL;"
+                       f" _guard++) {{")
+            self.stmt(body, scope, out, ind + "\t")
+            self.stmt(step, scope, out, ind + "\t")
+            out.append(f"{ind}}}")
+            return
+        raise NotImplementedError(k)
+
+    # ------------------------------------------------------------ functions
+    def function(self, f):
+        fs = Scope(f.scope, f.cname + ".")
+        out = []
+        params = []
+        for iname, iw, isg in f.inputs:
+            sig = Sig(f"a_{iname}", iw, isg)
+            fs.names[iname] = sig
+            params.append(f"uint64_t a_{iname}")
+        ret = Sig("ret", f.width, f.signed)
+        fs.names[f.cname.split("__")[-1]] = ret
+        # Local declarations of the function
+        for it in f.decls:
+            if it[0] == "decl":
+                _, kind, signed, rng, name, dims, init, direction = it
+                width = 1
+                if rng is not None:
+                    width = self.d.const(rng[0], f.scope) - self.d.const(rng[1], f.scope) + 1
+                fs.names[name] = Sig(f"l_{name}", width, signed)
+                out.append(f"\t{ctype(width)} l_{name} = 0;")
+        saved = (self.reads, self.writes)
+        self.writes = None
+        body = []
+        self.stmt(f.body, fs, body, "\t")
+        self.writes = saved[1]
+        lines = [f"uint64_t {f.cname}({', '.join(params)}) {{", f"\tuint64_t ret = 0;"]
+        lines += out + body + ["\treturn ret;", "}"]
+        return lines
@@ -0,0 +1,13 @@
+// Minimal stand-in for the Verilator runtime header used by minivl models
+#pragma once
+#include <cstdint>
+
+class VerilatedContext {
+public:
+	void timeInc(uint64_t add) { m_time += add; }
+	uint64_t time() const { return m_time; }
+	void commandArgs(int, char **) {}
+
+private:
+	uint64_t m_time = 0;
+};
@@ -0,0 +1,310 @@
+"""Emits the Verilator-compatible C++ model (V<top>.h / V<top>.cpp) of a flattened design."""
+import sys
+
+from velab import Design, Gen, ctype, mask
+from vparse import parse_file
+
+RUNTIME = r"""
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+
+static inline uint64_t vmask(int w) { return w >= 64 ? ~0ULL : ((1ULL << w) - 1); }
+static inline uint64_t sext(uint64_t v, int from, int to)
+{
+	if (from < 64 && ((v >> (from - 1)) & 1)) v |= ~vmask(from);
+	return v & vmask(to);
+}
+static inline int64_t sval(uint64_t v, int w) { return (int64_t)sext(v, w, 64); }
+static inline uint64_t shl(uint64_t a, uint64_t n, int w) { return n >= 64 ? 0 : (a << n) & vmask(w); }
+static inline uint64_t shr(uint64_t a, uint64_t n) { return n >= 64 ? 0 : a >> n; }
+static inline uint64_t sshr(uint64_t a, uint64_t n, int w)
+{
+	return (uint64_t)(sval(a, w) >> (n >= 63 ? 63 : n)) & vmask(w);
+}
+static inline uint64_t udiv(uint64_t a, uint64_t b, int w) { return b ? (a / b) & vmask(w) : 0; }
+static inline uint64_t umod(uint64_t a, uint64_t b, int w) { return b ? (a % b) & vmask(w) : 0; }
+static inline uint64_t sdiv(uint64_t a, uint64_t b, int w)
+{
+	return b ? (uint64_t)(sval(a, w) / sval(b, w)) & vmask(w) : 0;
+}
+static inline uint64_t smod(uint64_t a, uint64_t b, int w)
+{
+	return b ? (uint64_t)(sval(a, w) % sval(b, w)) & vmask(w) : 0;
+}
+static inline uint64_t bitsel(uint64_t v, uint64_t i, int w) { return i < (uint64_t)w ? (v >> i) & 1 : 0; }
+static inline uint64_t partsel(uint64_t v, uint64_t lo, int w) { return lo >= 64 ? 0 : (v >> lo) & vmask(w); }
+static inline uint64_t partset(uint64_t old, uint64_t lo, int w, uint64_t val, int total)
+{
+	uint64_t out = old;
+	for (int i = 0; i < w; i++) {
+		uint64_t b = lo + i;
+		if (b < (uint64_t)total) out = (out & ~(1ULL << b)) | (((val >> i) & 1) << b);
+	}
+	return out;
+}
+
+struct VW {
+	uint64_t w[4];
+	VW() { memset(w, 0, sizeof(w)); }
+	VW(uint64_t v) { memset(w, 0, sizeof(w)); w[0] = v; }
+	VW shl(uint64_t n) const
+	{
+		VW r;
+		if (n >= 256) return r;
+		int q = n / 64, s = n % 64;
+		for (int i = 3; i >= q; i--) {
+			uint64_t v = w[i - q] << s;
+			if (s && i - q - 1 >= 0) v |= w[i - q - 1] >> (64 - s);
+			r.w[i] = v;
+		}
+		return r;
+	}
+	VW bor(const VW &o) const { VW r; for (int i = 0; i < 4; i++) r.w[i] = w[i] | o.w[i]; return r; }
+	VW band(const VW &o) const { VW r; for (int i = 0; i < 4; i++) r.w[i] = w[i] & o.w[i]; return r; }
+	VW trunc(int bits) const
+	{
+		VW r = *this;
+		for (int i = 0; i < 4; i++) {
+			int lo = i * 64;
+			if (bits <= lo) r.w[i] = 0;
+			else if (bits < lo + 64) r.w[i] &= vmask(bits - lo);
+		}
+		return r;
+	}
+	uint64_t get(uint64_t lo, int width) const
+	{
+		uint64_t v = 0;
+		for (int i = 0; i < width; i++) {
+			uint64_t b = lo + i;
+			if (b < 256) v |= ((w[b / 64] >> (b % 64)) & 1) << i;
+		}
+		return v;
+	}
+	uint64_t lo(int width) const { return w[0] & vmask(width); }
+	bool operator!=(const VW &o) const { return memcmp(w, o.w, sizeof(w)) != 0; }
+};
+
+template <typename T, int N> struct MemQ {
+	int n = 0;
+	uint64_t idx[N];
+	T val[N];
+	void push(uint64_t i, T v)
+	{
+		if (n == N) { fprintf(stderr, "minivl: NBA queue overflow\n"); return; }
+		idx[n] = i;
+		val[n] = v;
+		n++;
+	}
+};
+"""
+
+
+def tarjan(nodes, succ):
+    index = {}
+    low = {}
+    onstack = set()
+    stack = []
+    out = []
+    counter = [0]
+    sys.setrecursionlimit(100000)
+
+    def visit(v):
+        index[v] = low[v] = counter[0]
+        counter[0] += 1
+        stack.append(v)
+        onstack.add(v)
+        for w in succ[v]:
+            if w not in index:
+                visit(w)
+                low[v] = min(low[v], low[w])
+            elif w in onstack:
+                low[v] = min(low[v], index[w])
+        if low[v] == index[v]:
+            comp = []
+            while True:
+                w = stack.pop()
+                onstack.discard(w)
+                comp.append(w)
+                if w == v:
+                    break
+            out.append(sorted(comp))
+
+    for v in nodes:
+        if v not in index:
+            visit(v)
+    out.reverse()
+    return out
+
+
+def generate(files, top, overrides, outdir):
+    modules = {}
+    for f in files:
+        modules.update(parse_file(f))
+    d = Design(modules)
+    top_scope = d.elaborate(top, "", overrides)
+    g = Gen(d)
+
+    ports = [(p, top_scope.lookup(p)) for p in modules[top]["ports"]]
+    port_names = {s.cname for _, s in ports}
+
+    # Combinational nodes with their reads and writes
+    nodes = []
+    for kind, payload in d.comb:
+        g.reads, g.writes = set(), set()
+        code = []
+        if kind == "assign":
+            lhs, lscope, rhs, rscope = payload
+            g.assign(lhs, lscope, rhs, rscope, True, code, "\t")
+        else:
+            stmt, scope = payload
+            g.stmt(stmt, scope, code, "\t")
+        nodes.append((code, g.reads, g.writes))
+    g.reads = g.writes = None
+
+    writers = {}
+    for i, (_, _, w) in enumerate(nodes):
+        for c in w:
+            writers.setdefault(c, []).append(i)
+    succ = {i: set() for i in range(len(nodes))}
+    for j, (_, r, _) in enumerate(nodes):
+        for c in r:
+            for i in writers.get(c, []):
+                if i != j:
+                    succ[i].add(j)
+    order = tarjan(list(range(len(nodes))), succ)
+
+    # Sequential blocks
+    seq_code = []
+    g.nba = set()
+    g.nba_mem = set()
+    edges = []
+    for sens, stmt, scope in d.seq:
+        code = []
+        g.stmt(stmt, scope, code, "\t\t")
+        conds = []
+        for edge, cname in sens:
+            if (edge, cname) not in edges:
+                edges.append((edge, cname))
+            conds.append(f"e_{edge}_{cname}")
+        seq_code.append((" || ".join(conds), code))
+    edge_sigs = sorted({c for _, c in edges})
+
+    funcs = []
+    for f in d.funcs:
+        funcs += g.function(f)
+
+    cls = f"V{top}"
+    h = ["#pragma once", RUNTIME, '#include "verilated.h"', "", f"class {cls} {{", "public:"]
+    for pname, s in ports:
+        h.append(f"\t{ctype(s.width)} {s.cname};")
+    h.append("")
+    h.append(f"\t{cls}(VerilatedContext *context = nullptr, const char *name = \"TOP\");")
+    h.append(f"\t~{cls}();")
+    h.append("\tvoid eval();")
+    h.append("\tvoid final() {}")
+    h.append("")
+    h.append("private:")
+    for cname, s in sorted(d.sigs.items()):
+        if cname in port_names:
+            continue
+        if s.dims:
+            h.append(f"\t{ctype(s.width)} {cname}[{s.size}];")
+        else:
+            h.append(f"\t{ctype(s.width)} {cname};")
+    for cname in sorted(g.nba):
+        s = d.sigs[cname]
+        h.append(f"\t{ctype(s.width)} {cname}__n;")
+    for cname in sorted(g.nba_mem):
+        s = d.sigs[cname]
+        h.append(f"\tMemQ<{ctype(s.width)}, 16> {cname}__q;")
+    for c in edge_sigs:
+        h.append(f"\tuint8_t p_{c};")
+    h.append("\tvoid settle();")
+    for line in funcs:
+        if line.startswith("uint64_t ") and line.endswith("{"):
+            h.append("\t" + line[:-2] + ";")
+    h.append("};")
+
+    cpp = [f'#include "{cls}.h"', "", f"{cls}::{cls}(VerilatedContext *, const char *)", "{"]
+    for cname, s in sorted(d.sigs.items()):
+        if s.width > 64:
+            continue
+        if s.dims:
+            cpp.append(f"\tmemset({cname}, 0, sizeof({cname}));")
+        else:
+            cpp.append(f"\t{cname} = 0;")
+    for c in edge_sigs:
+        cpp.append(f"\tp_{c} = 0;")
+    cpp.append("}")
+    cpp.append("")
+    cpp.append(f"{cls}::~{cls}() {{}}")
+    cpp.append("")
+    for line in funcs:
+        if line.startswith("uint64_t ") and line.endswith("{"):
+            line = line.replace("uint64_t ", f"uint64_t {cls}::", 1)
+        cpp.append(line)
+    cpp.append("")
+    cpp.append(f"void {cls}::settle()")
+    cpp.append("{")
+    cycles = 0
+    for comp in order:
+        if len(comp) == 1:
+            cpp += nodes[comp[0]][0]
+            continue
+        cycles += 1
+        written = sorted(set().union(*(nodes[i][2] for i in comp)))
+        cpp.append("\tfor (int _it = 0;; _it++) {")
+        for c in written:
+            s = d.sigs[c]
+            if s.dims:
+                cpp.append(f"\t\t{ctype(s.width)} s_{c}[{s.size}];")
+                cpp.append(f"\t\tmemcpy(s_{c}, {c}, sizeof(s_{c}));")
+            else:
+                cpp.append(f"\t\tconst auto s_{c} = {c};")
+        for i in comp:
+            cpp += ["\t" + l for l in nodes[i][0]]
+        same = []
+        for c in written:
+            s = d.sigs[c]
+            if s.dims:
+                same.append(f"memcmp(s_{c}, {c}, sizeof(s_{c})) == 0")
+            else:
+                same.append(f"!(s_{c} != {c})")
+        cpp.append(f"\t\tif ({' && '.join(same) or 'true'}) break;")
+        cpp.append("\t\tif (_it == 100) { fprintf(stderr, \"minivl: combinational loop does not"
+                   " settle\\n\"); break; }")
+        cpp.append("\t}")
+    cpp.append("}")
+    cpp.append("")
+    cpp.append(f"void {cls}::eval()")
+    cpp.append("{")
+    cpp.append("\tsettle();")
+    cpp.append("\tfor (int _loop = 0; _loop < 16; _loop++) {")
+    for edge, c in edges:
+        cond = f"{c} && !p_{c}" if edge == "pos" else f"!{c} && p_{c}"
+        cpp.append(f"\t\tconst bool e_{edge}_{c} = {cond};")
+    any_edge = " || ".join(f"e_{e}_{c}" for e, c in edges)
+    for c in edge_sigs:
+        cpp.append(f"\t\tp_{c} = {c};")
+    cpp.append(f"\t\tif (!({any_edge})) break;")
+    for c in sorted(g.nba):
+        cpp.append(f"\t\t{c}__n = {c};")
+    for cond, code in seq_code:
+        cpp.append(f"\t\tif ({cond}) {{")
+        cpp += code
+        cpp.append("\t\t}")
+    for c in sorted(g.nba):
+        cpp.append(f"\t\t{c} = {c}__n;")
+    for c in sorted(g.nba_mem):
+        cpp.append(f"\t\tfor (int i = 0; i < {c}__q.n; i++) {c}[{c}__q.idx[i]] = {c}__q.val[i];")
+        cpp.append(f"\t\t{c}__q.n = 0;")
+    cpp.append("\t\tsettle();")
+    cpp.append("\t}")
+    cpp.append("}")
+
+    with open(f"{outdir}/{cls}.h", "w") as f:
+        f.write("\n".join(h) + "\n")
+    with open(f"{outdir}/{cls}.cpp", "w") as f:
+        f.write("\n".join(cpp) + "\n")
+    return {"signals": len(d.sigs), "comb": len(nodes), "seq": len(d.seq), "loops": cycles}
@@ -0,0 +1,520 @@
+"""Lexer and parser for the synthesizable Verilog-2001 subset used by the RTL of this project."""
+import re
+
+KEYWORDS = {
+    "module", "endmodule", "input", "output", "inout", "reg", "wire", "integer", "signed",
+    "parameter", "localparam", "assign", "always", "initial", "begin", "end", "if", "else",
+    "case", "endcase", "default", "posedge", "negedge", "or", "function", "endfunction",
+    "task", "endtask", "generate", "endgenerate", "genvar", "for",
+}
+
+TOKEN_RE = re.compile(r"""
+    (?P<ws>\s+)
+  | (?P<lcomment>//[^\n]*)
+  | (?P<bcomment>/\*.*?\*/)
+  | (?P<directive>`[a-zA-Z_]+[^\n]*)
+  | (?P<based>(?:\d[\d_]*)?\s*'\s*[sS]?[bBoOdDhH]\s*[0-9a-fA-FxXzZ_?]+)
+  | (?P<real>\d[\d_]*\.\d+)
+  | (?P<dec>\d[\d_]*)
+  | (?P<sysid>\$[a-zA-Z_][a-zA-Z0-9_]*)
+  | (?P<id>[a-zA-Z_][a-zA-Z0-9_$]*)
+  | (?P<op>\+:|-:|<<<|>>>|===|!==|==|!=|<=|>=|&&|\|\||<<|>>|~&|~\||~\^|\^~|\*\*|[-+*/%<>=!~&|^?:;,.()\[\]{}#@])
+""", re.S | re.X)
+
+
+class Tok:
+    __slots__ = ("kind", "val", "line")
+
+    def __init__(self, kind, val, line):
+        self.kind, self.val, self.line = kind, val, line
+
+    def __repr__(self):
+        return f"{self.kind}:{self.val}@{self.line}"
+
+
+def parse_number(text):
+    text = text.replace("_", "").replace(" ", "")
+    if "'" not in text:
+        return ("num", int(text), None, True)
+    size, rest = text.split("'")
+    signed = False
+    if rest[0] in "sS":
+        signed = True
+        rest = rest[1:]
+    base = {"b": 2, "o": 8, "d": 10, "h": 16}[rest[0].lower()]
+    digits = re.sub(r"[xXzZ?]", "0", rest[1:])
+    value = int(digits, base)
+    width = int(size) if size else None
+    if width is not None:
+        value &= (1 << width) - 1
+    return ("num", value, width, signed)
+
+
+def lex(src, fname):
+    toks = []
+    pos = 0
+    line = 1
+    while pos < len(src):
+        m = TOKEN_RE.match(src, pos)
+        if not m:
+            raise SyntaxError(f"{fname}:{line}: bad character {src[pos]!r}")
+        kind = m.lastgroup
+        text = m.group(kind)
+        if kind == "based" or kind == "dec":
+            toks.append(Tok("num", parse_number(text), line))
+        elif kind == "id":
+            toks.append(Tok("kw" if text in KEYWORDS else "id", text, line))
+        elif kind == "sysid":
+            toks.append(Tok("id", text, line))
+        elif kind == "op":
+            toks.append(Tok("op", text, line))
+        elif kind == "directive":
+            if not text.startswith("`timescale"):
+                raise SyntaxError(f"{fname}:{line}: unsupported directive {text}")
+        elif kind == "real":
+            raise SyntaxError(f"{fname}:{line}: real numbers are not supported")
+        line += text.count("\n")
+        pos = m.end()
+    toks.append(Tok("eof", None, line))
+    return toks
+
+
+# Expression nodes are tuples:
+#   ("num", value, width|None, signed)   ("id", name)   ("index", base, idx)
+#   ("range", base, msb, lsb)   ("ipart", base, start, width, "+:"|"-:")
+#   ("un", op, e)   ("bin", op, l, r)   ("cond", c, t, f)   ("concat", [e])
+#   ("repl", count, [e])   ("call", name, [args])
+# Statements:
+#   ("block", [s])  ("if", c, t, f|None)  ("case", e, [(labels|None, s)])
+#   ("assign", lhs, rhs, blocking)  ("taskcall", name)  ("null",)
+#   ("for", init, cond, step, body)
+
+BINARY_PREC = [
+    ["||"],
+    ["&&"],
+    ["|"],
+    ["^", "~^", "^~"],
+    ["&"],
+    ["==", "!=", "===", "!=="],
+    ["<", "<=", ">", ">="],
+    ["<<", ">>", "<<<", ">>>"],
+    ["+", "-"],
+    ["*", "/", "%"],
+    ["**"],
+]
+
+
+class Parser:
+    def __init__(self, toks, fname):
+        self.toks = toks
+        self.i = 0
+        self.fname = fname
+
+    @property
+    def tok(self):
+        return self.toks[self.i]
+
+    def error(self, msg):
+        raise SyntaxError(f"{self.fname}:{self.tok.line}: {msg} (at {self.tok.val!r})")
+
+    def peek(self, val, off=0):
+        t = self.toks[self.i + off]
+        return t.val == val and t.kind in ("op", "kw")
+
+    def accept(self, val):
+        if self.peek(val):
+            self.i += 1
+            return True
+        return False
+
+    def expect(self, val):
+        if not self.accept(val):
+            self.error(f"expected {val!r}")
+
+    def ident(self):
+        t = self.tok
+        if t.kind != "id":
+            self.error("expected identifier")
+        self.i += 1
+        return t.val
+
+    # ---------------------------------------------------------------- expressions
+    def expr(self):
+        c = self.binary(0)
+        if self.accept("?"):
+            t = self.expr()
+            self.expect(":")
+            f = self.expr()
+            return ("cond", c, t, f)
+        return c
+
+    def binary(self, level):
+        if level == len(BINARY_PREC):
+            return self.unary()
+        left = self.binary(level + 1)
+        while self.tok.kind == "op" and self.tok.val in BINARY_PREC[level]:
+            op = self.tok.val
+            self.i += 1
+            right = self.binary(level + 1)
+            left = ("bin", op, left, right)
+        return left
+
+    def unary(self):
+        t = self.tok
+        if t.kind == "op" and t.val in ("!", "~", "-", "+", "&", "|", "^", "~&", "~|", "~^", "^~"):
+            self.i += 1
+            return ("un", t.val, self.unary())
+        return self.primary()
+
+    def primary(self):
+        t = self.tok
+        if t.kind == "num":
+            self.i += 1
+            e = t.val
+        elif self.accept("("):
+            e = self.expr()
+            self.expect(")")
+        elif self.accept("{"):
+            first = self.expr()
+            if self.accept("{"):
+                parts = [self.expr()]
+                while self.accept(","):
+                    parts.append(self.expr())
+                self.expect("}")
+                self.expect("}")
+                e = ("repl", first, parts)
+            else:
+                parts = [first]
+                while self.accept(","):
+                    parts.append(self.expr())
+                self.expect("}")
+                e = ("concat", parts)
+        elif t.kind == "id":
+            name = self.ident()
+            if self.accept("("):
+                args = []
+                if not self.peek(")"):
+                    args.append(self.expr())
+                    while self.accept(","):
+                        args.append(self.expr())
+                self.expect(")")
+                e = ("call", name, args)
+            else:
+                e = ("id", name)
+        else:
+            self.error("expected expression")
+        return self.selects(e)
+
+    def selects(self, e):
+        while self.accept("["):
+            a = self.expr()
+            if self.accept(":"):
+                b = self.expr()
+                e = ("range", e, a, b)
+            elif self.peek("+:") or self.peek("-:"):
+                op = self.tok.val
+                self.i += 1
+                w = self.expr()
+                e = ("ipart", e, a, w, op)
+            else:
+                e = ("index", e, a)
+            self.expect("]")
+        return e
+
+    def lvalue(self):
+        if self.accept("{"):
+            parts = [self.lvalue()]
+            while self.accept(","):
+                parts.append(self.lvalue())
+            self.expect("}")
+            return ("concat", parts)
+        return self.selects(("id", self.ident()))
+
+    # ---------------------------------------------------------------- statements
+    def statement(self):
+        if self.accept(";"):
+            return ("null",)
+        if self.accept("begin"):
+            if self.accept(":"):
+                self.ident()
+            stmts = []
+            while not self.accept("end"):
+                stmts.append(self.statement())
+            return ("block", stmts)
+        if self.accept("if"):
+            self.expect("(")
+            c = self.expr()
+            self.expect(")")
+            t = self.statement()
+            f = self.statement() if self.accept("else") else None
+            return ("if", c, t, f)
+        if self.accept("case"):
+            self.expect("(")
+            e = self.expr()
+            self.expect(")")
+            items = []
+            while not self.accept("endcase"):
+                if self.accept("default"):
+                    self.accept(":")
+                    items.append((None, self.statement()))
+                else:
+                    labels = [self.expr()]
+                    while self.accept(","):
+                        labels.append(self.expr())
+                    self.expect(":")
+                    items.append((labels, self.statement()))
+            return ("case", e, items)
+        if self.accept("for"):
+            self.expect("(")
+            init = self.simple_assign()
+            self.expect(";")
+            cond = self.expr()
+            self.expect(";")
+            step = self.simple_assign()
+            self.expect(")")
+            return ("for", init, cond, step, self.statement())
+        # Task call or assignment
+        if self.tok.kind == "id" and self.toks[self.i + 1].val == ";":
+            name = self.ident()
+            self.expect(";")
+            return ("taskcall", name)
+        s = self.simple_assign()
+        self.expect(";")
+        return s
+
+    def simple_assign(self):
+        lhs = self.lvalue()
+        if self.accept("<="):
+            return ("assign", lhs, self.expr(), False)
+        self.expect("=")
+        return ("assign", lhs, self.expr(), True)
+
+    # ---------------------------------------------------------------- declarations
+    def opt_range(self):
+        if self.accept("["):
+            msb = self.expr()
+            self.expect(":")
+            lsb = self.expr()
+            self.expect("]")
+            return (msb, lsb)
+        return None
+
+    def array_dims(self):
+        dims = []
+        while self.accept("["):
+            a = self.expr()
+            self.expect(":")
+            b = self.expr()
+            self.expect("]")
+            dims.append((a, b))
+        return dims
+
+    def param_list(self, local):
+        # parameter [signed] [range] NAME = expr {, NAME = expr}
+        out = []
+        self.accept("integer")
+        signed = self.accept("signed")
+        rng = self.opt_range()
+        while True:
+            name = self.ident()
+            self.expect("=")
+            out.append(("param", name, self.expr(), local, rng, signed))
+            if self.peek(",") and self.toks[self.i + 1].kind == "id" and self.toks[self.i + 2].val == "=":
+                self.i += 1
+                continue
+            break
+        return out
+
+    def module(self):
+        self.expect("module")
+        name = self.ident()
+        items = []
+        ports = []
+        if self.accept("#"):
+            self.expect("(")
+            while not self.accept(")"):
+                self.expect("parameter")
+                items += self.param_list(False)
+                self.accept(",")
+        if self.accept("("):
+            while not self.accept(")"):
+                direction = self.tok.val
+                if direction not in ("input", "output", "inout"):
+                    self.error("expected ANSI port declaration")
+                self.i += 1
+                kind = "reg" if self.accept("reg") else "wire"
+                self.accept("wire")
+                signed = self.accept("signed")
+                rng = self.opt_range()
+                while True:
+                    pname = self.ident()
+                    ports.append(pname)
+                    items.append(("decl", kind, signed, rng, pname, [], None, direction))
+                    if self.peek(",") and self.toks[self.i + 1].kind == "id":
+                        self.i += 1
+                        continue
+                    break
+                self.accept(",")
+        self.expect(";")
+        items += self.module_items("endmodule")
+        return {"name": name, "ports": ports, "items": items}
+
+    def module_items(self, terminator):
+        items = []
+        while not self.accept(terminator):
+            items += self.module_item()
+        return items
+
+    def module_item(self):
+        t = self.tok
+        if self.accept("parameter") or self.accept("localparam"):
+            out = self.param_list(t.val == "localparam")
+            self.expect(";")
+            return out
+        if t.val in ("reg", "wire", "integer") and t.kind == "kw":
+            self.i += 1
+            kind = t.val
+            signed = self.accept("signed") or kind == "integer"
+            rng = self.opt_range()
+            if kind == "integer":
+                rng = (("num", 31, None, True), ("num", 0, None, True))
+            out = []
+            while True:
+                dname = self.ident()
+                dims = self.array_dims()
+                init = self.expr() if self.accept("=") else None
+                out.append(("decl", kind, signed, rng, dname, dims, init, None))
+                if not self.accept(","):
+                    break
+            self.expect(";")
+            return out
+        if self.accept("genvar"):
+            names = [self.ident()]
+            while self.accept(","):
+                names.append(self.ident())
+            self.expect(";")
+            return [("genvar", n) for n in names]
+        if self.accept("assign"):
+            out = []
+            while True:
+                lhs = self.lvalue()
+                self.expect("=")
+                out.append(("cassign", lhs, self.expr()))
+                if not self.accept(","):
+                    break
+            self.expect(";")
+            return out
+        if self.accept("always"):
+            self.expect("@")
+            sens = []
+            if self.accept("*"):
+                sens = "*"
+            else:
+                self.expect("(")
+                if self.accept("*"):
+                    sens = "*"
+                else:
+                    while True:
+                        edge = None
+                        if self.accept("posedge"):
+                            edge = "pos"
+                        elif self.accept("negedge"):
+                            edge = "neg"
+                        sens.append((edge, self.ident()))
+                        if not (self.accept("or") or self.accept(",")):
+                            break
+                self.expect(")")
+            return [("always", sens, self.statement())]
+        if self.accept("initial"):
+            return [("initial", self.statement())]
+        if self.accept("generate"):
+            return self.module_items("endgenerate")
+        if self.accept("for"):
+            self.expect("(")
+            var = self.ident()
+            self.expect("=")
+            init = self.expr()
+            self.expect(";")
+            cond = self.expr()
+            self.expect(";")
+            var2 = self.ident()
+            self.expect("=")
+            step = self.expr()
+            self.expect(")")
+            assert var == var2
+            self.expect("begin")
+            label = None
+            if self.accept(":"):
+                label = self.ident()
+            body = self.module_items("end")
+            return [("genfor", var, init, cond, step, label, body)]
+        if self.accept("function"):
+            signed = self.accept("signed")
+            rng = self.opt_range()
+            fname = self.ident()
+            self.expect(";")
+            inputs = []
+            decls = []
+            while self.peek("input") or self.peek("reg") or self.peek("integer"):
+                if self.accept("input"):
+                    self.accept("reg")
+                    s = self.accept("signed")
+                    r = self.opt_range()
+                    while True:
+                        inputs.append((self.ident(), r, s))
+                        if not self.accept(","):
+                            break
+                    self.expect(";")
+                else:
+                    decls += self.module_item()
+            body = self.statement()
+            self.expect("endfunction")
+            return [("function", fname, rng, signed, inputs, decls, body)]
+        if self.accept("task"):
+            tname = self.ident()
+            self.expect(";")
+            body = self.statement()
+            self.expect("endtask")
+            return [("task", tname, body)]
+        if t.kind == "id":
+            # Module instance
+            mod = self.ident()
+            params = []
+            if self.accept("#"):
+                self.expect("(")
+                while not self.accept(")"):
+                    if self.accept("."):
+                        pname = self.ident()
+                        self.expect("(")
+                        params.append((pname, self.expr()))
+                        self.expect(")")
+                    else:
+                        params.append((None, self.expr()))
+                    self.accept(",")
+            inst = self.ident()
+            self.expect("(")
+            conns = []
+            while not self.accept(")"):
+                if self.accept("."):
+                    pname = self.ident()
+                    self.expect("(")
+                    e = None if self.peek(")") else self.expr()
+                    self.expect(")")
+                    conns.append((pname, e))
+                else:
+                    conns.append((None, self.expr()))
+                self.accept(",")
+            self.expect(";")
+            return [("inst", mod, params, inst, conns)]
+        self.error("unexpected module item")
+
+
+def parse_file(fname):
+    with open(fname) as f:
+        src = f.read()
+    p = Parser(lex(src, fname), fname)
+    mods = {}
+    while p.tok.kind != "eof":
+        m = p.module()
+        mods[m["name"]] = m
+    return mods
@@ -0,0 +1,227 @@
+import argparse
+import glob
+import hashlib
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+# Golden-image regression of img_processing: every gesture image of hps/images and raspberry is
+# built into the host code (hps/Makefile, IMAGE=...), run through the FPGA side and checked
+# against pdi_baseline.json. Results and mask must match exactly; cycle counts may grow up to the
+# tolerance. The mask of the frame captured from the board (hps/fpga_return) is also checked.
+# sim (default) runs the RTL through pdi_sim_top with Verilator, or with minivl when Verilator is
+# not installed; emu runs the model in pdi_sw.c, whose cycles are not measured on the RTL.
+#
+# Usage: python3 pdi_regression.py [--transport sim|emu] [--tolerance 0.02] [--update]
+
+SIM_DIR = os.path.dirname(os.path.abspath(__file__))
+HPS_DIR = os.path.normpath(os.path.join(SIM_DIR, "..", "..", "..", "hps"))
+BASELINE = os.path.join(SIM_DIR, "pdi_baseline.json")
+DEFAULT_TOLERANCE = 0.02
+IMAGE_DIRS = (os.path.join(HPS_DIR, "images"),
+              os.path.normpath(os.path.join(HPS_DIR, "..", "raspberry")))
+MINIVL = os.path.normpath(os.path.join(SIM_DIR, "..", "minivl", "minivl"))
+
+# Masks read back from the FPGA (img_r_channel.txt of pdi.c, one character per pixel). The RGB
+# path does not binarize the last pixel, which the board capture predates, so it may differ.
+FPGA_MASKS = {"three_fingers_up": os.path.join(HPS_DIR, "fpga_return", "img_r_channel.txt")}
+FRAME_PIXELS = 240 * 320
+
+# Counters printed by pdi_print_cycles(), in the order of the "Ciclos do PDI" line
+STAGES = ("binarization", "morphology", "contour", "peaks", "total")
+RESULTS = ("classification", "area", "perimeter", "peaks", "mask_md5")
+
+sys.path.insert(0, HPS_DIR)
+from image_handling import write_image_c
+
+
+# Extra make variables, VERILATOR for the sim transport
+MAKE_VARS = []
+
+
+def make(transport, *args):
+    subprocess.run(["make", "-s", "TRANSPORT=" + transport, *MAKE_VARS, *args], cwd=HPS_DIR,
+                   check=True, stdout=subprocess.DEVNULL)
+
+
+def simulator():
+    # Verilator from VERILATOR or the PATH, minivl (not Verilator) when it is not installed
+    verilator = os.environ.get("VERILATOR", "verilator")
+    if shutil.which(verilator):
+        return verilator, "Verilator"
+    return MINIVL, "minivl (Verilator not found)"
+
+
+def find_images():
+    # Images by name; a copy with the same name must be the same file, so it is run once
+    images = {}
+    failures = []
+    for directory in IMAGE_DIRS:
+        for path in sorted(glob.glob(os.path.join(directory, "*.JPEG")) +
+                           glob.glob(os.path.join(directory, "*.jpg"))):
+            name = os.path.splitext(os.path.basename(path))[0]
+            if name not in images:
+                images[name] = path
+                continue
+            with open(path, "rb") as f, open(images[name], "rb") as g:
+                if f.read() != g.read():
+                    failures.append(f"{name}: {os.path.relpath(path, HPS_DIR)} differs from "
+                                    f"{os.path.relpath(images[name], HPS_DIR)}")
+    return images, failures
+
+
+def pixels(text):
+    # pdi.c breaks the lines at irregular places, only the character stream is the frame
+    return text.replace("\n", "")
+
+
+def compare_fpga_mask(name, mask):
+    # Checks the mask against the one read back from the board, except for the last pixel
+    with open(FPGA_MASKS[name]) as f:
+        golden = pixels(f.read())
+    mask = pixels(mask)
+    if len(mask) != len(golden):
+        return [f"{name}: mask has {len(mask)} pixels, FPGA capture {len(golden)}"]
+    diff = [i for i, (a, b) in enumerate(zip(mask, golden)) if a != b and i != FRAME_PIXELS - 1]
+    if diff:
+        return [f"{name}: {len(diff)} pixels differ from the FPGA capture, first at "
+                f"({diff[0] % 320}, {diff[0] // 320})"]
+    return []
+
+
+def run_image(transport, image_path):
+    # Builds the host code with the channels of image_path and parses its report
+    name = os.path.splitext(os.path.basename(image_path))[0]
+    source = "image_" + name + ".c"
+    target = os.path.join(HPS_DIR, "tcc_" + transport)
+    mask = os.path.join(HPS_DIR, "img_r_channel.txt")
+
+    write_image_c(image_path, os.path.join(HPS_DIR, source))
+    # The target only depends on the object timestamps, so a previous image would not relink
+    if os.path.exists(target):
+        os.remove(target)
+    make(transport, "IMAGE=" + source, "WINDOW=0", "FRAMES=1", "ROI=0")
+    output = subprocess.run([target], cwd=HPS_DIR, check=True, capture_output=True,
+                            text=True).stdout
+
+    result = {
+        "classification": re.search(r"Classification: (.+)", output).group(1).strip(),
+        "area": int(re.search(r"Hand area: (\d+)", output).group(1)),
+        "perimeter": int(re.search(r"Hand perimeter: (\d+)", output).group(1)),
+        "peaks": int(re.search(r"Hand peak: (\d+)", output).group(1)),
+    }
+    with open(mask) as f:
+        result["mask"] = f.read()
+    result["mask_md5"] = hashlib.md5(result["mask"].encode()).hexdigest()
+    os.remove(mask)
+
+    counters = re.search(r"Ciclos do PDI: binarizacao (\d+) \| morfologia (\d+) \| contorno (\d+)"
+                         r" \| picos/classificacao (\d+) \| total (\d+)", output)
+    result["cycles"] = dict(zip(STAGES, map(int, counters.groups())))
+
+    # Cycles with pdi_active seen by the co-simulation harness (spi_sim.cpp)
+    active = re.search(r"\[sim\] PDI 1: (\d+) ciclos com pdi_active", output)
+    if active:
+        result["cycles"]["pdi_active"] = int(active.group(1))
+
+    os.remove(os.path.join(HPS_DIR, source))
+    return name, result
+
+
+def compare(name, result, golden, tolerance):
+    # Returns the failures of one image against its golden entry
+    failures = []
+    for key in RESULTS:
+        if result[key] != golden[key]:
+            failures.append(f"{name}: {key} {result[key]} (golden {golden[key]})")
+
+    # The total is the hardware counter, the stages are contiguous so they must add up to it
+    stage_sum = sum(result["cycles"][stage] for stage in STAGES[:-1])
+    if stage_sum != result["cycles"]["total"]:
+        failures.append(f"{name}: stage cycles add up to {stage_sum}, "
+                        f"total counter {result['cycles']['total']}")
+    for stage, cycles in result["cycles"].items():
+        reference = golden["cycles"].get(stage)
+        if reference is None:
+            continue
+        if cycles > reference * (1 + tolerance):
+            failures.append(f"{name}: {stage} cycles {cycles} (golden {reference}, "
+                            f"+{(cycles - reference) / reference:.1%})")
+        elif cycles < reference:
+            print(f"  {name}: {stage} cycles improved to {cycles} (golden {reference}), "
+                  "run with --update to keep it")
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Golden-image regression of img_processing")
+    parser.add_argument("--transport", choices=("sim", "emu"), default="sim",
+                        help="sim -> co-simulation of the RTL (default), emu -> software model")
+    parser.add_argument("--tolerance", type=float, default=None,
+                        help="Allowed cycle growth (fraction), default from the baseline")
+    parser.add_argument("--update", action="store_true",
+                        help="Write the results as the new baseline of this transport")
+    args = parser.parse_args()
+
+    baseline = {"tolerance": DEFAULT_TOLERANCE}
+    if os.path.exists(BASELINE):
+        with open(BASELINE) as f:
+            baseline = json.load(f)
+    tolerance = args.tolerance if args.tolerance is not None else baseline["tolerance"]
+    golden = baseline.get(args.transport, {})
+
+    images, failures = find_images()
+    results = {}
+
+    if args.transport == "sim":
+        verilator, label = simulator()
+        MAKE_VARS.append("VERILATOR=" + verilator)
+        print(f"sim: {label}")
+
+    make(args.transport, "clean")
+    try:
+        for image_path in images.values():
+            name, result = run_image(args.transport, image_path)
+            mask = result.pop("mask")
+            results[name] = result
+            print(f"{name}: {result['classification']}, area {result['area']}, perimeter "
+                  f"{result['perimeter']}, peaks {result['peaks']}, "
+                  f"{result['cycles']['total']} cycles")
+
+            if name in FPGA_MASKS:
+                failures += compare_fpga_mask(name, mask)
+            if args.update:
+                continue
+            if name not in golden:
+                failures.append(f"{name}: no golden entry for transport {args.transport}")
+                continue
+            failures += compare(name, result, golden[name], tolerance)
+    finally:
+        make(args.transport, "clean")
+
+    if args.update:
+        # Only results that pass the FPGA capture and image checks become the reference
+        if failures:
+            for failure in failures:
+                print("FAIL " + failure)
+            print("Baseline not written")
+            return 1
+        baseline[args.transport] = results
+        with open(BASELINE, "w") as f:
+            json.dump(baseline, f, indent=4)
+            f.write("\n")
+        print(f"Baseline of {args.transport} written to {BASELINE}")
+        return 0
+
+    for failure in failures:
+        print("FAIL " + failure)
+    print(f"{len(images) - len({f.split(':')[0] for f in failures})}/{len(images)} images "
+          f"passed (tolerance {tolerance:.1%})")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,253 @@
+/*
+ * Module Name: pdi_sim_top.
+ *
+ * Description: SPI subsystem of top.v (spi_slave, data_transfer_controller, bram_controller
+ *              and img_processing) for the Verilator co-simulation of the HPS host code.
+ *
+ * Parameters:
+ *    FRAME_BANKS - Number of frame banks in bram_controller (1 or 2)
+ *    IMG_WIDTH - Width of the largest frame
+ *    IMG_HEIGHT - Height of the largest frame
+ *    CONTOUR_POINTS - Longest contour traced by img_processing
+ *    PEAK_CANDIDATES - Peak candidates kept by img_processing
+ *
+ * Inputs:
+ *    clk - Main clock signal (50 MHz on the board)
+ *    rst - Reset signal (active low)
+ *    ss - Chip select signal
+ *    mosi - Master out slave in signal
+ *    sck - Communication clock signal
+ *
+ * Outputs:
+ *    miso - Master in slave out signal
+ *    pdi_active - Signal that indicates when img_processing is active (the pdi_irq PIO)
+ *    cycles_binarization/morphology/contour/peaks - Clock cycles of each PDI stage
+ *    cycles_total - Clock cycles of the last PDI
+ *
+ * Functionality:
+ *    Same wiring as top.v for the SPI link, with the parameters of top.v as defaults. The
+ *    parallel link and hps_bram_window are left out: their inputs to data_transfer_controller
+ *    and bram_controller are tied low, so the host code runs the SPI protocol (WINDOW=0).
+ *    The cycle counters are also brought out so the harness can check them without the link.
+ */
+
+module pdi_sim_top #(
+	parameter FRAME_BANKS = 1,
+	parameter IMG_WIDTH = 320,
+	parameter IMG_HEIGHT = 240,
+	parameter CONTOUR_POINTS = 4096,
+	parameter PEAK_CANDIDATES = 256
+)(
+	input clk,
+	input rst,
+	input ss,
+	input mosi,
+	output miso,
+	input sck,
+	output pdi_active,
+	output [31:0] cycles_binarization,
+	output [31:0] cycles_morphology,
+	output [31:0] cycles_contour,
+	output [31:0] cycles_peaks,
+	output [31:0] cycles_total
+);
+
+	// SPI wires
+	wire spi_cycle_done;
+	wire [7:0] data_to_send;
+	wire [7:0] data_received;
+
+	// BRAM wires
+	wire com_we;
+	wire com_wstrobe;
+	wire com_sum_clear;
+	wire [1:0] bram_channel;
+	wire com_bank;
+	wire pdi_bank;
+	wire pdi_chroma;
+	wire [7:0] bram_data_in;
+	wire [7:0] bram_data_out;
+	wire [16:0] com_addr;
+	wire [16:0] pdi_addr_read;
+	wire com_mask;
+	wire pdi_mask_we;
+	wire [11:0] pdi_mask_addr_read;
+	wire [11:0] pdi_mask_addr_write;
+	wire [31:0] pdi_mask_data_in;
+	wire [31:0] pdi_mask_data_out;
+
+	// Image processing wires
+	wire pdi_done;
+	wire pdi_frame_busy;
+	wire [7:0] red_data_out;
+	wire [7:0] green_data_out;
+	wire [7:0] blue_data_out;
+	wire [24:0] red_sum;
+	wire [24:0] green_sum;
+	wire [24:0] blue_sum;
+	wire [16:0] hand_area;
+	wire [16:0] hand_perimeter;
+	wire [34:0] max_distance;
+	wire [9:0] peaks;
+	wire [3:0] classification;
+	wire [15:0] frame_height;
+	wire [15:0] frame_width;
+	wire [15:0] roi_y;
+	wire [15:0] roi_x;
+	wire [15:0] hand_box_left;
+	wire [15:0] hand_box_top;
+	wire [15:0] hand_box_right;
+	wire [15:0] hand_box_bottom;
+	wire [15:0] reference_point_x;
+	wire [15:0] reference_point_y;
+	wire [2:0] state;
+
+	img_processing #(
+		.IMG_WIDTH(IMG_WIDTH),
+		.CONTOUR_POINTS(CONTOUR_POINTS),
+		.PEAK_CANDIDATES(PEAK_CANDIDATES)
+	) img_proc (
+		.clk(clk),
+		.rst(rst),
+		.active(pdi_active),
+		.chroma(pdi_chroma),
+		.done(pdi_done),
+		.frame_busy(pdi_frame_busy),
+		.red_data_in(red_data_out),
+		.green_data_in(green_data_out),
+		.blue_data_in(blue_data_out),
+		.red_sum(red_sum),
+		.green_sum(green_sum),
+		.blue_sum(blue_sum),
+		.addr_read(pdi_addr_read),
+		.mask_we(pdi_mask_we),
+		.mask_addr_read(pdi_mask_addr_read),
+		.mask_addr_write(pdi_mask_addr_write),
+		.mask_data_out(pdi_mask_data_in),
+		.mask_data_in(pdi_mask_data_out),
+		.frame_height(frame_height),
+		.frame_width(frame_width),
+		.hand_area(hand_area),
+		.hand_perimeter(hand_perimeter),
+		.max_distance(max_distance),
+		.peaks(peaks),
+		.classification(classification),
+		.hand_box_left(hand_box_left),
+		.hand_box_top(hand_box_top),
+		.hand_box_right(hand_box_right),
+		.hand_box_bottom(hand_box_bottom),
+		.cycles_binarization(cycles_binarization),
+		.cycles_morphology(cycles_morphology),
+		.cycles_contour(cycles_contour),
+		.cycles_peaks(cycles_peaks),
+		.cycles_total(cycles_total),
+		.reference_point_x(reference_point_x),
+		.reference_point_y(reference_point_y)
+	);
+
+	bram_controller #(
+		.FRAME_BANKS(FRAME_BANKS),
+		.PIXELS(IMG_WIDTH * IMG_HEIGHT)
+	) bram_ctrl (
+		.clk(clk),
+		.com_addr(com_addr),
+		.pdi_addr_read(pdi_addr_read),
+		.channel(bram_channel),
+		.com_bank(com_bank),
+		.pdi_bank(pdi_bank),
+		.com_we(com_we),
+		.com_wstrobe(com_wstrobe),
+		.com_mask(com_mask),
+		.com_sum_clear(com_sum_clear),
+		.pdi_active(pdi_active),
+		.pdi_frame_busy(pdi_frame_busy),
+		.data_in(bram_data_in),
+		.mm_sel(1'b0),
+		.mm_addr(17'b0),
+		.mm_channel(2'b0),
+		.mm_bank(1'b0),
+		.mm_we(1'b0),
+		.mm_data_in(8'b0),
+		.mm_mask(1'b0),
+		.mm_sum_clear(1'b0),
+		.data_out(bram_data_out),
+		.red_data_out(red_data_out),
+		.green_data_out(green_data_out),
+		.blue_data_out(blue_data_out),
+		.red_sum(red_sum),
+		.green_sum(green_sum),
+		.blue_sum(blue_sum),
+		.pdi_mask_addr_read(pdi_mask_addr_read),
+		.pdi_mask_addr_write(pdi_mask_addr_write),
+		.pdi_mask_we(pdi_mask_we),
+		.pdi_mask_data_in(pdi_mask_data_in),
+		.pdi_mask_data_out(pdi_mask_data_out)
+	);
+
+	data_transfer_controller #(
+		.IMG_WIDTH(IMG_WIDTH),
+		.IMG_HEIGHT(IMG_HEIGHT)
+	) dtc (
+		.clk(clk),
+		.rst(rst),
+		.spi_cycle_done(spi_cycle_done),
+		.spi_byte_in(data_received),
+		.spi_byte_out(data_to_send),
+		.bram_addr(com_addr),
+		.bram_channel(bram_channel),
+		.bram_bank(com_bank),
+		.bram_we(com_we),
+		.bram_wstrobe(com_wstrobe),
+		.bram_sum_clear(com_sum_clear),
+		.bram_data_in(bram_data_in),
+		.bram_mask(com_mask),
+		.bram_data_out(bram_data_out),
+		.pdi_active(pdi_active),
+		.pdi_bank(pdi_bank),
+		.pdi_chroma(pdi_chroma),
+		.pdi_done(pdi_done),
+		.hps_pdi_start(1'b0),
+		.hps_pdi_bank(1'b0),
+		.hps_pdi_chroma(1'b0),
+		.hps_geometry_write(1'b0),
+		.hps_geometry_height(16'b0),
+		.hps_geometry_width(16'b0),
+		.frame_height(frame_height),
+		.frame_width(frame_width),
+		.hps_roi_write(1'b0),
+		.hps_roi_y(16'b0),
+		.hps_roi_x(16'b0),
+		.roi_y(roi_y),
+		.roi_x(roi_x),
+		.hand_area(hand_area),
+		.hand_perimeter(hand_perimeter),
+		.state(state),
+		.max_distance(max_distance),
+		.peaks(peaks),
+		.classification(classification),
+		.hand_box_left(hand_box_left),
+		.hand_box_top(hand_box_top),
+		.hand_box_right(hand_box_right),
+		.hand_box_bottom(hand_box_bottom),
+		.cycles_binarization(cycles_binarization),
+		.cycles_morphology(cycles_morphology),
+		.cycles_contour(cycles_contour),
+		.cycles_peaks(cycles_peaks),
+		.cycles_total(cycles_total),
+		.reference_point_x(reference_point_x),
+		.reference_point_y(reference_point_y)
+	);
+
+	spi_slave spi (
+		.clk(clk),
+		.rst(rst),
+		.ss(ss),
+		.mosi(mosi),
+		.miso(miso),
+		.sck(sck),
+		.done(spi_cycle_done),
+		.din(data_to_send),
+		.dout(data_received)
+	);
+
+endmodule
@@ -0,0 +1,52 @@
+/*
+ * Module Name: bram_candidate_storage.
+ *
+ * Description: Acts as a memory storing the peak candidates of the hand contour.
+ *
+ * Parameters:
+ *    DEPTH - Number of candidates
+ *    ADDR_WIDTH - Width of the addresses, at least enough for DEPTH entries
+ *    DATA_WIDTH - Width of a candidate (contour point and squared radial distance)
+ *
+ * Inputs:
+ *    clk - Main clock signal
+ *    addr_read - Address to read from the memory
+ *    addr_write - Address to write to the memory
+ *    we - Write enable signal
+ *    data_in - Input candidate signal
+ *
+ * Outputs:
+ *    data_out - Output candidate signal
+ *
+ * Functionality:
+ *    This module acts as a memory storing DEPTH candidates of DATA_WIDTH bits, inferred as
+ *    M10K (256 candidates of 48 bits take 2 blocks in the 256 x 40 mode).
+ *    It has two address inputs, one for reading and one for writing.
+ *    The data_out is always provided according to addr_read.
+ *    The data_in is written to the memory according to addr_write when we is high.
+ *    Addresses past the last entry are clamped to it.
+ */
+
+module bram_candidate_storage #(
+    parameter DEPTH = 256,
+    parameter ADDR_WIDTH = 9,
+    parameter DATA_WIDTH = 48
+)(
+    input clk,
+    input [ADDR_WIDTH - 1:0] addr_read,
+    input [ADDR_WIDTH - 1:0] addr_write,
+    input we,
+    input [DATA_WIDTH - 1:0] data_in,
+    output reg [DATA_WIDTH - 1:0] data_out
+);
+
+reg [DATA_WIDTH - 1:0] bram[DEPTH - 1:0];
+
+always @(negedge clk) begin
+    if (we) begin
+        bram[(addr_write < DEPTH) ? addr_write : DEPTH - 1] <= data_in;
+    end
+    data_out <= bram[(addr_read < DEPTH) ? addr_read : DEPTH - 1];
+end
+
+endmodule
@@ -1,129 +1,252 @@
 /*
  * Module Name: bram_controller.
  *
- * Description: Controls three BRAMS.
+ * Description: Controls the image BRAMs, three per frame bank, and the binary mask BRAM.
+ *
+ * Parameters:
+ *    FRAME_BANKS - Number of frame banks (1 or 2)
+ *    PIXELS - Number of pixels of the largest frame
  *
  * Inputs:
  *    clk - Main clock signal
  *    com_addr - Address for reading and writing memory sent by data_transfer_controler
  *    pdi_addr_read - Address for reading memory sent by pdi_processing
- *    pdi_addr_write - Address for writing memory sent by pdi_processing
  *    channel - Channel to write data (01:R, 10:G, 11:B)
+ *    com_bank - Frame bank accessed by data_transfer_controler
+ *    pdi_bank - Frame bank processed by img_processing
  *    com_we - Write enable signal sent by data_transfer_controler
- *    pdi_we - Write enable signal sent by pdi_processing
+ *    com_wstrobe - One cycle pulse for each new pixel written by data_transfer_controler
+ *    com_mask - Signal that makes data_transfer_controler read the mask instead of a channel
+ *    com_sum_clear - One cycle pulse that clears the sum of channel in com_bank (upload start)
  *    pdi_active - Signal that indicates when img_pocessing is active
+ *    pdi_frame_busy - Signal that indicates when img_pocessing still reads the RGB channels
  *    data_in - Input byte data signal sent by data_transfer_controler
- *    red_data_in - Input byte data for red channel sent by img_processing
- *    green_data_in - Input byte data for green channel sent by img_processing
- *    blue_data_in - Input byte data for blue channel sent by img_processing
+ *    mm_sel - Signal that gives the COM port to hps_bram_window instead of data_transfer_controler
+ *    mm_addr - Address for reading and writing memory sent by hps_bram_window
+ *    mm_channel - Channel to access sent by hps_bram_window (01:R, 10:G, 11:B)
+ *    mm_bank - Frame bank accessed by hps_bram_window
+ *    mm_we - Write enable signal sent by hps_bram_window
+ *    mm_data_in - Input byte data signal sent by hps_bram_window
+ *    mm_mask - Signal that makes hps_bram_window read the mask instead of a channel
+ *    mm_sum_clear - One cycle pulse that clears the three sums of mm_bank (upload start)
+ *    pdi_mask_addr_read - Mask word address for reading sent by img_processing
+ *    pdi_mask_addr_write - Mask word address for writing sent by img_processing
+ *    pdi_mask_we - Mask write enable signal sent by img_processing
+ *    pdi_mask_data_in - Mask word to be written sent by img_processing
  *
  * Outputs:
  *    data_out - Output byte data signal sent to data_transfer_controler
  *    red_data_out - Output byte data from red sent to img_processing
  *    green_data_out - Output byte data from green sent to img_processing
  *    blue_data_out - Output byte data from blue sent to img_processing
+ *    red_sum - Sum of the red pixels of the bank being processed
+ *    green_sum - Sum of the green pixels of the bank being processed
+ *    blue_sum - Sum of the blue pixels of the bank being processed
+ *    pdi_mask_data_out - Mask word sent to img_processing
  *
  * Functionality:
- *    This module has three BRAMs, one for each image channel.
- *    When PID is disabled, this mode works sequentially:
+ *    Each frame bank has three BRAMs, one for each image channel.
+ *    While img_processing reads the RGB channels (pdi_frame_busy), the bank selected by
+ *    pdi_bank belongs to it:
+ *      - Read-only operation, performed on all channels.
+ *    The binarized image goes to a single mask BRAM with one bit per pixel, which belongs to
+ *    img_processing while PDI is active (reading and writing at the same time) and is
+ *    read-only on the COM port otherwise, one byte (8 pixels) per access:
+ *      - Byte address a holds pixels 8a to 8a+7, lowest pixel in bit 0.
+ *    Every other bank is reached through the COM port, which works sequentially:
  *      - Performs write-only or read-only operation.
  *      - Operation performed only on one channel, defined in the channel input.
- *    When PDI is enabled, this module performs operations in parallel
- *      - Possibility of reading and writing at the same time.
- *      - Operation performed on all channels.
+ *      - The port is used by hps_bram_window while mm_sel is high, otherwise by
+ *        data_transfer_controler.
+ *      - COM accesses to the bank in use by img_processing are dropped (reads return its data).
+ *    The bank is released once the binarization is done, so a new frame can be uploaded
+ *    during the morphology and the feature extraction even with a single bank.
+ *    Every pixel written through the COM port is added to the sum of its bank and channel.
+ *    The sums are cleared at the start of each upload, signalled by data_transfer_controler
+ *    after the size bytes of a channel and by hps_bram_window on a write to its bank register,
+ *    so when PDI starts they hold the whole channel and img_processing skips the accumulation
+ *    pass. Clears of the bank in use by img_processing are dropped like its writes.
+ *    With two banks the host uploads frame N+1 while frame N is processed.
+ *    A 320 x 240 channel takes 75 M10K blocks, so two banks (450 blocks) do not fit in the
+ *    397 blocks of the 5CSEMA5; top.v sets FRAME_BANKS and PIXELS for the target device.
  */
 
-module bram_controller(
+module bram_controller #(
+    parameter FRAME_BANKS = 2,
+    parameter PIXELS = 76800
+)(
     input clk,
     input [16:0] com_addr,
     input [16:0] pdi_addr_read,
-    input [16:0] pdi_addr_write,
     input [1:0] channel,
+    input com_bank,
+    input pdi_bank,
     input com_we,
-    input pdi_we,
+    input com_wstrobe,
+    input com_mask,
+    input com_sum_clear,
     input pdi_active,
+    input pdi_frame_busy,
     input [7:0] data_in,
+    input mm_sel,
+    input [16:0] mm_addr,
+    input [1:0] mm_channel,
+    input mm_bank,
+    input mm_we,
+    input [7:0] mm_data_in,
+    input mm_mask,
+    input mm_sum_clear,
     output reg [7:0] data_out,
-    input [7:0] red_data_in,
-    input [7:0] green_data_in,
-    input [7:0] blue_data_in,
     output [7:0] red_data_out,
     output [7:0] green_data_out,
-    output [7:0] blue_data_out
+    output [7:0] blue_data_out,
+    output [24:0] red_sum,
+    output [24:0] green_sum,
+    output [24:0] blue_sum,
+    input [11:0] pdi_mask_addr_read,
+    input [11:0] pdi_mask_addr_write,
+    input pdi_mask_we,
+    input [31:0] pdi_mask_data_in,
+    output [31:0] pdi_mask_data_out
 );
 
-    reg red_we;
-    reg green_we;
-    reg blue_we;
-    reg [16:0] addr_read;
-    reg [16:0] addr_write;
+    // COM port source: HPS memory window or SPI data transfer controller
+    wire [16:0] port_addr = mm_sel ? mm_addr : com_addr;
+    wire [1:0] port_channel = mm_sel ? mm_channel : channel;
+    wire port_we = mm_sel ? mm_we : com_we;
+    wire [7:0] port_data_in = mm_sel ? mm_data_in : data_in;
+    // hps_bram_window writes one new pixel per cycle, data_transfer_controler holds we
+    wire port_wstrobe = mm_sel ? mm_we : com_wstrobe;
+    wire port_mask = mm_sel ? mm_mask : com_mask;
 
-    // wire [7:0] red_data_out;
-    // wire [7:0] green_data_out;
-    // wire [7:0] blue_data_out;
+    wire port_green = (port_channel == 2'b10);
+    wire port_blue = (port_channel == 2'b11);
+    wire port_red = !port_green && !port_blue;
 
-    // Siwth between PDI and COM modes
-    always @ (*) begin
-		if (pdi_active) begin
-			addr_read = pdi_addr_read;
-            addr_write = pdi_addr_write;
-		end
-		else begin
-			addr_read = com_addr;
-            addr_write = com_addr;
-		end
-	end
+    // With a single bank the bank bits are ignored and everything lands in bank 0
+    wire port_bank = (FRAME_BANKS > 1) ? (mm_sel ? mm_bank : com_bank) : 1'b0;
+    wire proc_bank = (FRAME_BANKS > 1) ? pdi_bank : 1'b0;
+    wire com_clear_bank = (FRAME_BANKS > 1) ? com_bank : 1'b0;
+    wire mm_clear_bank = (FRAME_BANKS > 1) ? mm_bank : 1'b0;
+
+    wire [7:0] bank_red_out [0:FRAME_BANKS - 1];
+    wire [7:0] bank_green_out [0:FRAME_BANKS - 1];
+    wire [7:0] bank_blue_out [0:FRAME_BANKS - 1];
+    wire [24:0] bank_red_sum [0:FRAME_BANKS - 1];
+    wire [24:0] bank_green_sum [0:FRAME_BANKS - 1];
+    wire [24:0] bank_blue_sum [0:FRAME_BANKS - 1];
+
+    // Channel outputs of the bank being processed
+    assign red_data_out = bank_red_out[proc_bank];
+    assign green_data_out = bank_green_out[proc_bank];
+    assign blue_data_out = bank_blue_out[proc_bank];
+    assign red_sum = bank_red_sum[proc_bank];
+    assign green_sum = bank_green_sum[proc_bank];
+    assign blue_sum = bank_blue_sum[proc_bank];
+
+    // Binary mask, byte lane port_addr[1:0] of word port_addr[13:2] on COM mode
+    wire [31:0] mask_out;
+
+    assign pdi_mask_data_out = mask_out;
+
+    bram_mask_storage #(
+        .WORDS((PIXELS + 31) / 32)
+    ) bram_mask (
+        .clk(clk),
+        .addr_read(pdi_active ? pdi_mask_addr_read : port_addr[13:2]),
+        .addr_write(pdi_mask_addr_write),
+        .we(pdi_active && pdi_mask_we),
+        .data_in(pdi_mask_data_in),
+        .data_out(mask_out)
+    );
 
     // Switch between channels on COM mode
     always @ (*) begin
-        case (channel)
-            2'b10 : begin  // green channel
-                red_we = 1'b0;
-                green_we = com_we;
-                blue_we = 1'b0;
-                data_out = green_data_out;
-            end
-            2'b11 : begin // blue channel
-                red_we = 1'b0;
-                green_we = 1'b0;
-                blue_we = com_we;
-                data_out = blue_data_out;
-            end
-            default : begin // red channel
-                red_we = com_we;
-                green_we = 1'b0;
-                blue_we = 1'b0;
-                data_out = red_data_out;
-            end
+        if (port_mask) data_out = mask_out[8 * port_addr[1:0] +: 8];
+        else case (port_channel)
+            2'b10 : data_out = bank_green_out[port_bank]; // green channel
+            2'b11 : data_out = bank_blue_out[port_bank];  // blue channel
+            default : data_out = bank_red_out[port_bank]; // red channel
         endcase
     end
 
     // BRAMs instances
-	bram_image_storage bram_image_red(
-		.clk(clk),
-        .addr_read(addr_read),
-		.addr_write(addr_write),
-		.we(red_we | pdi_we),
-		.data_in(data_in | red_data_in),
-		.data_out(red_data_out)
-	);
-
-    bram_image_storage bram_image_green(
-        .clk(clk),
-        .addr_read(addr_read),
-		.addr_write(addr_write),
-        .we(green_we | pdi_we),
-        .data_in(data_in | green_data_in),
-        .data_out(green_data_out)
-    );
+    genvar b;
+    generate
+        for (b = 0; b < FRAME_BANKS; b = b + 1) begin : bank
+            // Switch between PDI and COM modes
+            wire pdi_owner = pdi_frame_busy && (proc_bank == b);
+            wire com_owner = !pdi_owner && (port_bank == b);
+            wire [16:0] addr_read = pdi_owner ? pdi_addr_read : port_addr;
+            wire com_write = com_owner && port_we;
+            wire com_pixel = com_owner && port_wstrobe;
+            // Upload start: the SPI link clears one channel, the memory window the whole bank
+            wire com_clear = com_sum_clear && !pdi_owner && (com_clear_bank == b);
+            wire mm_clear = mm_sum_clear && !pdi_owner && (mm_clear_bank == b);
+            wire clear_red = mm_clear || (com_clear && channel != 2'b10 && channel != 2'b11);
+            wire clear_green = mm_clear || (com_clear && channel == 2'b10);
+            wire clear_blue = mm_clear || (com_clear && channel == 2'b11);
 
-    bram_image_storage bram_image_blue(
-        .clk(clk),
-        .addr_read(addr_read),
-		.addr_write(addr_write),
-        .we(blue_we | pdi_we),
-        .data_in(data_in | blue_data_in),
-        .data_out(blue_data_out)
-    );
+            // Channel sums for the mean calculation
+            reg [24:0] red_acumulator;
+            reg [24:0] green_acumulator;
+            reg [24:0] blue_acumulator;
+
+            assign bank_red_sum[b] = red_acumulator;
+            assign bank_green_sum[b] = green_acumulator;
+            assign bank_blue_sum[b] = blue_acumulator;
+
+            always @ (posedge clk) begin
+                if (clear_red) begin
+                    red_acumulator <= 25'd0;
+                end else if (com_pixel && port_red) begin
+                    red_acumulator <= red_acumulator + port_data_in;
+                end
+                if (clear_green) begin
+                    green_acumulator <= 25'd0;
+                end else if (com_pixel && port_green) begin
+                    green_acumulator <= green_acumulator + port_data_in;
+                end
+                if (clear_blue) begin
+                    blue_acumulator <= 25'd0;
+                end else if (com_pixel && port_blue) begin
+                    blue_acumulator <= blue_acumulator + port_data_in;
+                end
+            end
+
+            bram_image_storage #(
+                .PIXELS(PIXELS)
+            ) bram_image_red (
+                .clk(clk),
+                .addr_read(addr_read),
+                .addr_write(port_addr),
+                .we(com_write && port_red),
+                .data_in(port_data_in),
+                .data_out(bank_red_out[b])
+            );
+
+            bram_image_storage #(
+                .PIXELS(PIXELS)
+            ) bram_image_green (
+                .clk(clk),
+                .addr_read(addr_read),
+                .addr_write(port_addr),
+                .we(com_write && port_green),
+                .data_in(port_data_in),
+                .data_out(bank_green_out[b])
+            );
+
+            bram_image_storage #(
+                .PIXELS(PIXELS)
+            ) bram_image_blue (
+                .clk(clk),
+                .addr_read(addr_read),
+                .addr_write(port_addr),
+                .we(com_write && port_blue),
+                .data_in(port_data_in),
+                .data_out(bank_blue_out[b])
+            );
+        end
+    endgenerate
 
-endmodule
\ No newline at end of file
+endmodule
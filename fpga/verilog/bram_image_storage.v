@@ -1,7 +1,10 @@
 /*
  * Module Name: bram_image_storage.
  *
- * Description: Acts as a memory storing 76800 bytes.
+ * Description: Acts as a memory storing PIXELS bytes.
+ *
+ * Parameters:
+ *    PIXELS - Number of pixels of the largest frame (up to 131072, the 17 bit address space)
  *
  * Inputs:
  *    clk - Main clock signal
@@ -14,14 +17,16 @@
  *    data_out - Output byte data signal
  *
  * Functionality:
- *    This module acts as a memory storing 76800 bytes.
+ *    This module acts as a memory storing PIXELS bytes.
  *    It has two address inputs, one for reading and one for writing. 
  *    The data_out is always provided according to addr_read.
  *    The data_in is written to the memory according to addr_write when we is high.
  *    The data_in is written to the memory addr_wire position when we is high.
  */
 
-module bram_image_storage(
+module bram_image_storage #(
+    parameter PIXELS = 76800
+)(
     input clk,
     input [16:0] addr_read,
     input [16:0] addr_write,
@@ -30,13 +35,13 @@ module bram_image_storage(
     output reg [7:0] data_out
 );
 
-reg [7:0] bram[76799:0];
+reg [7:0] bram[PIXELS - 1:0];
 
 always @(negedge clk) begin
     if (we) begin
-        bram[(addr_write <= 17'd76799) ? addr_write : 17'd76799] <= data_in;
+        bram[(addr_write < PIXELS) ? addr_write : PIXELS - 1] <= data_in;
     end
-    data_out <= bram[(addr_read <= 17'd76799) ? addr_read : 17'd76799];
+    data_out <= bram[(addr_read < PIXELS) ? addr_read : PIXELS - 1];
 end
 
 endmodule
\ No newline at end of file
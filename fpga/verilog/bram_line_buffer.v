@@ -0,0 +1,93 @@
+/*
+ * Module Name: bram_line_buffer.
+ *
+ * Description: Delays a stream of mask bits by one and two rows of the frame, giving the taps
+ *              of the cross kernels of the erosion and the dilation.
+ *
+ * Parameters:
+ *    DEPTH - Length of the longest row (IMG_WIDTH)
+ *    ADDR_WIDTH - Width of the addresses, at least enough for DEPTH + 1 entries
+ *
+ * Inputs:
+ *    clk - Main clock signal
+ *    restart - Latches the row length and moves the pointers back to the first entries
+ *    shift - The bit at data_in enters the buffer at the end of this cycle
+ *    data_in - Newest bit of the stream (tap 0), held by the user for the whole cycle
+ *    width - Length of the rows of the current frame, from 1 to DEPTH
+ *
+ * Outputs:
+ *    tap_right - Bit width - 1 positions before data_in
+ *    tap_center - Bit width positions before data_in
+ *    tap_left - Bit width + 1 positions before data_in
+ *    tap_up - Bit 2 * width positions before data_in
+ *
+ * Functionality:
+ *    This module keeps the last 2 * width + 1 bits of the stream in two circular buffers,
+ *    inferred as M10K, and two registers. The first buffer (width entries) delays data_in by
+ *    width - 1 shifts, its output goes through the center and left registers, and the second
+ *    buffer (width + 1 entries) delays the center tap by width more shifts.
+ *    Each buffer reads the entry after the one being written, the oldest one, so the read and
+ *    write addresses never match. The pointers wrap at the row length latched on restart,
+ *    so the taps follow the frame width without selecting among DEPTH positions.
+ *    The outputs are valid during the cycles where shift is high; until 2 * width + 1 bits
+ *    went in after a restart they hold bits of the previous frame.
+ *    With width 1 the right tap is data_in itself.
+ */
+
+module bram_line_buffer #(
+    parameter DEPTH = 320,
+    parameter ADDR_WIDTH = 9
+)(
+    input clk,
+    input restart,
+    input shift,
+    input data_in,
+    input [16:0] width,
+    output tap_right,
+    output reg tap_center,
+    output reg tap_left,
+    output reg tap_up
+);
+
+reg near[DEPTH - 1:0];
+reg far[DEPTH:0];
+reg near_out;
+reg [ADDR_WIDTH - 1:0] near_read;
+reg [ADDR_WIDTH - 1:0] near_write;
+reg [ADDR_WIDTH - 1:0] near_last;
+reg [ADDR_WIDTH - 1:0] far_read;
+reg [ADDR_WIDTH - 1:0] far_write;
+reg [ADDR_WIDTH - 1:0] far_last;
+reg single_column;
+
+assign tap_right = single_column ? data_in : near_out;
+
+always @(negedge clk) begin
+    if (shift) begin
+        near[near_write] <= data_in;
+        near_out <= near[near_read];
+        far[far_write] <= tap_center;
+        tap_up <= far[far_read];
+    end
+end
+
+always @(posedge clk) begin
+    if (restart) begin
+        near_last <= (width >= 17'd2) ? width - 17'd1 : {ADDR_WIDTH{1'b0}};
+        far_last <= width;
+        single_column <= (width < 17'd2);
+        near_read <= (width >= 17'd2) ? 1'b1 : 1'b0;
+        near_write <= {ADDR_WIDTH{1'b0}};
+        far_read <= 1'b1;
+        far_write <= {ADDR_WIDTH{1'b0}};
+    end else if (shift) begin
+        tap_center <= tap_right;
+        tap_left <= tap_center;
+        near_write <= near_read;
+        near_read <= (near_read >= near_last) ? {ADDR_WIDTH{1'b0}} : near_read + 1'b1;
+        far_write <= far_read;
+        far_read <= (far_read >= far_last) ? {ADDR_WIDTH{1'b0}} : far_read + 1'b1;
+    end
+end
+
+endmodule
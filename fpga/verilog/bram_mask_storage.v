@@ -0,0 +1,48 @@
+/*
+ * Module Name: bram_mask_storage.
+ *
+ * Description: Acts as a memory storing the binary mask, one bit per pixel.
+ *
+ * Parameters:
+ *    WORDS - Number of 32 pixel words of the largest frame (up to 4096)
+ *
+ * Inputs:
+ *    clk - Main clock signal
+ *    addr_read - Word address to read from the memory
+ *    addr_write - Word address to write to the memory
+ *    we - Write enable signal
+ *    data_in - Input word data signal (32 pixels, lowest address in bit 0)
+ *
+ * Outputs:
+ *    data_out - Output word data signal (32 pixels, lowest address in bit 0)
+ *
+ * Functionality:
+ *    This module acts as a memory storing WORDS words of 32 bits; a 320 x 240 frame takes
+ *    2400 words, 9.4 KB in 10 M10K blocks against the 75 blocks of one image channel.
+ *    Pixel p is bit p[4:0] of word p[16:5].
+ *    It has two address inputs, one for reading and one for writing.
+ *    The data_out is always provided according to addr_read.
+ *    The data_in is written to the memory according to addr_write when we is high.
+ */
+
+module bram_mask_storage #(
+    parameter WORDS = 2400
+)(
+    input clk,
+    input [11:0] addr_read,
+    input [11:0] addr_write,
+    input we,
+    input [31:0] data_in,
+    output reg [31:0] data_out
+);
+
+reg [31:0] bram[WORDS - 1:0];
+
+always @(negedge clk) begin
+    if (we) begin
+        bram[(addr_write < WORDS) ? addr_write : WORDS - 1] <= data_in;
+    end
+    data_out <= bram[(addr_read < WORDS) ? addr_read : WORDS - 1];
+end
+
+endmodule
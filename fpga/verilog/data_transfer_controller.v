@@ -3,6 +3,10 @@
  *
  * Description: Controls SPI communication.
  *
+ * Parameters:
+ *    IMG_WIDTH - Width of the largest frame
+ *    IMG_HEIGHT - Height of the largest frame
+ *
  * Inputs:
  *    clk - Main clock signal
  *    rst - Reset signal
@@ -10,26 +14,78 @@
  *    spi_byte_in - Input byte data from spi_slave
  *	  bram_data_out - Data obtained from BRAM
  *    pdi_done - Signal that indicates when PDI is done
+ *    hps_pdi_start - Signal that starts PDI from the HPS memory window
+ *    hps_pdi_bank - Frame bank processed when PDI is started from the HPS memory window
+ *    hps_pdi_chroma - Chroma frame flag when PDI is started from the HPS memory window
+ *    hps_geometry_write - Signal that sets the frame geometry from the HPS memory window
+ *    hps_geometry_height - Frame height requested by the HPS memory window
+ *    hps_geometry_width - Frame width requested by the HPS memory window
+ *    hps_roi_write - Signal that sets the ROI origin from the HPS memory window
+ *    hps_roi_y - ROI row requested by the HPS memory window
+ *    hps_roi_x - ROI column requested by the HPS memory window
+ *    hand_box_left/top/right/bottom - Bounding box of the dilated hand, from img_processing
+ *    cycles_binarization/morphology/contour/peaks - Clock cycles of each PDI stage, from
+ *                                                  img_processing
+ *    cycles_total - Clock cycles of the last PDI, from img_processing
+ *    reference_point_x/y - Reference point of the contour distances, from img_processing
  *
  * Outputs:
  *    spi_byte_out - Output byte data to spi_slave
  *    bram_addr - Address for reading and writing memory
  *    bram_channel - Channel to write data (01:R, 10:G, 11:B)
+ *    bram_bank - Frame bank accessed by the image transfers
  *    bram_we - BRAM write enable signal
+ *    bram_wstrobe - One cycle pulse when a new pixel is on bram_addr/bram_data_in
+ *    bram_sum_clear - One cycle pulse after the size bytes, clears the sum of bram_channel in
+ *                     bram_bank before its pixels arrive
  *    bram_data_in - Data to be written in BRAM
+ *    bram_mask - Signal that selects the binary mask instead of a channel for reading
  *    pdi_active - Signal that activates PDI execution
+ *    pdi_bank - Frame bank processed by PDI
+ *    pdi_chroma - Signal that the frame processed by PDI holds Cb (green) and Cr (blue) planes
+ *    frame_height - Height of the frames, used by img_processing
+ *    frame_width - Width of the frames, used by img_processing
+ *    roi_y - Row of the camera image where the frames start
+ *    roi_x - Column of the camera image where the frames start
  *
  * Functionality:
  *    State machine that processes SPI communication data.
  *    States:
  *      - 0: Receives the command byte
- *      - 1: Receives the data image size bytes
+ *      - 1: Receives the data image size bytes (and the ROI origin bytes of 1010)
  *      - 2: Receives the image data bytes for one channel and writes to BRAM
- *      - 3: Sends BRAM data for one channel
- *      - 4: Run and wait for PDI
+ *      - 3: Sends BRAM data for one channel, or the binary mask (1000), 8 pixels per byte
+ *      - 5: Sends a 32 bit result, the frame geometry (1001) as height << 16 | width, the
+ *           ROI origin (1011) as y << 16 | x or the corners of the hand bounding box, top
+ *           left (1100) as top << 16 | left and bottom right (1101) as bottom << 16 | right,
+ *           or the clock cycles of the PDI stage selected by the channel bits (1110): 00
+ *           binarization, 01 morphology, 10 contour, 11 peaks and classification
+ *      - 6: Sends the result record (1111), RECORD_BYTES bytes MSB first: classification (1),
+ *           peaks (2), hand area (3), hand perimeter (3), max_distance (5), reference point
+ *           x (2) and y (2) and the PDI clock cycles (4)
+ *    Bit 7 of the command byte selects the frame bank of the image transfers (0001, 0010, 1010)
+ *    and of the PDI execution (0011).
+ *    Channel bits 01 of the PDI execution (0011) start it on a chroma frame: the host uploads
+ *    only Cb in the green channel and Cr in the blue channel, already compensated, and
+ *    img_processing goes straight to the binarization.
+ *    PDI runs in the background: the link stays in state 0 and every command byte answers
+ *    0x40 while PDI is running (0x00 otherwise), so the next frame can be sent to the other
+ *    bank meanwhile. Starting PDI while it is running is ignored.
+ *    The binary mask belongs to img_processing while PDI is running, so it is read (1000)
+ *    after the PDI status returns to 0x00, with the geometry of the frame processed.
+ *    The height and width bytes of every image upload (or a write to the geometry register of
+ *    the HPS memory window) set the frame geometry. Sizes of 0 or larger than the synthesized
+ *    frame are replaced by IMG_HEIGHT/IMG_WIDTH, so the host reads the geometry back (1001)
+ *    to check the one in use. Image readbacks send frame_height * frame_width pixels.
+ *    The ROI upload (1010) sends the row and column of the crop in the camera image before
+ *    the height and width; only the crop is stored and processed. The origin is kept inside
+ *    the synthesized frame and is 0 after a full upload (0001).
  */
 
-module data_transfer_controller (
+module data_transfer_controller #(
+	parameter IMG_WIDTH = 320,
+	parameter IMG_HEIGHT = 240
+)(
 	input clk,
 	input rst,
 	
@@ -39,8 +95,12 @@ module data_transfer_controller (
 	
 	output reg [16:0] bram_addr,
 	output reg [1:0] bram_channel,
+	output reg bram_bank,
 	output reg bram_we,
+	output reg bram_wstrobe,
+	output reg bram_sum_clear,
 	output reg [7:0] bram_data_in,
+	output reg bram_mask,
 	input [7:0] bram_data_out,
 
 	input [16:0] hand_area,
@@ -48,157 +108,330 @@ module data_transfer_controller (
 	input [34:0] max_distance,
 	input [9:0] peaks,
 	input [3:0] classification,
+	input [15:0] hand_box_left,
+	input [15:0] hand_box_top,
+	input [15:0] hand_box_right,
+	input [15:0] hand_box_bottom,
+	input [31:0] cycles_binarization,
+	input [31:0] cycles_morphology,
+	input [31:0] cycles_contour,
+	input [31:0] cycles_peaks,
+	input [31:0] cycles_total,
+	input [15:0] reference_point_x,
+	input [15:0] reference_point_y,
 
 	output reg pdi_active,
+	output reg pdi_bank,
+	output reg pdi_chroma,
 	input pdi_done,
+	input hps_pdi_start,
+	input hps_pdi_bank,
+	input hps_pdi_chroma,
+	input hps_geometry_write,
+	input [15:0] hps_geometry_height,
+	input [15:0] hps_geometry_width,
+	output reg [15:0] frame_height,
+	output reg [15:0] frame_width,
+	input hps_roi_write,
+	input [15:0] hps_roi_y,
+	input [15:0] hps_roi_x,
+	output reg [15:0] roi_y,
+	output reg [15:0] roi_x,
 	output reg [2:0] state
 );
 
 	// reg [2:0]  state;
-	reg [2:0]  size_byte_count;
+	reg [3:0]  size_byte_count;
 	reg [15:0] img_height; // or data_size
 	reg [15:0] img_width;
+	reg [15:0] img_roi_y;
+	reg [15:0] img_roi_x;
 	reg [15:0] img_height_count;
 	reg [15:0] img_width_count;
 	reg [2:0] int_count;
 	reg [31:0] int_data;
 
+	localparam RECORD_BYTES = 22;
+	reg [4:0] record_count;
+	reg [8 * RECORD_BYTES - 1:0] record_data;
+
+	// Last pixel of a frame, where the image readbacks stop
+	wire [16:0] frame_last_pixel = frame_height * frame_width - 1'b1;
+
+	// Last pixel of the frame processed by the last PDI, where the mask readback stops; a new
+	// geometry may already be set by an upload during PDI
+	reg [16:0] pdi_last_pixel;
+
+	function [15:0] clamp_size;
+		input [15:0] size;
+		input [15:0] max_size;
+		begin
+			clamp_size = (size == 16'd0 || size > max_size) ? max_size : size;
+		end
+	endfunction
+
+	// Moves the origin back so that the crop fits in the synthesized frame
+	function [15:0] clamp_origin;
+		input [15:0] origin;
+		input [15:0] size;
+		input [15:0] max_size;
+		begin
+			clamp_origin = ({1'b0, origin} + size > max_size) ? max_size - size : origin;
+		end
+	endfunction
+
 	task init_values;
 		begin
 			state <= 3'd0;
-			size_byte_count <= 3'd0;
+			size_byte_count <= 4'd0;
 			img_height <= 16'b0;
 			img_width <= 16'b0;
+			img_roi_y <= 16'b0;
+			img_roi_x <= 16'b0;
 			img_height_count <= 16'b0;
 			img_width_count <= 16'b0;
 			spi_byte_out <= 8'b0;
 			bram_addr <= {17{1'b1}}; // Initial at the maximum value so that when the increment is made the value goes to 0
 			bram_channel <= 2'b00;
 			bram_we <= 1'b0;
-			pdi_active <= 1'b0;
+			bram_wstrobe <= 1'b0;
+			bram_sum_clear <= 1'b0;
 			bram_data_in <= 8'b0;
+			bram_mask <= 1'b0;
 			int_count <= 2'b00;
+			record_count <= 5'd0;
 		end
 	endtask
 
 	always @ (posedge clk or negedge rst) begin
 		if (!rst) begin
 			init_values;
+			bram_bank <= 1'b0;
+			pdi_active <= 1'b0;
+			pdi_bank <= 1'b0;
+			pdi_chroma <= 1'b0;
+			frame_height <= IMG_HEIGHT;
+			frame_width <= IMG_WIDTH;
+			roi_y <= 16'b0;
+			roi_x <= 16'b0;
+			pdi_last_pixel <= IMG_HEIGHT * IMG_WIDTH - 1;
 		end
-		else if (spi_cycle_done) begin
-			case (state)
-				3'd0 : begin // Recives the command byte
-							if (spi_byte_in[5:2] == 4'b0001) begin
-								state <= 3'd1;
-								size_byte_count <= 3'd4;
-								bram_channel <= spi_byte_in[1:0];
-							end
-							else if (spi_byte_in[5:2] == 4'b0010) begin
-								state <= 3'd3;
-								bram_addr <= 17'b0;
-								bram_channel <= spi_byte_in[1:0];
-							end
-							else if (spi_byte_in[5:2] == 4'b0011) begin
-								state <= 3'd4;
-								pdi_active <= 1'b1;
-							end
-							else if (spi_byte_in[5:2] == 4'b0100) begin
-								state <= 3'd5;
-								int_data <= hand_area;
-								// int_data <= max_distance[31:0];
-							end
-							else if (spi_byte_in[5:2] == 4'b0101) begin
-								state <= 3'd5;
-								int_data <= hand_perimeter;
-								// int_data <= max_distance[34:32];
-							end
-							else if (spi_byte_in[5:2] == 4'b0110) begin
-								state <= 3'd5;
-								int_data <= peaks;
-							end
-							else if (spi_byte_in[5:2] == 4'b0111) begin
-								state <= 3'd5;
-								int_data <= classification;
-							end
-							else begin
-								init_values;
-							end
-						end
-				3'd1 : begin // Recives the data size bytes
-							if (size_byte_count == 3'd4) begin
-								img_height[15:8] <= spi_byte_in;
-							end
-							else if (size_byte_count == 3'd3) begin
-								img_height[7:0] <= spi_byte_in;
-							end
-							else if (size_byte_count == 3'd2) begin
-								img_width[15:8] <= spi_byte_in;
+		else begin
+			bram_wstrobe <= 1'b0;
+			bram_sum_clear <= 1'b0;
+
+			if (spi_cycle_done) begin
+				case (state)
+					3'd0 : begin // Recives the command byte
+								if (spi_byte_in[5:2] == 4'b0001) begin
+									state <= 3'd1;
+									size_byte_count <= 4'd4;
+									img_roi_y <= 16'b0;
+									img_roi_x <= 16'b0;
+									bram_channel <= spi_byte_in[1:0];
+									bram_bank <= spi_byte_in[7];
+								end
+								else if (spi_byte_in[5:2] == 4'b1010) begin
+									state <= 3'd1;
+									size_byte_count <= 4'd8;
+									bram_channel <= spi_byte_in[1:0];
+									bram_bank <= spi_byte_in[7];
+								end
+								else if (spi_byte_in[5:2] == 4'b0010) begin
+									state <= 3'd3;
+									bram_addr <= 17'b0;
+									bram_channel <= spi_byte_in[1:0];
+									bram_bank <= spi_byte_in[7];
+								end
+								else if (spi_byte_in[5:2] == 4'b0011) begin
+									if (!pdi_active) begin
+										pdi_active <= 1'b1;
+										pdi_bank <= spi_byte_in[7];
+										pdi_chroma <= (spi_byte_in[1:0] == 2'b01);
+										pdi_last_pixel <= frame_last_pixel;
+									end
+								end
+								else if (spi_byte_in[5:2] == 4'b1000) begin
+									state <= 3'd3;
+									bram_addr <= 17'b0;
+									bram_mask <= 1'b1;
+								end
+								else if (spi_byte_in[5:2] == 4'b1001) begin
+									state <= 3'd5;
+									int_data <= {frame_height, frame_width};
+								end
+								else if (spi_byte_in[5:2] == 4'b1011) begin
+									state <= 3'd5;
+									int_data <= {roi_y, roi_x};
+								end
+								else if (spi_byte_in[5:2] == 4'b1100) begin
+									state <= 3'd5;
+									int_data <= {hand_box_top, hand_box_left};
+								end
+								else if (spi_byte_in[5:2] == 4'b1101) begin
+									state <= 3'd5;
+									int_data <= {hand_box_bottom, hand_box_right};
+								end
+								else if (spi_byte_in[5:2] == 4'b1110) begin
+									state <= 3'd5;
+									case (spi_byte_in[1:0])
+										2'b00: int_data <= cycles_binarization;
+										2'b01: int_data <= cycles_morphology;
+										2'b10: int_data <= cycles_contour;
+										default: int_data <= cycles_peaks;
+									endcase
+								end
+								else if (spi_byte_in[5:2] == 4'b1111) begin
+									state <= 3'd6;
+									record_data <= {4'b0, classification, 6'b0, peaks, 7'b0, hand_area,
+									                7'b0, hand_perimeter, 5'b0, max_distance,
+									                reference_point_x, reference_point_y, cycles_total};
+								end
+								else if (spi_byte_in[5:2] == 4'b0100) begin
+									state <= 3'd5;
+									int_data <= hand_area;
+									// int_data <= max_distance[31:0];
+								end
+								else if (spi_byte_in[5:2] == 4'b0101) begin
+									state <= 3'd5;
+									int_data <= hand_perimeter;
+									// int_data <= max_distance[34:32];
+								end
+								else if (spi_byte_in[5:2] == 4'b0110) begin
+									state <= 3'd5;
+									int_data <= peaks;
+								end
+								else if (spi_byte_in[5:2] == 4'b0111) begin
+									state <= 3'd5;
+									int_data <= classification;
+								end
+								else begin
+									init_values;
+								end
+
+								// PDI status for the next byte
+								spi_byte_out <= (pdi_active || spi_byte_in[5:2] == 4'b0011) ? 8'b01000000 : 8'b0;
 							end
-							else if (size_byte_count == 3'd1) begin
-								img_width[7:0] <= spi_byte_in;
+					3'd1 : begin // Recives the data size bytes
+								if (size_byte_count == 4'd8) begin
+									img_roi_y[15:8] <= spi_byte_in;
+								end
+								else if (size_byte_count == 4'd7) begin
+									img_roi_y[7:0] <= spi_byte_in;
+								end
+								else if (size_byte_count == 4'd6) begin
+									img_roi_x[15:8] <= spi_byte_in;
+								end
+								else if (size_byte_count == 4'd5) begin
+									img_roi_x[7:0] <= spi_byte_in;
+								end
+								else if (size_byte_count == 4'd4) begin
+									img_height[15:8] <= spi_byte_in;
+								end
+								else if (size_byte_count == 4'd3) begin
+									img_height[7:0] <= spi_byte_in;
+								end
+								else if (size_byte_count == 4'd2) begin
+									img_width[15:8] <= spi_byte_in;
+								end
+								else if (size_byte_count == 4'd1) begin
+									img_width[7:0] <= spi_byte_in;
+								end
+								
+								size_byte_count <= size_byte_count - 1'd1;
+								if (size_byte_count <= 4'd1) begin
+									state <= 3'd2;
+									bram_we <= 1'b1;
+									bram_sum_clear <= 1'b1; // Upload start, restarts the channel sum
+									img_height_count <= img_height;
+									img_width_count[15:8] <= img_width[15:8];
+									img_width_count[7:0] <= spi_byte_in;
+									frame_height <= clamp_size(img_height, IMG_HEIGHT);
+									frame_width <= clamp_size({img_width[15:8], spi_byte_in}, IMG_WIDTH);
+									roi_y <= clamp_origin(img_roi_y, clamp_size(img_height, IMG_HEIGHT), IMG_HEIGHT);
+									roi_x <= clamp_origin(img_roi_x, clamp_size({img_width[15:8], spi_byte_in}, IMG_WIDTH), IMG_WIDTH);
+								end
 							end
-							
-							size_byte_count <= size_byte_count - 1'd1;
-							if (size_byte_count <= 3'd1) begin
-								state <= 3'd2;
-								bram_we <= 1'b1;
-								img_height_count <= img_height;
-								img_width_count[15:8] <= img_width[15:8];
-								img_width_count[7:0] <= spi_byte_in;
+					3'd2 : begin // Reiceves the image data bytes
+								bram_data_in <= spi_byte_in;
+								bram_addr <= bram_addr + 17'b1;
+								bram_wstrobe <= 1'b1; // Adds the pixel to the channel sum
+								
+								// Update image size counters
+								img_width_count <= img_width_count - 1'b1;
+								if (img_width_count <= 16'b1) begin
+									img_height_count <= img_height_count - 1'b1;
+									img_width_count <= img_width;
+									if (img_height_count <= 16'b1) begin
+										state <= 3'd0;
+									end
+								end
+								// if (bram_addr >= 17'd76799) begin
+								// 	state <= 3'd0;
+								// end
 							end
-						end
-				3'd2 : begin // Reiceves the image data bytes
-							bram_data_in <= spi_byte_in;
-							bram_addr <= bram_addr + 17'b1;
-							
-							// Update image size counters
-							img_width_count <= img_width_count - 1'b1;
-							if (img_width_count <= 16'b1) begin
-								img_height_count <= img_height_count - 1'b1;
-								img_width_count <= img_width;
-								if (img_height_count <= 16'b1) begin
+					3'd3 : begin // Send bram data
+								spi_byte_out <= bram_data_out;
+								bram_addr <= bram_addr + 17'b1;
+								if (bram_addr >= (bram_mask ? (pdi_last_pixel >> 3) : frame_last_pixel)) begin
 									state <= 3'd0;
+									bram_mask <= 1'b0;
 								end
 							end
-							// if (bram_addr >= 17'd76799) begin
-							// 	state <= 3'd0;
-							// end
-						end
-				3'd3 : begin // Send bram data
-							spi_byte_out <= bram_data_out;
-							bram_addr <= bram_addr + 17'b1;
-							if (bram_addr >= 17'd76799) begin
-								state <= 3'd0;
-							end
-						end
-				3'd4 : begin // Wait for PDI
-							spi_byte_out <= 8'b01000000; //Indicates that PDI is running
-						end
-				3'd5 : begin // send 32 bit int
-							int_count <= int_count + 1'b1;
-							if (int_count == 3'b000) begin
-								spi_byte_out <= int_data[31:24];
-							end
-							else if (int_count == 3'b001) begin
-								spi_byte_out <= int_data[23:16];
+					3'd5 : begin // send 32 bit int
+								int_count <= int_count + 1'b1;
+								if (int_count == 3'b000) begin
+									spi_byte_out <= int_data[31:24];
+								end
+								else if (int_count == 3'b001) begin
+									spi_byte_out <= int_data[23:16];
+								end
+								else if (int_count == 3'b010) begin
+									spi_byte_out <= int_data[15:8];
+								end
+								else if (int_count == 3'b011) begin
+									spi_byte_out <= int_data[7:0];
+									state <= 3'd0;
+								end
 							end
-							else if (int_count == 3'b010) begin
-								spi_byte_out <= int_data[15:8];
+					3'd6 : begin // send the result record
+								spi_byte_out <= record_data[8 * RECORD_BYTES - 1 -: 8];
+								record_data <= record_data << 8;
+								record_count <= record_count + 1'b1;
+								if (record_count == RECORD_BYTES - 1) begin
+									state <= 3'd0;
+								end
 							end
-							else if (int_count == 3'b011) begin
-								spi_byte_out <= int_data[7:0];
-								state <= 3'd0;
+					default : begin
+								init_values;
 							end
-						end
-				default : begin
-							init_values;
-						end
-			endcase
-		end
-		else if (pdi_done) begin
-			// PDI is done
-			pdi_active <= 1'b0;
-			state <= 3'd0;
+				endcase
+			end
+
+			// PDI control, independent of the SPI link so a transfer to the other bank may
+			// still be in progress
+			if (pdi_done && pdi_active) begin
+				pdi_active <= 1'b0;
+			end
+			else if (hps_pdi_start && !pdi_active) begin
+				// PDI started through hps_bram_window
+				pdi_active <= 1'b1;
+				pdi_bank <= hps_pdi_bank;
+				pdi_chroma <= hps_pdi_chroma;
+				pdi_last_pixel <= frame_last_pixel;
+			end
+
+			// Geometry set through hps_bram_window, which has no size bytes
+			if (hps_geometry_write) begin
+				frame_height <= clamp_size(hps_geometry_height, IMG_HEIGHT);
+				frame_width <= clamp_size(hps_geometry_width, IMG_WIDTH);
+			end
+
+			// ROI origin set through hps_bram_window, after the geometry of the crop
+			if (hps_roi_write) begin
+				roi_y <= clamp_origin(hps_roi_y, frame_height, IMG_HEIGHT);
+				roi_x <= clamp_origin(hps_roi_x, frame_width, IMG_WIDTH);
+			end
 		end
 	end
 
@@ -0,0 +1,333 @@
+/*
+ * Module Name: hps_bram_window.
+ *
+ * Description: Avalon-MM slave that maps the image BRAMs and the feature registers on the
+ *              lightweight HPS-to-FPGA bridge.
+ *
+ * Parameters:
+ *    FRAME_BANKS - Number of frame banks in bram_controller (1 or 2)
+ *
+ * Inputs:
+ *    clk - Main clock signal
+ *    rst - Reset signal
+ *    address - Byte address inside the window (from the exported bram_window bridge)
+ *    read - Avalon read request
+ *    write - Avalon write request
+ *    writedata - Avalon write data (four pixels, lowest address in byte lane 0)
+ *    byteenable - Avalon byte enables
+ *    bram_data_out - Data obtained from BRAM for the selected channel
+ *    pdi_active - Signal that indicates when img_processing is active
+ *    pdi_frame_busy - Signal that indicates when img_processing still reads the RGB channels
+ *    pdi_bank - Frame bank processed by img_processing
+ *    pdi_chroma - Signal that the frame processed by img_processing is a chroma frame
+ *    hand_area - Hand area result
+ *    hand_perimeter - Hand perimeter result
+ *    peaks - Number of peaks result
+ *    classification - Gesture classification result
+ *    frame_height - Height of the frames
+ *    frame_width - Width of the frames
+ *    roi_y - Row of the camera image where the frames start
+ *    roi_x - Column of the camera image where the frames start
+ *    hand_box_left/top/right/bottom - Bounding box of the dilated hand
+ *    cycles_binarization/morphology/contour/peaks - Clock cycles of each PDI stage
+ *    cycles_total - Clock cycles of the last PDI
+ *    max_distance - Largest squared distance of the contour to the reference point
+ *    reference_point_x/y - Reference point of the contour distances
+ *
+ * Outputs:
+ *    readdata - Avalon read data
+ *    readdatavalid - Avalon read data valid
+ *    waitrequest - Avalon wait request
+ *    bram_sel - Signal that gives this module the BRAM port (COM mode only)
+ *    bram_addr - Pixel address for reading and writing memory
+ *    bram_channel - Channel to access (01:R, 10:G, 11:B)
+ *    bram_bank - Frame bank to access
+ *    bram_mask - Signal that selects the binary mask instead of a channel (read only)
+ *    bram_we - BRAM write enable signal
+ *    bram_data_in - Data to be written in BRAM
+ *    bram_sum_clear - One cycle pulse after a write to the bank register, clears the channel
+ *                     sums of bram_bank
+ *    pdi_start - One cycle pulse that starts PDI execution
+ *    pdi_start_bank - Frame bank to process, valid with pdi_start
+ *    pdi_start_chroma - Signal that the frame holds Cb (green) and Cr (blue) planes, valid with
+ *                       pdi_start
+ *    geometry_write - One cycle pulse that sets the frame geometry
+ *    geometry_height - Frame height requested, valid with geometry_write
+ *    geometry_width - Frame width requested, valid with geometry_write
+ *    roi_write - One cycle pulse that sets the ROI origin
+ *    roi_new_y - ROI row requested, valid with roi_write
+ *    roi_new_x - ROI column requested, valid with roi_write
+ *
+ * Functionality:
+ *    address[18:17] selects the region: 00 red, 01 green, 10 blue, 11 registers.
+ *    A 32-bit access to a channel is serialized into up to four byte accesses to the BRAM,
+ *    one per clock cycle, while waitrequest holds the master.
+ *    Channel accesses go to the bank selected in the bank register; accesses to the bank being
+ *    processed while img_processing reads it are ignored (reads return 0).
+ *    Offset 0x4000 of region 11 maps the binary mask (9600 bytes, read only, pixel 8a + i in
+ *    bit i of byte a); it is ignored while PDI is active.
+ *    Registers (offset from region 11):
+ *      - 0x00: hand_area (RO)
+ *      - 0x04: hand_perimeter (RO)
+ *      - 0x08: peaks (RO)
+ *      - 0x0C: classification (RO)
+ *      - 0x10: control/status. Write bit 0 = start PDI on the bank in bit 1, bit 3 = the
+ *              frame holds Cb (green) and Cr (blue) planes instead of RGB,
+ *              read bit 0 = PDI running, bit 1 = bank being processed,
+ *              bit 2 = bank still in use (a new frame may be uploaded once it clears),
+ *              bit 3 = frame being processed is a chroma frame
+ *      - 0x14: bank (RW). Bit 0 = bank of the channel accesses. A write starts an upload:
+ *              it clears the channel sums of that bank, so write it before every frame
+ *      - 0x18: number of frame banks (RO)
+ *      - 0x1C: frame geometry (RW), height << 16 | width. Sizes of 0 or larger than the
+ *              synthesized frame are replaced by its size; read back to check the geometry
+ *      - 0x20: ROI origin (RW), y << 16 | x, position of the frames in the camera image. Write
+ *              it after the geometry; it is moved back to keep the crop inside the frame
+ *      - 0x24: hand bounding box top left (RO), top << 16 | left (0xFFFF without hand pixels)
+ *      - 0x28: hand bounding box bottom right (RO), bottom << 16 | right
+ *      - 0x2C to 0x38: clock cycles of the last frame (RO) in the binarization, morphology,
+ *              contour and peaks/classification stages
+ *      - 0x3C: max_distance[31:0] (RO)
+ *      - 0x40: max_distance[34:32] (RO)
+ *      - 0x44: reference point (RO), y << 16 | x
+ *      - 0x48: clock cycles of the last frame (RO), from activation to done
+ */
+
+module hps_bram_window #(
+	parameter FRAME_BANKS = 2
+)(
+	input clk,
+	input rst,
+
+	// Avalon-MM slave
+	input [18:0] address,
+	input read,
+	input write,
+	input [31:0] writedata,
+	input [3:0] byteenable,
+	output reg [31:0] readdata,
+	output reg readdatavalid,
+	output waitrequest,
+
+	// BRAM port
+	output bram_sel,
+	output [16:0] bram_addr,
+	output [1:0] bram_channel,
+	output reg bram_bank,
+	output reg bram_mask,
+	output bram_we,
+	output [7:0] bram_data_in,
+	output reg bram_sum_clear,
+	input [7:0] bram_data_out,
+
+	// PDI control and results
+	input pdi_active,
+	input pdi_frame_busy,
+	input pdi_bank,
+	input pdi_chroma,
+	output reg pdi_start,
+	output reg pdi_start_bank,
+	output reg pdi_start_chroma,
+	input [16:0] hand_area,
+	input [16:0] hand_perimeter,
+	input [9:0] peaks,
+	input [3:0] classification,
+	input [15:0] frame_height,
+	input [15:0] frame_width,
+	output reg geometry_write,
+	output reg [15:0] geometry_height,
+	output reg [15:0] geometry_width,
+	input [15:0] roi_y,
+	input [15:0] roi_x,
+	output reg roi_write,
+	output reg [15:0] roi_new_y,
+	output reg [15:0] roi_new_x,
+	input [15:0] hand_box_left,
+	input [15:0] hand_box_top,
+	input [15:0] hand_box_right,
+	input [15:0] hand_box_bottom,
+	input [31:0] cycles_binarization,
+	input [31:0] cycles_morphology,
+	input [31:0] cycles_contour,
+	input [31:0] cycles_peaks,
+	input [31:0] cycles_total,
+	input [34:0] max_distance,
+	input [15:0] reference_point_x,
+	input [15:0] reference_point_y
+);
+
+	localparam S_IDLE  = 2'd0;
+	localparam S_WRITE = 2'd1;
+	localparam S_READ  = 2'd2;
+	localparam S_ACK   = 2'd3;
+
+	localparam REG_AREA      = 5'd0;
+	localparam REG_PERIMETER = 5'd1;
+	localparam REG_PEAKS     = 5'd2;
+	localparam REG_CLASS     = 5'd3;
+	localparam REG_CTRL      = 5'd4;
+	localparam REG_BANK      = 5'd5;
+	localparam REG_BANKS     = 5'd6;
+	localparam REG_GEOMETRY  = 5'd7;
+	localparam REG_ROI       = 5'd8;
+	localparam REG_BOX_MIN   = 5'd9;
+	localparam REG_BOX_MAX   = 5'd10;
+	localparam REG_CYC_BIN   = 5'd11;
+	localparam REG_CYC_MORPH = 5'd12;
+	localparam REG_CYC_CONT  = 5'd13;
+	localparam REG_CYC_PEAKS = 5'd14;
+	localparam REG_DIST_LO   = 5'd15;
+	localparam REG_DIST_HI   = 5'd16;
+	localparam REG_REFERENCE = 5'd17;
+	localparam REG_CYC_TOTAL = 5'd18;
+
+	reg [1:0] state;
+	reg [1:0] lane;
+	reg [1:0] region;
+	reg [14:0] word;
+	reg [31:0] wdata;
+	reg [3:0] be;
+	reg is_read;
+
+	// With a single bank the bank register is ignored
+	wire access_bank = (FRAME_BANKS > 1) ? bram_bank : 1'b0;
+	wire proc_bank = (FRAME_BANKS > 1) ? pdi_bank : 1'b0;
+
+	// The command is held by the master until waitrequest goes low (one cycle in S_ACK)
+	assign waitrequest = (read | write) & (state != S_ACK);
+
+	// BRAM port driven straight from the serializer so that the negedge BRAM sees it this cycle
+	assign bram_sel = (state == S_WRITE) | (state == S_READ);
+	assign bram_addr = {word, lane};
+	assign bram_channel = region + 2'b01;
+	assign bram_we = (state == S_WRITE) & be[lane];
+	assign bram_data_in = (state == S_WRITE) ? wdata[8 * lane +: 8] : 8'b0;
+
+	always @(posedge clk or negedge rst) begin
+		if (!rst) begin
+			state <= S_IDLE;
+			lane <= 2'b0;
+			region <= 2'b0;
+			word <= 15'b0;
+			wdata <= 32'b0;
+			be <= 4'b0;
+			is_read <= 1'b0;
+			readdata <= 32'b0;
+			readdatavalid <= 1'b0;
+			pdi_start <= 1'b0;
+			pdi_start_bank <= 1'b0;
+			pdi_start_chroma <= 1'b0;
+			bram_bank <= 1'b0;
+			bram_mask <= 1'b0;
+			bram_sum_clear <= 1'b0;
+			geometry_write <= 1'b0;
+			geometry_height <= 16'b0;
+			geometry_width <= 16'b0;
+			roi_write <= 1'b0;
+			roi_new_y <= 16'b0;
+			roi_new_x <= 16'b0;
+		end
+		else begin
+			readdatavalid <= 1'b0;
+			pdi_start <= 1'b0;
+			bram_sum_clear <= 1'b0;
+			geometry_write <= 1'b0;
+			roi_write <= 1'b0;
+
+			case (state)
+				S_IDLE : begin
+							if (read | write) begin
+								region <= address[18:17];
+								word <= address[16:2];
+								wdata <= writedata;
+								be <= byteenable;
+								is_read <= read;
+								lane <= 2'b0;
+								readdata <= 32'b0;
+								bram_mask <= 1'b0;
+
+								if (address[18:17] == 2'b11 && address[14]) begin
+									if (read && !pdi_active) begin
+										bram_mask <= 1'b1;
+										state <= S_READ;
+									end
+									else begin
+										state <= S_ACK; // Mask is read only and belongs to img_processing
+									end
+								end
+								else if (address[18:17] == 2'b11) begin
+									if (read) begin
+										case (address[6:2])
+											REG_AREA      : readdata <= {15'b0, hand_area};
+											REG_PERIMETER : readdata <= {15'b0, hand_perimeter};
+											REG_PEAKS     : readdata <= {22'b0, peaks};
+											REG_CLASS     : readdata <= {28'b0, classification};
+											REG_CTRL      : readdata <= {28'b0, pdi_chroma, pdi_frame_busy, proc_bank, pdi_active};
+											REG_BANK      : readdata <= {31'b0, access_bank};
+											REG_BANKS     : readdata <= FRAME_BANKS;
+											REG_GEOMETRY  : readdata <= {frame_height, frame_width};
+											REG_ROI       : readdata <= {roi_y, roi_x};
+											REG_BOX_MIN   : readdata <= {hand_box_top, hand_box_left};
+											REG_BOX_MAX   : readdata <= {hand_box_bottom, hand_box_right};
+											REG_CYC_BIN   : readdata <= cycles_binarization;
+											REG_CYC_MORPH : readdata <= cycles_morphology;
+											REG_CYC_CONT  : readdata <= cycles_contour;
+											REG_CYC_PEAKS : readdata <= cycles_peaks;
+											REG_DIST_LO   : readdata <= max_distance[31:0];
+											REG_DIST_HI   : readdata <= {29'b0, max_distance[34:32]};
+											REG_REFERENCE : readdata <= {reference_point_y, reference_point_x};
+											REG_CYC_TOTAL : readdata <= cycles_total;
+											default       : readdata <= 32'b0;
+										endcase
+									end
+									else if (address[6:2] == REG_CTRL && byteenable[0] && writedata[0] && !pdi_active) begin
+										pdi_start <= 1'b1;
+										pdi_start_bank <= writedata[1];
+										pdi_start_chroma <= writedata[3];
+									end
+									else if (address[6:2] == REG_BANK && byteenable[0]) begin
+										bram_bank <= writedata[0];
+										bram_sum_clear <= 1'b1;
+									end
+									else if (address[6:2] == REG_GEOMETRY && byteenable == 4'b1111) begin
+										geometry_write <= 1'b1;
+										geometry_height <= writedata[31:16];
+										geometry_width <= writedata[15:0];
+									end
+									else if (address[6:2] == REG_ROI && byteenable == 4'b1111) begin
+										roi_write <= 1'b1;
+										roi_new_y <= writedata[31:16];
+										roi_new_x <= writedata[15:0];
+									end
+									state <= S_ACK;
+								end
+								else if (pdi_frame_busy && access_bank == proc_bank) begin
+									state <= S_ACK; // Bank belongs to img_processing
+								end
+								else begin
+									state <= read ? S_READ : S_WRITE;
+								end
+							end
+						end
+				S_WRITE : begin // One byte per cycle
+							lane <= lane + 2'b1;
+							if (lane == 2'b11) begin
+								state <= S_ACK;
+							end
+						end
+				S_READ : begin // data_out is updated on the negedge of this same cycle
+							readdata[8 * lane +: 8] <= bram_data_out;
+							lane <= lane + 2'b1;
+							if (lane == 2'b11) begin
+								state <= S_ACK;
+							end
+						end
+				S_ACK : begin
+							readdatavalid <= is_read;
+							state <= S_IDLE;
+						end
+			endcase
+		end
+	end
+
+endmodule
@@ -3,77 +3,217 @@
  *
  * Description: Executes PDI.
  *
+ * Parameters:
+ *    IMG_WIDTH - Width of the largest frame, sets the length of the morphology line buffers
+ *    CONTOUR_POINTS - Maximum number of contour points traced
+ *    PEAK_CANDIDATES - Maximum number of peak candidates kept during the tracing
+ *
  * Inputs:
  *    clk - Main clock signal
  *    rst - Reset signal
  *    active - Signal that activates PDI execution
+ *    chroma - Signal that selects a chroma frame (Cb in the green channel, Cr in the blue
+ *             channel), latched on activation
  *    red_data_in - Input byte data for red channel
  *    green_data_in - Input byte data for green channel
  *    blue_data_in - Input byte data for blue channel
+ *    red_sum - Sum of the red channel pixels, accumulated by bram_controller during upload
+ *    green_sum - Sum of the green channel pixels, accumulated by bram_controller during upload
+ *    blue_sum - Sum of the blue channel pixels, accumulated by bram_controller during upload
+ *    mask_data_in - 32 pixels of the binary mask, lowest address in bit 0
+ *    frame_height - Height of the frame, latched when PDI starts
+ *    frame_width - Width of the frame, latched when PDI starts
  *
  * Outputs:
  *    done - Signal that indicates when a PDI cycle is done
- *    red_data_out - Output byte data for red channel
- *    green_data_out - Output byte data for green channel
- *    blue_data_out - Output byte data for blue channel
- *    we - BRAM write enable signal
+ *    frame_busy - Signal that indicates when the RGB channels are still being read
  *    addr_read - Address for reading memory
- *    addr_write - Address for writing memory
+ *    mask_we - Mask write enable signal
+ *    mask_addr_read - Mask word address for reading
+ *    mask_addr_write - Mask word address for writing
+ *    mask_data_out - 32 pixels to be written in the mask
  *    mean - Debug signal
+ *    hand_box_left - First column of the dilated hand (0xFFFF without hand pixels)
+ *    hand_box_top - First row of the dilated hand (0xFFFF without hand pixels)
+ *    hand_box_right - Last column of the dilated hand
+ *    hand_box_bottom - Last row of the dilated hand
+ *    cycles_binarization - Clock cycles of the last frame in states 010 to 100 (only 100 for a
+ *                          chroma frame)
+ *    cycles_morphology - Clock cycles of the last frame in state 111
+ *    cycles_contour - Clock cycles of the last frame in state 1100
+ *    cycles_peaks - Clock cycles of the last frame in states 1101 to 1111
+ *    cycles_total - Clock cycles of the last frame from activation to done
+ *    reference_point_x - Column of the reference point of the contour distances
+ *    reference_point_y - Row of the reference point (the last row of the frame)
  *
  * Functionality:
  *    State machine that processes PDI.
+ *    The RGB channels are only read; the binarization writes a 1 bit per pixel mask that the
+ *    morphology, the area/perimeter count and the contour tracing use from then on.
+ *    The frame geometry is latched on activation and every pass is bounded by it, so a
+ *    cropped frame (ROI upload) takes time in proportion to its area. The morphology line
+ *    buffers are circular buffers in M10K (bram_line_buffer) that wrap at the frame width.
  *    States:
  *      - 000: Initializes values and waits for active signal
- *      - 001: Accumulates the data for the mean calculation
- *      - 010: Calculates the mean for each channel
- *      - 011: Calculates the max mean and prepares the data for the next state
- *      - 100: Executes the ilumination compesation
+ *      - 010: Calculates the mean for each channel from the upload sums (there is no
+ *             accumulation pass, so state 001 is not used) with a restoring divider, one bit
+ *             per clock over 8 clocks. Means above 255 saturate
+ *      - 011: Calculates the max mean
+ *      - 100: Executes the ilumination compesation, the YCbCr conversion and the
+ *             binarization in a single four stage pipeline, one pixel per clock, writing the
+ *             mask (states 101 and 110 are no longer used)
+ *             A chroma frame comes already compensated and converted by the host, so states
+ *             010 and 011 are skipped and the first stages of the pipeline pass the Cb (green
+ *             channel) and Cr (blue channel) pixels through. Every pixel is binarized, the
+ *             host encodes the result of the last one in its Cb and Cr
+ *      - 111: Executes the erosion and the dilation in a single sweep over two pairs of line
+ *             buffers, one pixel per clock, and computes the hand area, perimeter and bounding
+ *             box and the init and reference points on the dilated pixels (states 1000 to
+ *             1011 are no longer used). The sweep only covers the rows of the binarized hand
+ *             plus the two rows the dilation may reach and one row to close the perimeter,
+ *             starting two rows of zeros earlier to flush the line buffers; the other rows of
+ *             the mask are already 0
+ *      - 1100: Traces the hand contour (up to CONTOUR_POINTS points) and keeps the local
+ *              maxima of the radial distance as peak candidates in bram_candidate_storage,
+ *              dropping those already below the threshold of the running maximum
+ *      - 1101: Calculates the threshold from the maximum distance
+ *      - 1110: Applies the threshold and the minimum spacing to the candidates, one per clock
+ *      - 1111: Classifies the gesture
+ *    A free-running cycle counter is sampled whenever the state moves to another stage, and the
+ *    cycles spent in the stage that ended are latched in its cycles_* output. They hold the
+ *    values of the last frame until the same stage of the next frame ends.
  */
 
-module img_processing (
+module img_processing #(
+    parameter IMG_WIDTH = 320,
+    parameter CONTOUR_POINTS = 4096,
+    parameter PEAK_CANDIDATES = 256
+)(
     input clk,
     input rst,
     input active,
+    input chroma,
     output reg done,
+    output frame_busy,
 
     input [7:0] red_data_in,
     input [7:0] green_data_in,
     input [7:0] blue_data_in,
 
-    output reg [7:0] red_data_out,
-    output reg [7:0] green_data_out,
-    output reg [7:0] blue_data_out,
+    input [24:0] red_sum,
+    input [24:0] green_sum,
+    input [24:0] blue_sum,
 
-    output reg we,
     output reg [16:0] addr_read,
-    output reg [16:0] addr_write,
+
+    output reg mask_we,
+    output [11:0] mask_addr_read,
+    output reg [11:0] mask_addr_write,
+    output reg [31:0] mask_data_out,
+    input [31:0] mask_data_in,
+
+    input [15:0] frame_height,
+    input [15:0] frame_width,
+
     output reg [16:0] hand_area,
     output reg [16:0] hand_perimeter,
     output reg [34:0] max_distance,
     output reg [9:0] peaks,
-    output reg [3:0] classification
+    output reg [3:0] classification,
+    output reg [15:0] hand_box_left,
+    output reg [15:0] hand_box_top,
+    output reg [15:0] hand_box_right,
+    output reg [15:0] hand_box_bottom,
+    output reg [31:0] cycles_binarization,
+    output reg [31:0] cycles_morphology,
+    output reg [31:0] cycles_contour,
+    output reg [31:0] cycles_peaks,
+    output reg [31:0] cycles_total,
+    output reg [15:0] reference_point_x,
+    output reg [15:0] reference_point_y
 );
 
   reg [3:0] state;
 
-  reg [24:0] red_acumulator;
-  reg [24:0] green_acumulator;
-  reg [24:0] blue_acumulator;
+  // Frame geometry latched on activation
+  reg [16:0] width;
+  reg [16:0] height;
+  reg [16:0] last_pixel;
+  reg [16:0] last_row;  // Address of the first pixel of the last row
+  reg chroma_frame;
 
   reg [7:0] red_mean;
   reg [7:0] green_mean;
   reg [7:0] blue_mean;
   reg [7:0] max_mean;
 
+  // Restoring division of the upload sums by the frame pixels, one mean bit per clock
+  reg [24:0] red_remainder;
+  reg [24:0] green_remainder;
+  reg [24:0] blue_remainder;
+  reg [24:0] mean_divisor;  // Frame pixels shifted to the weight of the current mean bit
+  reg [2:0] mean_bit;
+
   reg [15:0] temp_red;
   reg [15:0] temp_green;
   reg [15:0] temp_blue;
 
+  // Compensation, YCbCr and binarization pipeline
+  reg stream_reading;
+  reg [2:0] stream_valid;
+  reg [16:0] stream_addr_1;
+  reg [16:0] stream_addr_2;
+  reg [16:0] stream_addr_3;
+  reg [7:0] pixel_red;
+  reg [7:0] pixel_green;
+  reg [7:0] pixel_blue;
+  reg [7:0] comp_red;
+  reg [7:0] comp_green;
+  reg [7:0] comp_blue;
+  reg [7:0] stream_cb;
+  reg [7:0] stream_cr;
+  reg [7:0] last_red;
+
+  // Mask words being assembled by the binarization and the morphology
+  reg [31:0] stream_word;
+  reg [31:0] morph_word;
+
+  // Rows of the binarized hand, found in scan order, which bound the morphology sweep
+  reg [16:0] stream_col;
+  reg [16:0] stream_row;
+  reg hand_found;
+  reg [16:0] hand_first_row;
+  reg [16:0] hand_last_row;
+  reg [16:0] hand_first_row_addr;
+  reg [16:0] hand_last_row_addr;
+
   reg [16:0] morphology_index_collumn;
   reg [16:0] morphology_index_row;
   reg [2:0] aux_index;
-  reg [4:0] morphology_kernel;
+
+  /* Morphology line buffers: the cross kernel centered one row behind the newest pixel (tap 0,
+   * down) is at taps 2 * width (up), width + 1 (left), width (center) and width - 1 (right).
+   * The newest pixels are kept here, the older ones in bram_line_buffer
+   */
+  localparam LINE_ADDR_WIDTH = $clog2(IMG_WIDTH + 1);
+  reg mask_tap;
+  reg eroded_tap;
+  wire mask_up, mask_left, mask_center, mask_right;
+  wire eroded_up, eroded_left, eroded_center, eroded_right;
+  reg [16:0] morph_count;  // Dilated pixels issued so far
+  reg morph_shifting;
+  reg [1:0] morph_valid;
+  reg [16:0] morph_col;
+  reg [16:0] morph_row;
+  reg morph_write;
+  reg morph_interior;
+  reg morph_border;
+  reg [16:0] morph_addr;
+  reg [16:0] morph_out_col;
+  reg [16:0] morph_out_row;
+  reg [16:0] morph_stop_row;  // Input row where the sweep stops
+  reg [16:0] morph_write_row; // First input row whose dilated row is written
+  reg [16:0] morph_last;      // Last dilated pixel written
 
   // reg [16:0] hand_area;
   // reg [16:0] hand_perimeter;
@@ -85,10 +225,21 @@ module img_processing (
   reg [16:0] current_x;
   reg [16:0] current_y;
 
-  reg [34:0] distance_buffer[899:0];
+  // The point counter also holds CONTOUR_POINTS, the count of a full contour
+  localparam CONTOUR_INDEX_WIDTH = $clog2(CONTOUR_POINTS + 1);
+
+  localparam CANDIDATE_INDEX_WIDTH = $clog2(PEAK_CANDIDATES + 1);
+
   // reg [34:0] max_distance;
-  reg [9:0] distance_buffer_index;
-  reg [9:0] max_distance_index;
+  reg [34:0] peak_threshold;  // Fraction of max_distance a peak must reach
+  reg [CONTOUR_INDEX_WIDTH - 1:0] distance_buffer_index;
+
+  // Peak candidates: contour point and squared distance of each local maximum
+  reg [CANDIDATE_INDEX_WIDTH - 1:0] candidate_count;
+  reg [CANDIDATE_INDEX_WIDTH - 1:0] candidate_index;
+  wire [CONTOUR_INDEX_WIDTH + 34:0] candidate_data_out;
+  wire [CONTOUR_INDEX_WIDTH - 1:0] candidate_point = candidate_data_out[CONTOUR_INDEX_WIDTH + 34:35];
+  wire [34:0] candidate_distance = candidate_data_out[34:0];
 
   reg signed [3:0] directions[0:7][0:1];
   reg [2:0] current_direction;
@@ -99,7 +250,13 @@ module img_processing (
   reg [16:0] prev_edge;
   reg [16:0] edge_candidate;
 
-  reg [9:0] prev_index;
+  // Column and row of prev_edge and edge_candidate, stepped along with the addresses
+  reg [16:0] edge_x;
+  reg [16:0] edge_y;
+  reg [16:0] candidate_x;
+  reg [16:0] candidate_y;
+
+  reg [CONTOUR_INDEX_WIDTH - 1:0] prev_index;
   reg [34:0] prev_distance;
   reg [34:0] prev_prev_distance;
   // reg [9:0] peaks;
@@ -113,35 +270,137 @@ module img_processing (
   wire signed [18:0] neighbor_offset;
   wire signed [18:0] neighbor_calc;
 
-  assign edge_offset = directions[(current_direction + direction_index) % 8][0] == 2 ?  prev_edge - 17'd320 : prev_edge + (directions[(current_direction + direction_index) % 8][0] * 320);
+  assign edge_offset = directions[(current_direction + direction_index) % 8][0] == 2 ?  prev_edge - width : prev_edge + (directions[(current_direction + direction_index) % 8][0] * width);
   assign edge_candidate_calc = directions[(current_direction + direction_index) % 8][1] == 2 ? edge_offset - 1 : edge_offset + directions[(current_direction + direction_index) % 8][1];
-  assign neighbor_offset = directions[neighbor_index][0] == 2 ?  edge_candidate - 17'd320 : edge_candidate + (directions[neighbor_index][0] * 320);
+
+  /* A column step past the frame border lands on the other border one row up or down, as the
+   * address does
+   */
+  wire [2:0] edge_direction = (current_direction + direction_index) % 8;
+  wire step_left = directions[edge_direction][1] == 2;
+  wire step_right = directions[edge_direction][1] == 1;
+  wire wrap_left = step_left && (edge_x == 17'd0);
+  wire wrap_right = step_right && (edge_x >= width - 17'd1);
+  wire [16:0] step_row = directions[edge_direction][0] == 2 ? edge_y - 17'd1 : edge_y + directions[edge_direction][0];
+  wire [16:0] candidate_x_calc = wrap_left ? width - 17'd1 : wrap_right ? 17'd0 :
+                                 step_left ? edge_x - 17'd1 : step_right ? edge_x + 17'd1 : edge_x;
+  wire [16:0] candidate_y_calc = wrap_left ? step_row - 17'd1 : wrap_right ? step_row + 17'd1 : step_row;
+
+  assign neighbor_offset = directions[neighbor_index][0] == 2 ?  edge_candidate - width : edge_candidate + (directions[neighbor_index][0] * width);
   assign neighbor_calc = directions[neighbor_index][1] == 2 ? neighbor_offset - 1 : neighbor_offset + directions[neighbor_index][1];
 
+  // Mask pixel at addr_read, clamped to the last pixel of the frame
+  wire [16:0] mask_pixel_addr = (addr_read <= last_pixel) ? addr_read : last_pixel;
+  wire mask_pixel = mask_data_in[mask_pixel_addr[4:0]];
+  wire [7:0] mask_value = mask_pixel ? 8'd255 : 8'd0;
+  assign mask_addr_read = mask_pixel_addr[16:5];
+
+  // The last pixel was never binarized by the separate passes, it keeps the compensated red
+  wire stream_bit = (stream_addr_3 == last_pixel && !chroma_frame) ? (last_red != 8'd0) :
+                    (stream_cb >= 90 && stream_cb <= 120 && stream_cr >= 139 && stream_cr <= 170);
+  wire morph_bit = morph_interior ? (eroded_up | eroded_left | eroded_center | eroded_right |
+                                     eroded_tap) : morph_border;
+
+  // The RGB channels are released once the pipeline of state 4 is done with them
+  assign frame_busy = active && !done && (state <= 4'd4);
+
+  /* The previous contour point is a peak candidate when it is a local maximum that is not
+   * already below the threshold of the running maximum, which only grows until state 13
+   */
+  wire new_candidate = (state == 4'd12) && (aux_index == 3'b000) && (distance_buffer_index >= 2) &&
+                       (prev_prev_distance <= prev_distance) && (prev_distance >= distance_squared) &&
+                       ((prev_distance + 1) * 1000 > max_distance * 510) &&
+                       (candidate_count < PEAK_CANDIDATES);
+
+  // The eroded pixels go through their line buffer one cycle behind the mask pixels
+  bram_line_buffer #(
+      .DEPTH(IMG_WIDTH),
+      .ADDR_WIDTH(LINE_ADDR_WIDTH)
+  ) mask_lines (
+      .clk(clk),
+      .restart(state != 4'd7),
+      .shift(morph_valid[0]),
+      .data_in(mask_tap),
+      .width(width),
+      .tap_right(mask_right),
+      .tap_center(mask_center),
+      .tap_left(mask_left),
+      .tap_up(mask_up)
+  );
+
+  bram_line_buffer #(
+      .DEPTH(IMG_WIDTH),
+      .ADDR_WIDTH(LINE_ADDR_WIDTH)
+  ) eroded_lines (
+      .clk(clk),
+      .restart(state != 4'd7),
+      .shift(morph_valid[1]),
+      .data_in(eroded_tap),
+      .width(width),
+      .tap_right(eroded_right),
+      .tap_center(eroded_center),
+      .tap_left(eroded_left),
+      .tap_up(eroded_up)
+  );
+
+  bram_candidate_storage #(
+      .DEPTH(PEAK_CANDIDATES),
+      .ADDR_WIDTH(CANDIDATE_INDEX_WIDTH),
+      .DATA_WIDTH(CONTOUR_INDEX_WIDTH + 35)
+  ) peak_candidates (
+      .clk(clk),
+      .addr_read(candidate_index),
+      .addr_write(candidate_count),
+      .we(new_candidate),
+      .data_in({distance_buffer_index - 1'b1, prev_distance}),
+      .data_out(candidate_data_out)
+  );
+
   assign dx = (current_x > reference_x) ? (current_x - reference_x) : (reference_x - current_x);
-  assign dy = (current_y > 17'd239) ? (current_y - 17'd239) : (17'd239 - current_y);
+  assign dy = (current_y > height - 17'd1) ? (current_y - (height - 17'd1)) : ((height - 17'd1) - current_y);
   assign distance_squared = (dx * dx) + (dy * dy);
 
   task init_values;
     begin
       state <= 4'd0;
       done <= 1'b0;
-      we <= 1'b0;
       addr_read <= 17'b0;
-      addr_write <= {17{1'b1}};
-      red_acumulator <= 25'b0;
-      green_acumulator <= 25'b0;
-      blue_acumulator <= 25'b0;
-      red_data_out <= 8'b0;
-      green_data_out <= 8'b0;
-      blue_data_out <= 8'b0;
+      mask_we <= 1'b0;
+      mask_addr_write <= 12'b0;
+      mask_data_out <= 32'b0;
       temp_blue <= 16'b0;
       temp_green <= 16'b0;
       temp_red <= 16'b0;
+      stream_reading <= 1'b0;
+      stream_valid <= 3'b0;
+      stream_addr_1 <= 17'b0;
+      stream_addr_2 <= 17'b0;
+      stream_addr_3 <= 17'b0;
+      chroma_frame <= 1'b0;
       morphology_index_collumn <= 17'b0;
       morphology_index_row <= 17'b0;
       aux_index <= 3'b0;
-      morphology_kernel <= 5'b0;
+      morph_shifting <= 1'b0;
+      morph_valid <= 2'b0;
+      morph_col <= 17'b0;
+      morph_row <= 17'b0;
+      morph_write <= 1'b0;
+      morph_interior <= 1'b0;
+      morph_border <= 1'b0;
+      morph_addr <= 17'b0;
+      morph_count <= 17'b0;
+      morph_out_col <= 17'b0;
+      morph_out_row <= 17'b0;
+      morph_stop_row <= 17'b0;
+      morph_write_row <= 17'b0;
+      morph_last <= 17'b0;
+      stream_col <= 17'b0;
+      stream_row <= 17'b0;
+      hand_found <= 1'b0;
+      hand_first_row <= 17'b0;
+      hand_last_row <= 17'b0;
+      hand_first_row_addr <= 17'b0;
+      hand_last_row_addr <= 17'b0;
       previous_pixel <= 8'b0;
       reference_x <= 17'b0;
       init_x <= 17'b0;
@@ -149,14 +408,20 @@ module img_processing (
       current_x <= 17'b0;
       current_y <= 17'b0;
       // max_distance <= 35'b0;
-      distance_buffer_index <= 10'b0;
-      max_distance_index <= 10'b0;
+      peak_threshold <= 35'b0;
+      distance_buffer_index <= {CONTOUR_INDEX_WIDTH{1'b0}};
+      candidate_count <= {CANDIDATE_INDEX_WIDTH{1'b0}};
+      candidate_index <= {CANDIDATE_INDEX_WIDTH{1'b0}};
       current_direction <= 3'b0;
       direction_index <= 4'b0;
       neighbor_index <= 4'b0;
       first_edge <= 17'b0;
       edge_candidate <= 17'b0;
-      prev_index <= 10'b0;
+      edge_x <= 17'b0;
+      edge_y <= 17'b0;
+      candidate_x <= 17'b0;
+      candidate_y <= 17'b0;
+      prev_index <= {CONTOUR_INDEX_WIDTH{1'b0}};
       prev_distance <= 35'b0;
       prev_prev_distance <= 35'b0;
       // peaks <= 10'b0;
@@ -180,6 +445,49 @@ module img_processing (
     end
   endtask
 
+  // Stage of the current state for the cycle counters (0 while idle)
+  wire [2:0] cycle_stage = (state >= 4'd2 && state <= 4'd4) ? 3'd1 :
+                           (state == 4'd7) ? 3'd2 :
+                           (state == 4'd12) ? 3'd3 :
+                           (state >= 4'd13) ? 3'd4 : 3'd0;
+
+  reg [31:0] cycle_counter;
+  reg [31:0] stage_start;
+  reg [31:0] frame_start;
+  reg [2:0] previous_stage;
+
+  always @(posedge clk) begin
+    if (!rst) begin
+      cycle_counter <= 32'd0;
+      stage_start <= 32'd0;
+      frame_start <= 32'd0;
+      previous_stage <= 3'd0;
+      cycles_binarization <= 32'd0;
+      cycles_morphology <= 32'd0;
+      cycles_contour <= 32'd0;
+      cycles_peaks <= 32'd0;
+      cycles_total <= 32'd0;
+    end else begin
+      cycle_counter <= cycle_counter + 32'd1;
+      if (cycle_stage != previous_stage) begin
+        previous_stage <= cycle_stage;
+        stage_start <= cycle_counter;
+        case (previous_stage)
+          3'd1: cycles_binarization <= cycle_counter - stage_start;
+          3'd2: cycles_morphology <= cycle_counter - stage_start;
+          3'd3: cycles_contour <= cycle_counter - stage_start;
+          3'd4: cycles_peaks <= cycle_counter - stage_start;
+          default: ;
+        endcase
+        if (previous_stage == 3'd0) begin
+          frame_start <= cycle_counter;
+        end else if (cycle_stage == 3'd0) begin
+          cycles_total <= cycle_counter - frame_start;
+        end
+      end
+    end
+  end
+
   always @(posedge clk) begin
     if (!rst) begin
       init_values;
@@ -187,7 +495,36 @@ module img_processing (
       case (state)
         4'd0: begin  // Wait for active signal
           if (active && !done) begin
-            state <= 4'd1;
+            hand_area <= 17'd0;
+            hand_perimeter <= 17'd0;
+            hand_box_left <= 16'hFFFF;
+            hand_box_top <= 16'hFFFF;
+            hand_box_right <= 16'd0;
+            hand_box_bottom <= 16'd0;
+            max_distance <= 35'd0;
+            reference_point_x <= 16'd0;
+            reference_point_y <= 16'd0;
+            peaks <= 10'd0;
+            classification <= 4'd0;
+            width <= frame_width;
+            height <= frame_height;
+            red_remainder <= red_sum;
+            green_remainder <= green_sum;
+            blue_remainder <= blue_sum;
+            mean_divisor <= (frame_width * frame_height) << 7;
+            mean_bit <= 3'd7;
+            last_pixel <= frame_width * frame_height - 17'd1;
+            last_row <= frame_width * frame_height - frame_width;
+            chroma_frame <= chroma;
+            if (chroma) begin
+              // Cb and Cr come from the host, straight to the binarization
+              addr_read <= 17'd0;
+              stream_reading <= 1'b1;
+              stream_valid <= 3'b0;
+              state <= 4'd4;
+            end else begin
+              state <= 4'd2;
+            end
           end else if (done) begin
             if (!active) begin
               done <= 1'b0;  // Reset done signal when active signal is low
@@ -196,29 +533,26 @@ module img_processing (
             init_values;
           end
         end
-        4'd1: begin  // Accumulate data for the mean calculation
-          hand_area <= 17'd0;
-          hand_perimeter <= 17'd0;
-          max_distance <= 35'd0;
-          peaks <= 10'd0;
-          classification <= 4'd0;
-
-          addr_read <= addr_read + 1'b1;
-          red_acumulator <= red_acumulator + red_data_in;
-          green_acumulator <= green_acumulator + green_data_in;
-          blue_acumulator <= blue_acumulator + blue_data_in;
-          red_mean <= red_acumulator[7:0];
-          if (addr_read >= 17'd76799) begin
-            state <= 4'd2;
+        4'd2: begin  // Calculate the mean for each channel, MSB first
+          red_mean <= {red_mean[6:0], red_remainder >= mean_divisor};
+          green_mean <= {green_mean[6:0], green_remainder >= mean_divisor};
+          blue_mean <= {blue_mean[6:0], blue_remainder >= mean_divisor};
+          if (red_remainder >= mean_divisor) begin
+            red_remainder <= red_remainder - mean_divisor;
           end
-        end
-        4'd2: begin  // Calculate the mean for each channel
-          red_mean <= (red_acumulator / 17'd76800);
-          green_mean <= (green_acumulator / 17'd76800);
-          blue_mean <= (blue_acumulator / 17'd76800);
+          if (green_remainder >= mean_divisor) begin
+            green_remainder <= green_remainder - mean_divisor;
+          end
+          if (blue_remainder >= mean_divisor) begin
+            blue_remainder <= blue_remainder - mean_divisor;
+          end
+          mean_divisor <= mean_divisor >> 1;
+          mean_bit <= mean_bit - 3'd1;
 
-          addr_read <= 17'd76799;
-          state <= 4'd3;
+          if (mean_bit == 3'd0) begin
+            addr_read <= last_pixel;
+            state <= 4'd3;
+          end
         end
         4'd3: begin  // Calculate the max mean
           if (red_mean > green_mean && red_mean > blue_mean) begin
@@ -229,323 +563,267 @@ module img_processing (
             max_mean <= blue_mean;
           end
 
-          // pre-calculate the 76799 pixel value
-          temp_red <= red_data_in * red_mean;
-          temp_green <= green_data_in * green_mean;
-          temp_blue <= blue_data_in * blue_mean;
-
           addr_read <= 17'd0;
-          addr_write <= {17{1'b1}};
+          stream_reading <= 1'b1;
+          stream_valid <= 3'b0;
           state <= 4'd4;
         end
-        4'd4: begin  // Execute the ilumination compesation
-          //todo: need time improvement
-          we <= 1'b1;
-          addr_read <= addr_read + 1'b1;
-          addr_write <= addr_read - 1'b1;
-
-          // Multiply current interation pixel by the channel mean
-          temp_red <= red_data_in * red_mean;
-          temp_green <= green_data_in * green_mean;
-          temp_blue <= blue_data_in * blue_mean;
-
-          // Divide previous interation result by the max mean
-          red_data_out <= temp_red / max_mean;
-          green_data_out <= temp_green / max_mean;
-          blue_data_out <= temp_blue / max_mean;
-
-          if (addr_read >= 17'd76799) begin
-            state <= 4'd5;
-            addr_read <= 17'd0;
-            addr_write <= 17'd0;
-          end
-        end
-        4'd5: begin  // Convert RGb to YCbCr
-          we <= 1'b1;
-          addr_read <= addr_read + 1'b1;
-          addr_write <= addr_read;
-
-          // Y
-          // red_data_out <= 16 + ((
-          //         (red_data_in<<6) + (red_data_in<<1) +
-          //         (green_data_in<<7) + green_data_in +
-          //         (blue_data_in<<4) + (blue_data_in<<3) + blue_data_in
-          //     )>>8);
-
-          // Cb
-          green_data_out <= 128 + ((
-                            -((red_data_in<<5) + (red_data_in<<2) + (red_data_in<<1)) -
-                            ((green_data_in<<6) + (green_data_in<<3) + (green_data_in<<1)) +
-                            (blue_data_in<<7) - (blue_data_in<<4)
-                        )>>8);
-
-          // Cr
-          blue_data_out <= 128 + ((
-                            (red_data_in<<7) - (red_data_in<<4) -
-                            ((green_data_in<<6) + (green_data_in<<5) - (green_data_in<<1)) -
-                            ((blue_data_in<<4) + (blue_data_in<<1))
-                        )>>8);
-
-          if (addr_read >= 17'd76799) begin
-            state <= 4'd6;
-            addr_read <= 17'd0;
-            addr_write <= 17'd0;
-          end
-        end
-        4'd6: begin  // binarization
-          we <= 1'b1;
-          addr_read <= addr_read + 1'b1;
-          addr_write <= addr_read;
-
-          if (green_data_in >= 90 && green_data_in <= 120 && blue_data_in >= 139 && blue_data_in <= 170) begin
-            red_data_out   <= 255;
-            green_data_out <= 255;
-            blue_data_out  <= 255;
-          end else begin
-            red_data_out   <= 0;
-            green_data_out <= 0;
-            blue_data_out  <= 0;
+        4'd4: begin  // Ilumination compesation, YCbCr conversion and binarization
+          // Stage 1: data_in belongs to addr_read, multiply it by the channel mean
+          if (stream_reading) begin
+            temp_red <= red_data_in * red_mean;
+            temp_green <= green_data_in * green_mean;
+            temp_blue <= blue_data_in * blue_mean;
+            pixel_red <= red_data_in;
+            pixel_green <= green_data_in;
+            pixel_blue <= blue_data_in;
+            stream_addr_1 <= addr_read;
+
+            if (addr_read >= last_pixel) begin
+              stream_reading <= 1'b0;
+            end else begin
+              addr_read <= addr_read + 1'b1;
+            end
           end
 
-          if (addr_read >= 17'd76799) begin
-            state <= 4'd7;
-            morphology_index_collumn <= 17'd1;
-            morphology_index_row <= 17'd320;
-            aux_index <= 3'b001;
-            addr_read <= 17'd1;
-            addr_write <= 17'd321;
-            we <= 1'b0;
-          end
-        end
-        4'd7: begin  // Erosion
-          if (aux_index >= 3'b110) begin
-            aux_index <= 3'b0;
-          end else begin
-            aux_index <= aux_index + 1'b1;
+          // Stage 2: divide by the max mean. The separate passes never compensated the
+          // penultimate pixel, keep it that way so the features do not change
+          if (stream_valid[0]) begin
+            if (chroma_frame || stream_addr_1 == last_pixel - 17'd1) begin
+              comp_red <= pixel_red;
+              comp_green <= pixel_green;
+              comp_blue <= pixel_blue;
+            end else begin
+              comp_red <= temp_red / max_mean;
+              comp_green <= temp_green / max_mean;
+              comp_blue <= temp_blue / max_mean;
+            end
+            stream_addr_2 <= stream_addr_1;
           end
 
-          if (aux_index == 3'b000) begin
-            we <= 1'b0;
-            addr_read <= morphology_index_collumn + morphology_index_row - 17'd320;
-          end else if (aux_index == 3'b001) begin
-            we <= 1'b0;
-            addr_read <= morphology_index_collumn + morphology_index_row - 17'd1;
-            morphology_kernel[0] <= red_data_in[0];
-          end else if (aux_index == 3'b010) begin
-            we <= 1'b0;
-            addr_read <= morphology_index_collumn + morphology_index_row;
-            morphology_kernel[1] <= red_data_in[0];
-          end else if (aux_index == 3'b011) begin
-            we <= 1'b0;
-            addr_read <= morphology_index_collumn + morphology_index_row + 17'd1;
-            morphology_kernel[2] <= red_data_in[0];
-          end else if (aux_index == 3'b100) begin
-            we <= 1'b0;
-            addr_read <= morphology_index_collumn + morphology_index_row + 17'd320;
-            morphology_kernel[3] <= red_data_in[0];
-          end else if (aux_index == 3'b101) begin
-            we <= 1'b0;
-            morphology_kernel[4] <= red_data_in[0];
-          end else if (aux_index == 3'b110) begin
-            we <= 1'b1;
-            addr_write <= morphology_index_collumn + morphology_index_row;
-
-            // Erosion
-            if (morphology_kernel[0] & morphology_kernel[1] & morphology_kernel[2] & morphology_kernel[3] & morphology_kernel[4]) begin
-              red_data_out   <= 8'd255;
-              blue_data_out  <= 8'd255;
-              green_data_out <= 8'd255;
-            end else if (morphology_kernel[2]) begin
-              red_data_out   <= 8'd1;
-              blue_data_out  <= 8'd1;
-              green_data_out <= 8'd1;
+          // Stage 3: Cb and Cr
+          if (stream_valid[1]) begin
+            if (chroma_frame) begin
+              stream_cb <= comp_green;
+              stream_cr <= comp_blue;
             end else begin
-              red_data_out   <= 8'd0;
-              blue_data_out  <= 8'd0;
-              green_data_out <= 8'd0;
+              stream_cb <= 128 + ((
+                              -((comp_red<<5) + (comp_red<<2) + (comp_red<<1)) -
+                              ((comp_green<<6) + (comp_green<<3) + (comp_green<<1)) +
+                              (comp_blue<<7) - (comp_blue<<4)
+                          )>>8);
+              stream_cr <= 128 + ((
+                              (comp_red<<7) - (comp_red<<4) -
+                              ((comp_green<<6) + (comp_green<<5) - (comp_green<<1)) -
+                              ((comp_blue<<4) + (comp_blue<<1))
+                          )>>8);
+            end
+            last_red <= comp_red;
+            stream_addr_3 <= stream_addr_2;
+          end
+
+          // Stage 4: binarization, one mask word written every 32 pixels. A partial last word
+          // is shifted down to bit 0
+          mask_we <= 1'b0;
+          if (stream_valid[2]) begin
+            // First and last rows with hand pixels and the addresses where they start
+            if (stream_bit) begin
+              if (!hand_found) begin
+                hand_first_row <= stream_row;
+                hand_first_row_addr <= stream_addr_3 - stream_col;
+              end
+              hand_found <= 1'b1;
+              hand_last_row <= stream_row;
+              hand_last_row_addr <= stream_addr_3 - stream_col;
             end
 
-            if (morphology_index_collumn >= 17'd318) begin
-              morphology_index_collumn <= 17'd1;
-              morphology_index_row <= morphology_index_row + 17'd320;
+            if (stream_col >= width - 17'd1) begin
+              stream_col <= 17'd0;
+              stream_row <= stream_row + 17'd1;
             end else begin
-              morphology_index_collumn <= morphology_index_collumn + 17'd1;
+              stream_col <= stream_col + 17'd1;
             end
-          end
 
-          if (addr_read >= 17'd76799) begin
-            state <= 4'd8;
-            addr_read <= 17'd0;
-            addr_write <= 17'd0;
-          end
-        end
-        4'd8: begin  // Erosion finalization
-          we <= 1'b1;
-          addr_read <= addr_read + 1'b1;
-          addr_write <= addr_read;
-
-          if (red_data_in < 8'd255) begin
-            red_data_out   <= 8'd0;
-            green_data_out <= 8'd0;
-            blue_data_out  <= 8'd0;
-          end else begin
-            red_data_out   <= 8'd255;
-            green_data_out <= 8'd255;
-            blue_data_out  <= 8'd255;
+            stream_word <= {stream_bit, stream_word[31:1]};
+            if (stream_addr_3[4:0] == 5'd31 || stream_addr_3 == last_pixel) begin
+              mask_we <= 1'b1;
+              mask_addr_write <= stream_addr_3[16:5];
+              mask_data_out <= {stream_bit, stream_word[31:1]} >> (5'd31 - stream_addr_3[4:0]);
+            end
           end
 
-          if (addr_read >= 17'd76799) begin
-            state <= 4'd9;
-            morphology_index_collumn <= 17'd1;
-            morphology_index_row <= 17'd320;
-            aux_index <= 3'b001;
-            addr_read <= 17'd1;
-            addr_write <= 17'd321;
-            we <= 1'b0;
+          stream_valid <= {stream_valid[1:0], stream_reading};
+
+          // The last write was issued on the previous cycle. The sweep starts two rows of
+          // zeros above the first hand row, which flush the line buffers, or at the first row
+          // when the top border would copy an unread row. It is skipped without hand pixels
+          if (!stream_reading && stream_valid == 3'b0) begin
+            state <= 4'd7;
+            morphology_index_collumn <= 17'd0;
+            morphology_index_row <= (hand_first_row >= 17'd4) ? hand_first_row - 17'd2 : 17'd0;
+            morph_shifting <= hand_found;
+            morph_valid <= 2'b0;
+            morph_write_row <= (hand_first_row >= 17'd2) ? hand_first_row : 17'd2;
+            morph_count <= (hand_first_row >= 17'd2) ? hand_first_row_addr - (width << 1) : 17'd0;
+            morph_stop_row <= (hand_last_row + 17'd5 < height + 17'd1) ? hand_last_row + 17'd5 :
+                              height + 17'd1;
+            morph_last <= (hand_last_row + 17'd4 < height) ?
+                          hand_last_row_addr + (width << 2) - 17'd1 : last_pixel;
+            morph_word <= 32'b0;
+            previous_pixel <= 8'd0;
+            addr_read <= (hand_first_row >= 17'd4) ? hand_first_row_addr - (width << 1) : 17'd0;
           end
         end
-        4'd9: begin  // Dilate
-          if (aux_index >= 3'b110) begin
-            aux_index <= 3'b0;
-          end else begin
-            aux_index <= aux_index + 1'b1;
-          end
-
-          if (aux_index == 3'b000) begin
-            we <= 1'b0;
-            addr_read <= morphology_index_collumn + morphology_index_row - 17'd320;
-          end else if (aux_index == 3'b001) begin
-            we <= 1'b0;
-            addr_read <= morphology_index_collumn + morphology_index_row - 17'd1;
-            morphology_kernel[0] <= red_data_in[0];
-          end else if (aux_index == 3'b010) begin
-            we <= 1'b0;
-            addr_read <= morphology_index_collumn + morphology_index_row;
-            morphology_kernel[1] <= red_data_in[0];
-          end else if (aux_index == 3'b011) begin
-            we <= 1'b0;
-            addr_read <= morphology_index_collumn + morphology_index_row + 17'd1;
-            morphology_kernel[2] <= red_data_in[0];
-          end else if (aux_index == 3'b100) begin
-            we <= 1'b0;
-            addr_read <= morphology_index_collumn + morphology_index_row + 17'd320;
-            morphology_kernel[3] <= red_data_in[0];
-          end else if (aux_index == 3'b101) begin
-            we <= 1'b0;
-            morphology_kernel[4] <= red_data_in[0];
-          end else if (aux_index == 3'b110) begin
-            we <= 1'b1;
-            addr_write <= morphology_index_collumn + morphology_index_row;
-
-            // Dilation
-            if (morphology_kernel[0] | morphology_kernel[1] | morphology_kernel[2] | morphology_kernel[3] | morphology_kernel[4]) begin
-              if (morphology_kernel[2]) begin
-                red_data_out   <= 8'd255;
-                blue_data_out  <= 8'd255;
-                green_data_out <= 8'd255;
-              end else begin
-                red_data_out   <= 8'd2;
-                blue_data_out  <= 8'd2;
-                green_data_out <= 8'd2;
-              end
-            end else begin
-              red_data_out   <= 8'd0;
-              blue_data_out  <= 8'd0;
-              green_data_out <= 8'd0;
+        4'd7: begin  // Erosion and dilation, one pixel per clock
+          // Stage 1: read the mask bit, which enters the line buffers on the next cycle. Rows
+          // of zeros past the frame flush the last rows out of the window
+          if (morph_shifting) begin
+            mask_tap <= (morphology_index_row < height) && mask_pixel;
+            morph_col <= morphology_index_collumn;
+            morph_row <= morphology_index_row;
+
+            if (addr_read < last_pixel) begin
+              addr_read <= addr_read + 1'b1;
             end
 
-            if (morphology_index_collumn >= 17'd318) begin
-              morphology_index_collumn <= 17'd1;
-              morphology_index_row <= morphology_index_row + 17'd320;
+            if (morphology_index_collumn >= width - 17'd1) begin
+              morphology_index_collumn <= 17'd0;
+              morphology_index_row <= morphology_index_row + 17'd1;
+              if (morphology_index_row >= morph_stop_row) begin
+                morph_shifting <= 1'b0;
+              end
             end else begin
               morphology_index_collumn <= morphology_index_collumn + 17'd1;
             end
           end
 
-          if (addr_read >= 17'd76799) begin
-            state <= 4'd10;
-            addr_read <= 17'd0;
-            addr_write <= 17'd0;
-          end
-        end
-        4'd10: begin  // dilate finalization
-          we <= 1'b1;
-          addr_read <= addr_read + 1'b1;
-          addr_write <= addr_read;
-
-          if (red_data_in > 8'd0) begin
-            red_data_out   <= 8'd255;
-            green_data_out <= 8'd255;
-            blue_data_out  <= 8'd255;
-          end else begin
-            red_data_out   <= 8'd0;
-            green_data_out <= 8'd0;
-            blue_data_out  <= 8'd0;
-          end
+          // Stage 2: erosion of the pixel one row above the newest one (cross kernel).
+          // Border pixels keep the binarized value
+          if (morph_valid[0]) begin
+            if (morph_row >= 17'd2 && morph_row <= height - 17'd1 && morph_col >= 17'd1 &&
+                morph_col <= width - 17'd2) begin
+              eroded_tap <= mask_up & mask_left & mask_center & mask_right & mask_tap;
+            end else begin
+              eroded_tap <= mask_center;
+            end
 
-          if (addr_read >= 17'd76799) begin
-            state <= 4'd11;
-            addr_read <= 17'd0;
+            // The pixel two rows above the newest one leaves the dilation window next cycle.
+            // Rows above the first hand row are only read to flush the line buffers
+            morph_write <= (morph_row >= morph_write_row);
+            morph_interior <= (morph_row >= 17'd3 && morph_row <= height && morph_col >= 17'd1 &&
+                               morph_col <= width - 17'd2);
+            morph_border <= mask_up;
+            morph_addr <= morph_count;
+            morph_out_col <= morph_col;
+            morph_out_row <= morph_row - 17'd2;
+            if (morph_row >= morph_write_row) begin
+              morph_count <= morph_count + 17'd1;
+            end
           end
-        end
-        4'd11: begin  // Calculate hand area and perimeter, find refecence point and init point
-          we <= 1'b0;
-          addr_read <= addr_read + 1'b1;
 
-          if (red_data_in > 8'b0) begin
-            hand_area <= hand_area + 17'd1;
-          end
+          // Stage 3: dilation (cross kernel), one mask word written every 32 pixels. The
+          // word being written is always behind the word being read
+          mask_we <= 1'b0;
+          if (morph_valid[1] && morph_write) begin
+            morph_word <= {morph_bit, morph_word[31:1]};
+            if (morph_addr[4:0] == 5'd31 || morph_addr == morph_last) begin
+              mask_we <= 1'b1;
+              mask_addr_write <= morph_addr[16:5];
+              mask_data_out <= {morph_bit, morph_word[31:1]} >> (5'd31 - morph_addr[4:0]);
+            end
 
-          if (red_data_in != previous_pixel) begin
-            hand_perimeter <= hand_perimeter + 17'd1;
+            // Hand area, bounding box and perimeter, init and reference points on the last row
+            if (morph_bit) begin
+              hand_area <= hand_area + 17'd1;
+              if (morph_out_col < hand_box_left) begin
+                hand_box_left <= morph_out_col;
+              end
+              if (morph_out_col > hand_box_right) begin
+                hand_box_right <= morph_out_col;
+              end
+              if (hand_box_top == 16'hFFFF) begin
+                hand_box_top <= morph_out_row;
+              end
+              hand_box_bottom <= morph_out_row;
+            end
 
-            if (addr_read >= 17'd76480) begin
-              if (init_x == 17'd0 && red_data_in == 8'd255) begin
-                init_x <= (addr_read >> 1);
-              end else if (init_x != 17'd0 && red_data_in == 8'd0) begin
-                reference_x <= ((addr_read >> 1) + init_x) - 17'd76480;
+            if (morph_bit != previous_pixel[0]) begin
+              hand_perimeter <= hand_perimeter + 17'd1;
+
+              if (morph_addr >= last_row) begin
+                if (init_x == 17'd0 && morph_bit) begin
+                  // The contour tracing never started from the last pixel
+                  if (morph_addr != last_pixel) begin
+                    init_x <= (morph_addr >> 1);
+                  end
+                end else if (init_x != 17'd0 && !morph_bit) begin
+                  reference_x <= ((morph_addr >> 1) + init_x) - last_row;
+                end
               end
             end
+
+            previous_pixel <= morph_bit ? 8'd255 : 8'd0;
           end
 
-          previous_pixel <= red_data_in;
+          morph_valid <= {morph_valid[0], morph_shifting};
 
-          if (addr_read >= 17'd76799) begin
-            // init_x <= (init_x<<1) - 17'd76479;
-            // init_y <= 17'd239;
-            current_x <= (init_x << 1) - 17'd76479;
-            current_y <= 17'd239;
+          // The last write was issued on the previous cycle
+          if (!morph_shifting && morph_valid == 2'b0) begin
+            current_x <= (init_x << 1) - (last_row - 17'd1);
+            current_y <= height - 17'd1;
             addr_read <= init_x << 1;
             first_edge <= init_x << 1;
             edge_candidate <= init_x << 1;
+            // The start is on the last row, or on the last pixel of the row above it when
+            // init_x << 1 drops below last_row, or at 0 without hand on the last row
+            if ((init_x << 1) >= last_row) begin
+              candidate_x <= (init_x << 1) - last_row;
+              candidate_y <= height - 17'd1;
+            end else if (init_x == 17'd0) begin
+              candidate_x <= 17'd0;
+              candidate_y <= 17'd0;
+            end else begin
+              candidate_x <= width - 17'd1;
+              candidate_y <= height - 17'd2;
+            end
             aux_index <= 3'b000;
-            distance_buffer_index <= 10'd0;
+            distance_buffer_index <= {CONTOUR_INDEX_WIDTH{1'b0}};
+            candidate_count <= {CANDIDATE_INDEX_WIDTH{1'b0}};
+            mask_we <= 1'b0;
             state <= 4'd12;
           end
         end
         4'd12: begin  // Find distance between reference point and edge pixels
           if (aux_index == 3'b000) begin // Calculate distance between reference point and edge pixels
-            distance_buffer[distance_buffer_index] <= distance_squared;
             distance_buffer_index <= distance_buffer_index + 1'd1;
+            if (new_candidate) begin  // Written to bram_candidate_storage on this cycle
+              candidate_count <= candidate_count + 1'b1;
+            end
             prev_edge <= edge_candidate;
+            edge_x <= candidate_x;
+            edge_y <= candidate_y;
             direction_index <= 3'd0;
             aux_index <= 3'b001;
             if (distance_squared > max_distance) begin
               max_distance <= distance_squared;
             end
-            if (distance_buffer_index == 10'd0) begin
+            if (distance_buffer_index == 0) begin
               prev_prev_distance <= distance_squared;
-            end
-            if (distance_buffer_index == 10'd1) begin
+            end else if (distance_buffer_index == 1) begin
+              prev_distance <= distance_squared;
+            end else begin
+              prev_prev_distance <= prev_distance;
               prev_distance <= distance_squared;
             end
-            if (distance_buffer_index >= 10'd899) begin
+            if (distance_buffer_index >= CONTOUR_POINTS - 1) begin
               state <= 4'd13;
             end
           end
           if (aux_index == 3'b001) begin  // Find next pixel
             addr_read <= edge_candidate_calc;
             edge_candidate <= edge_candidate_calc;
+            candidate_x <= candidate_x_calc;
+            candidate_y <= candidate_y_calc;
             if (direction_index > 3'd7) begin  // No edge pixel found
               state <= 4'd13;
             end
@@ -553,7 +831,7 @@ module img_processing (
             aux_index <= 3'b010;
           end
           if (aux_index == 3'b010) begin  // Check if next pixel is hand pixel
-            if (red_data_in > 8'd0) begin  // Is hand pixel
+            if (mask_value > 8'd0) begin  // Is hand pixel
               aux_index <= 3'b011;
               neighbor_index <= 3'b001;
               addr_read <= neighbor_calc;
@@ -563,11 +841,11 @@ module img_processing (
             end
           end
           if (aux_index == 3'b011) begin  // Check if next pixel in edge pixel
-            if (red_data_in == 8'd0) begin  // Edge pixel
+            if (mask_value == 8'd0) begin  // Edge pixel
               current_direction <= (current_direction + direction_index + 6) % 8;
-              current_x <= edge_candidate % 320;
-              current_y <= edge_candidate / 320;
-              if ((edge_candidate == first_edge) || ((edge_candidate / 320) >= 17'd239)) begin
+              current_x <= candidate_x;
+              current_y <= candidate_y;
+              if ((edge_candidate == first_edge) || (candidate_y >= height - 17'd1)) begin
                 state <= 4'd13;
               end else begin
                 aux_index <= 3'b000;
@@ -583,30 +861,19 @@ module img_processing (
           end
         end
         4'd13: begin  // Calculate threshold
-          max_distance <= (max_distance * 510) / 1000;
-          max_distance_index <= distance_buffer_index;
-          distance_buffer_index <= 10'd2;
+          peak_threshold <= (max_distance * 510) / 1000;
+          candidate_index <= {CANDIDATE_INDEX_WIDTH{1'b0}};
           state <= 4'd14;
         end
-        4'd14: begin  // Find peaks
-
-          if ((prev_prev_distance <= prev_distance) && (prev_distance >= distance_buffer[distance_buffer_index])) begin
-            if (prev_distance >= max_distance) begin
-              if ((distance_buffer_index - 1 - prev_index) > 10) begin
-                peaks <= peaks + 1'b1;
-                prev_index <= distance_buffer_index - 1'b1;
-              end
-            end
-          end
-
-          prev_distance <= distance_buffer[distance_buffer_index];
-          prev_prev_distance <= prev_distance;
-          distance_buffer_index <= distance_buffer_index + 1'b1;
-
-          if (distance_buffer_index >= max_distance_index) begin
+        4'd14: begin  // Find peaks, candidate_data_out holds the candidate at candidate_index
+          if (candidate_index >= candidate_count) begin
             state <= 4'd15;
-            // state <= 4'd0;
-            // done <= 1'b1;
+          end else begin
+            if ((candidate_distance >= peak_threshold) && ((candidate_point - prev_index) > 10)) begin
+              peaks <= peaks + 1'b1;
+              prev_index <= candidate_point;
+            end
+            candidate_index <= candidate_index + 1'b1;
           end
         end
         4'd15: begin  // Classify hand
@@ -650,6 +917,10 @@ module img_processing (
             classification <= 4'd7;
           end
 
+          // reference_x is cleared with the other working registers once PDI is idle
+          reference_point_x <= reference_x;
+          reference_point_y <= height - 17'd1;
+
           state <= 4'd0;
           done  <= 1'b1;
         end
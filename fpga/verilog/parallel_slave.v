@@ -0,0 +1,66 @@
+/*
+ * Module Name: parallel_slave.
+ *
+ * Description: Receives whole bytes from the HPS through the par_out/par_in PIOs.
+ *
+ * Inputs:
+ *    clk - Main clock signal
+ *    rst - Reset signal
+ *    bus_in - {strobe, byte} from the par_out PIO
+ *    din - Input byte data to be sent
+ *
+ * Outputs:
+ *    bus_out - {ack, byte} to the par_in PIO
+ *    done - Signal that indicates when a byte was received (same meaning as in spi_slave)
+ *    dout - Output byte data received
+ *
+ * Functionality:
+ *    Drop-in replacement for spi_slave on the data_transfer_controller side.
+ *    The HPS flips the strobe bit on every write; each change is one received byte.
+ *    On a change, the byte is output on dout with done for one cycle and din is latched on
+ *    bus_out, so the byte returned for a write is the one left by the previous write, as
+ *    with MISO. ack follows the strobe once the returned byte is valid.
+ *    bus_in is sampled once per clock cycle, so each strobe value must be held for at least
+ *    one cycle; a host that does not wait for ack between writes has to ensure that itself.
+ */
+
+module parallel_slave (
+    input clk,  //execution clock
+    input rst,  //module reset
+    input [8:0] bus_in,  //{strobe, data} from the HPS
+    output [8:0] bus_out,  //{ack, data} to the HPS
+    output done,  //signal indicating transfer completed
+    input [7:0] din,  //input data
+    output [7:0] dout  //output data
+);
+
+  reg strobe_q;
+  reg ack_q;
+  reg done_q;
+  reg [7:0] dout_q;
+  reg [7:0] tx_q;
+
+  assign bus_out = {ack_q, tx_q};
+  assign done = done_q;
+  assign dout = dout_q;
+
+  always @(posedge clk) begin
+    if (!rst) begin
+      strobe_q <= bus_in[8];  // resume from the current strobe, no spurious byte
+      ack_q    <= bus_in[8];
+      done_q   <= 1'b0;
+      dout_q   <= 8'b0;
+      tx_q     <= 8'b0;
+    end else begin
+      done_q <= 1'b0;
+      if (bus_in[8] != strobe_q) begin  // new byte
+        strobe_q <= bus_in[8];
+        dout_q   <= bus_in[7:0];
+        tx_q     <= din;  // byte left by the previous transfer
+        ack_q    <= bus_in[8];
+        done_q   <= 1'b1;
+      end
+    end
+  end
+
+endmodule
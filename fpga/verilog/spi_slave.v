@@ -20,6 +20,9 @@
  *    Performs SPI communication.
  *    When selected by the master (ss), it sends and receives a bit every sck cycle.
  *    When one byte is received and sent, the done signal is set.
+ *    Several bytes may be exchanged under a single ss window: one cycle after done the
+ *    outgoing shift register is reloaded from din, since the consumer only updates din on the
+ *    clock edge that follows done.
  *    Source: https://alchitry.com/serial-peripheral-interface-spi-verilog (removed from the website?)
  */
 
@@ -44,6 +47,7 @@ module spi_slave (
   reg [2:0] bit_ct_d, bit_ct_q;
   reg [7:0] dout_d, dout_q;
   reg miso_d, miso_q;
+  reg reload_d, reload_q;
 
   assign miso = miso_q;
   assign done = done_q;
@@ -59,6 +63,7 @@ module spi_slave (
     done_d = 1'b0;
     bit_ct_d = bit_ct_q;
     dout_d = dout_q;
+    reload_d = done_q;  // din is valid one cycle after done
 
     if (ss_q) begin  // if slave select is high (deselcted)
       bit_ct_d = 3'b0;  // reset bit counter
@@ -73,6 +78,11 @@ module spi_slave (
           done_d = 1'b1;  // set transfer done flag
           data_d = din;  // read in new byte
         end
+      end else if (reload_q) begin  // reload the byte updated by the consumer
+        data_d = din;
+        if (sck_old_q && !sck_q) begin  // falling edge on the same cycle
+          miso_d = din[7];
+        end
       end else if (sck_old_q && !sck_q) begin  // falling edge
         miso_d = data_q[7];  // output MSB
       end
@@ -85,11 +95,13 @@ module spi_slave (
       bit_ct_q <= 3'b0;
       dout_q   <= 8'b0;
       miso_q   <= 1'b1;
+      reload_q <= 1'b0;
     end else begin
       done_q   <= done_d;
       bit_ct_q <= bit_ct_d;
       dout_q   <= dout_d;
       miso_q   <= miso_d;
+      reload_q <= reload_d;
     end
 
     sck_q <= sck_d;
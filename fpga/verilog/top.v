@@ -109,43 +109,125 @@ module top (
 
 	wire [2:0] state;
 
+	// Frame banks of the image BRAMs. Two banks let the host upload frame N+1 while frame N
+	// is processed, but they take 450 M10K blocks and the 5CSEMA5 has 397
+	localparam FRAME_BANKS = 1;
+
+	// Largest frame geometry; the host may select any smaller one at runtime
+	localparam IMG_WIDTH = 320;
+	localparam IMG_HEIGHT = 240;
+
+	// Longest contour traced and peak candidates kept on the way (2 M10K blocks)
+	localparam CONTOUR_POINTS = 4096;
+	localparam PEAK_CANDIDATES = 256;
+
+	// SCK, MOSI and SS share one PIO so that every half clock is a single HPS store
+	wire [2:0] spi_ctrl;
+	assign fpga_sck = spi_ctrl[0];
+	assign fpga_mosi = spi_ctrl[1];
+	assign fpga_s0 = spi_ctrl[2];
+
 	// SPI wires
 	wire spi_cycle_done;
 	wire [7:0] data_to_send;
 	wire [7:0] data_received;
+	wire spi_done;
+	wire [7:0] spi_data_received;
+
+	// Parallel link wires (par_out/par_in PIOs)
+	wire [8:0] par_out;
+	wire [8:0] par_in;
+	wire par_done;
+	wire [7:0] par_data_received;
+
+	// The data_transfer_controller is fed by whichever link delivered a byte
+	assign spi_cycle_done = spi_done | par_done;
+	assign data_received = par_done ? par_data_received : spi_data_received;
 	
 	// BRAM wires
 	wire com_we;
-	wire pdi_we;
+	wire com_wstrobe;
+	wire com_sum_clear;
 	wire [1:0] bram_channel;
+	wire com_bank;
+	wire pdi_bank;
+	wire pdi_chroma;
 	wire [7:0] bram_data_in;
 	wire [7:0] bram_data_out;
 	wire [16:0] com_addr;
 	wire [16:0] pdi_addr_read;
-	wire [16:0] pdi_addr_write;
+	wire com_mask;
+	wire pdi_mask_we;
+	wire [11:0] pdi_mask_addr_read;
+	wire [11:0] pdi_mask_addr_write;
+	wire [31:0] pdi_mask_data_in;
+	wire [31:0] pdi_mask_data_out;
 
 	// Image processing wires
 	wire pdi_active;
 	wire pdi_done;
-	wire [7:0] red_data_in;
-	wire [7:0] green_data_in;
-	wire [7:0] blue_data_in;
+	wire pdi_frame_busy;
 	wire [7:0] red_data_out;
 	wire [7:0] green_data_out;
 	wire [7:0] blue_data_out;
+	wire [24:0] red_sum;
+	wire [24:0] green_sum;
+	wire [24:0] blue_sum;
 	wire [16:0] hand_area;
 	wire [16:0] hand_perimeter;
 	wire [34:0] max_distance;
 	wire [9:0] peaks;
 	wire [3:0] classification;
+	wire [15:0] frame_height;
+	wire [15:0] frame_width;
+	wire [15:0] roi_y;
+	wire [15:0] roi_x;
+	wire [15:0] hand_box_left;
+	wire [15:0] hand_box_top;
+	wire [15:0] hand_box_right;
+	wire [15:0] hand_box_bottom;
+	wire [31:0] cycles_binarization;
+	wire [31:0] cycles_morphology;
+	wire [31:0] cycles_contour;
+	wire [31:0] cycles_peaks;
+	wire [31:0] cycles_total;
+	wire [15:0] reference_point_x;
+	wire [15:0] reference_point_y;
+
+	// HPS memory window wires
+	wire [18:0] window_address;
+	wire window_read;
+	wire window_write;
+	wire [31:0] window_writedata;
+	wire [3:0] window_byteenable;
+	wire [31:0] window_readdata;
+	wire window_readdatavalid;
+	wire window_waitrequest;
+	wire mm_sel;
+	wire [16:0] mm_addr;
+	wire [1:0] mm_channel;
+	wire mm_bank;
+	wire mm_we;
+	wire mm_mask;
+	wire mm_sum_clear;
+	wire [7:0] mm_data_in;
+	wire hps_pdi_start;
+	wire hps_pdi_bank;
+	wire hps_pdi_chroma;
+	wire hps_geometry_write;
+	wire [15:0] hps_geometry_height;
+	wire [15:0] hps_geometry_width;
+	wire hps_roi_write;
+	wire [15:0] hps_roi_y;
+	wire [15:0] hps_roi_x;
 	
 	// LEDs assignments
 	assign led0 = state[0];
 	assign led1 = state[1];
 	assign led2 = state[2];
-	assign led3 = pdi_addr_write[0];
-	assign led4 = pdi_addr_write[1];
-	assign led5 = pdi_addr_write[2];
+	assign led3 = pdi_addr_read[0];
+	assign led4 = pdi_addr_read[1];
+	assign led5 = pdi_addr_read[2];
 	assign led6 = fpga_miso;
 	assign led7 = fpga_mosi;
 	assign led8 = fpga_s0;
@@ -174,49 +256,94 @@ module top (
 
 
 	// Image processing modules
-	img_processing img_proc (
+	img_processing #(
+		.IMG_WIDTH(IMG_WIDTH),
+		.CONTOUR_POINTS(CONTOUR_POINTS),
+		.PEAK_CANDIDATES(PEAK_CANDIDATES)
+	) img_proc (
 		.clk(clk),
 		.rst(rst),
 		.active(pdi_active),
+		.chroma(pdi_chroma),
 		.done(pdi_done),
+		.frame_busy(pdi_frame_busy),
 		.red_data_in(red_data_out),
 		.green_data_in(green_data_out),
 		.blue_data_in(blue_data_out),
-		.red_data_out(red_data_in),
-		.green_data_out(green_data_in),
-		.blue_data_out(blue_data_in),
-		.we(pdi_we),
+		.red_sum(red_sum),
+		.green_sum(green_sum),
+		.blue_sum(blue_sum),
 		.addr_read(pdi_addr_read),
-		.addr_write(pdi_addr_write),
+		.mask_we(pdi_mask_we),
+		.mask_addr_read(pdi_mask_addr_read),
+		.mask_addr_write(pdi_mask_addr_write),
+		.mask_data_out(pdi_mask_data_in),
+		.mask_data_in(pdi_mask_data_out),
+		.frame_height(frame_height),
+		.frame_width(frame_width),
 		.hand_area(hand_area),
 		.hand_perimeter(hand_perimeter),
 		.max_distance(max_distance),
 		.peaks(peaks),
-		.classification(classification)
+		.classification(classification),
+		.hand_box_left(hand_box_left),
+		.hand_box_top(hand_box_top),
+		.hand_box_right(hand_box_right),
+		.hand_box_bottom(hand_box_bottom),
+		.cycles_binarization(cycles_binarization),
+		.cycles_morphology(cycles_morphology),
+		.cycles_contour(cycles_contour),
+		.cycles_peaks(cycles_peaks),
+		.cycles_total(cycles_total),
+		.reference_point_x(reference_point_x),
+		.reference_point_y(reference_point_y)
 	);
 	
 	// Storage modules
-	bram_controller bram_ctrl (
+	bram_controller #(
+		.FRAME_BANKS(FRAME_BANKS),
+		.PIXELS(IMG_WIDTH * IMG_HEIGHT)
+	) bram_ctrl (
 		.clk(clk),
 		.com_addr(com_addr),
 		.pdi_addr_read(pdi_addr_read),
-		.pdi_addr_write(pdi_addr_write),
 		.channel(bram_channel),
+		.com_bank(com_bank),
+		.pdi_bank(pdi_bank),
 		.com_we(com_we),
-		.pdi_we(pdi_we),
+		.com_wstrobe(com_wstrobe),
+		.com_mask(com_mask),
+		.com_sum_clear(com_sum_clear),
 		.pdi_active(pdi_active),
+		.pdi_frame_busy(pdi_frame_busy),
 		.data_in(bram_data_in),
+		.mm_sel(mm_sel),
+		.mm_addr(mm_addr),
+		.mm_channel(mm_channel),
+		.mm_bank(mm_bank),
+		.mm_we(mm_we),
+		.mm_data_in(mm_data_in),
+		.mm_mask(mm_mask),
+		.mm_sum_clear(mm_sum_clear),
 		.data_out(bram_data_out),
-		.red_data_in(red_data_in),
-		.green_data_in(green_data_in),
-		.blue_data_in(blue_data_in),
 		.red_data_out(red_data_out),
 		.green_data_out(green_data_out),
-		.blue_data_out(blue_data_out)
+		.blue_data_out(blue_data_out),
+		.red_sum(red_sum),
+		.green_sum(green_sum),
+		.blue_sum(blue_sum),
+		.pdi_mask_addr_read(pdi_mask_addr_read),
+		.pdi_mask_addr_write(pdi_mask_addr_write),
+		.pdi_mask_we(pdi_mask_we),
+		.pdi_mask_data_in(pdi_mask_data_in),
+		.pdi_mask_data_out(pdi_mask_data_out)
 	);
 	
 	// Communication modules
-	data_transfer_controller dtc (
+	data_transfer_controller #(
+		.IMG_WIDTH(IMG_WIDTH),
+		.IMG_HEIGHT(IMG_HEIGHT)
+	) dtc (
 		.clk(clk),
 		.rst(rst),
 		.spi_cycle_done(spi_cycle_done),
@@ -224,19 +351,107 @@ module top (
 		.spi_byte_out(data_to_send),
 		.bram_addr(com_addr),
 		.bram_channel(bram_channel),
+		.bram_bank(com_bank),
 		.bram_we(com_we),
+		.bram_wstrobe(com_wstrobe),
+		.bram_sum_clear(com_sum_clear),
 		.bram_data_in(bram_data_in),
+		.bram_mask(com_mask),
 		.bram_data_out(bram_data_out),
 		.pdi_active(pdi_active),
+		.pdi_bank(pdi_bank),
+		.pdi_chroma(pdi_chroma),
 		.pdi_done(pdi_done),
+		.hps_pdi_start(hps_pdi_start),
+		.hps_pdi_bank(hps_pdi_bank),
+		.hps_pdi_chroma(hps_pdi_chroma),
+		.hps_geometry_write(hps_geometry_write),
+		.hps_geometry_height(hps_geometry_height),
+		.hps_geometry_width(hps_geometry_width),
+		.frame_height(frame_height),
+		.frame_width(frame_width),
+		.hps_roi_write(hps_roi_write),
+		.hps_roi_y(hps_roi_y),
+		.hps_roi_x(hps_roi_x),
+		.roi_y(roi_y),
+		.roi_x(roi_x),
 		.hand_area(hand_area),
 		.hand_perimeter(hand_perimeter),
 		.state(state),
 		.max_distance(max_distance),
 		.peaks(peaks),
-		.classification(classification)
+		.classification(classification),
+		.hand_box_left(hand_box_left),
+		.hand_box_top(hand_box_top),
+		.hand_box_right(hand_box_right),
+		.hand_box_bottom(hand_box_bottom),
+		.cycles_binarization(cycles_binarization),
+		.cycles_morphology(cycles_morphology),
+		.cycles_contour(cycles_contour),
+		.cycles_peaks(cycles_peaks),
+		.cycles_total(cycles_total),
+		.reference_point_x(reference_point_x),
+		.reference_point_y(reference_point_y)
 	);
 	
+	// Direct access to the BRAMs and results through the lightweight bridge
+	hps_bram_window #(
+		.FRAME_BANKS(FRAME_BANKS)
+	) window (
+		.clk(clk),
+		.rst(rst),
+		.address(window_address),
+		.read(window_read),
+		.write(window_write),
+		.writedata(window_writedata),
+		.byteenable(window_byteenable),
+		.readdata(window_readdata),
+		.readdatavalid(window_readdatavalid),
+		.waitrequest(window_waitrequest),
+		.bram_sel(mm_sel),
+		.bram_addr(mm_addr),
+		.bram_channel(mm_channel),
+		.bram_bank(mm_bank),
+		.bram_we(mm_we),
+		.bram_mask(mm_mask),
+		.bram_sum_clear(mm_sum_clear),
+		.bram_data_in(mm_data_in),
+		.bram_data_out(bram_data_out),
+		.pdi_active(pdi_active),
+		.pdi_frame_busy(pdi_frame_busy),
+		.pdi_bank(pdi_bank),
+		.pdi_chroma(pdi_chroma),
+		.pdi_start(hps_pdi_start),
+		.pdi_start_bank(hps_pdi_bank),
+		.pdi_start_chroma(hps_pdi_chroma),
+		.hand_area(hand_area),
+		.hand_perimeter(hand_perimeter),
+		.peaks(peaks),
+		.classification(classification),
+		.frame_height(frame_height),
+		.frame_width(frame_width),
+		.geometry_write(hps_geometry_write),
+		.geometry_height(hps_geometry_height),
+		.geometry_width(hps_geometry_width),
+		.roi_y(roi_y),
+		.roi_x(roi_x),
+		.roi_write(hps_roi_write),
+		.roi_new_y(hps_roi_y),
+		.roi_new_x(hps_roi_x),
+		.hand_box_left(hand_box_left),
+		.hand_box_top(hand_box_top),
+		.hand_box_right(hand_box_right),
+		.hand_box_bottom(hand_box_bottom),
+		.cycles_binarization(cycles_binarization),
+		.cycles_morphology(cycles_morphology),
+		.cycles_contour(cycles_contour),
+		.cycles_peaks(cycles_peaks),
+		.cycles_total(cycles_total),
+		.max_distance(max_distance),
+		.reference_point_x(reference_point_x),
+		.reference_point_y(reference_point_y)
+	);
+
 //	spi_slave_2 spi(
 //		.i_Rst_L(rst),
 //		.i_Clk(clk),
@@ -257,11 +472,21 @@ module top (
  	.mosi(fpga_mosi),
  	.miso(fpga_miso),
  	.sck(fpga_sck),
- 	.done(spi_cycle_done),
+ 	.done(spi_done),
  	.din(data_to_send),
- 	.dout(data_received)
+ 	.dout(spi_data_received)
  );
 
+	parallel_slave par(
+		.clk(clk),
+		.rst(rst),
+		.bus_in(par_out),
+		.bus_out(par_in),
+		.done(par_done),
+		.din(data_to_send),
+		.dout(par_data_received)
+	);
+
 	// spi_slave_3 spi(
 	// 	.clk(clk),
 	// 	.rst(rst),
@@ -293,8 +518,10 @@ module top (
         .memory_mem_dm                      (HPS_DDR3_DM),                      //                            .mem_dm
         .memory_oct_rzqin                   (HPS_DDR3_RZQ),                   //                            .oct_rzqin
         .hps_0_h2f_reset_reset_n            (not_used_hsf),            //             hps_0_h2f_reset.reset_n
-        .spi_out_external_connection_export (fpga_mosi), // spi_out_external_connection.export
         .spi_in_external_connection_export  (fpga_miso),  //  spi_in_external_connection.export
+        .par_out_external_connection_export (par_out),    // par_out_external_connection.export
+        .par_in_external_connection_export  (par_in),     //  par_in_external_connection.export
+        .pdi_irq_external_connection_export (pdi_done),   // pdi_irq_external_connection.export
         .reset_reset_n                      (1),                      //                       reset.reset_n
         .hps_io_hps_io_emac1_inst_TX_CLK    (HPS_ENET_GTX_CLK),    //                      hps_io.hps_io_emac1_inst_TX_CLK
         .hps_io_hps_io_emac1_inst_TXD0      (HPS_ENET_TX_DATA[0]),      //                            .hps_io_emac1_inst_TXD0
@@ -330,8 +557,17 @@ module top (
         .hps_io_hps_io_usb1_inst_NXT        (HPS_USB_NXT),        //                            .hps_io_usb1_inst_NXT
         .hps_io_hps_io_uart0_inst_RX        (HPS_UART_RX),        //                            .hps_io_uart0_inst_RX
         .hps_io_hps_io_uart0_inst_TX        (HPS_UART_TX),        //                            .hps_io_uart0_inst_TX
-        .spi_sck_external_connection_export (fpga_sck), // spi_sck_external_connection.export
-        .spi_ss_external_connection_export  (fpga_s0)   //  spi_ss_external_connection.export
+        .spi_ctrl_external_connection_export (spi_ctrl), // spi_ctrl_external_connection.export
+        .bram_window_waitrequest            (window_waitrequest),   //                 bram_window.waitrequest
+        .bram_window_readdata               (window_readdata),      //                            .readdata
+        .bram_window_readdatavalid          (window_readdatavalid), //                            .readdatavalid
+        .bram_window_burstcount             (),                     //                            .burstcount
+        .bram_window_writedata              (window_writedata),     //                            .writedata
+        .bram_window_address                (window_address),       //                            .address
+        .bram_window_write                  (window_write),         //                            .write
+        .bram_window_read                   (window_read),          //                            .read
+        .bram_window_byteenable             (window_byteenable),    //                            .byteenable
+        .bram_window_debugaccess            ()                      //                            .debugaccess
     );
 
 
@@ -0,0 +1,228 @@
+#include "bridge.h"
+#include "spi.h"
+#include "hps_0.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* Acesso pelo driver pdi_bridge (driver/pdi_bridge.c), que mapeia só as regiões da FPGA; sem
+ * root com a regra udev driver/99-pdi-bridge.rules. Cada mmap escolhe a região pelo offset (índice * página):
+ *   BRIDGE_MAP_CTRL   -> PIOs do link, strongly-ordered
+ *   BRIDGE_MAP_PIXELS -> canais do hps_bram_window, write-combining
+ *   BRIDGE_MAP_REGS   -> registradores e máscara do hps_bram_window, strongly-ordered
+ * O mesmo descritor entrega a interrupção do pdi_irq com a semântica do UIO.
+ */
+#ifndef BRIDGE_DEVICE
+#define BRIDGE_DEVICE "/dev/pdi_bridge"
+#endif
+
+enum bridge_map {
+	BRIDGE_MAP_CTRL = 0,
+	BRIDGE_MAP_PIXELS,
+	BRIDGE_MAP_REGS,
+};
+
+#define BRIDGE_CTRL_SPAN   0x1000
+#define BRIDGE_PIXELS_SPAN WINDOW_REGS_OFST
+#define BRIDGE_REGS_SPAN   0x8000
+
+// Registradores do altera_avalon_pio
+#define PIO_IRQ_MASK_OFST     0x8
+#define PIO_EDGE_CAPTURE_OFST 0xC
+
+static int bridge_fd = -1;
+static void *ctrl_base = NULL;
+static volatile uint8_t *pixels_base = NULL;
+static volatile uint8_t *regs_base = NULL;
+static volatile uint32_t *pdi_irq_addr = NULL;
+
+static void *bridge_map(enum bridge_map map, size_t span)
+{
+	void *addr = mmap(NULL, span, (PROT_READ | PROT_WRITE), MAP_SHARED, bridge_fd,
+			  map * sysconf(_SC_PAGESIZE));
+	return (addr == MAP_FAILED) ? NULL : addr;
+}
+
+/* Escritas write-combining podem ficar no buffer do processador; a barreira garante que os
+ * pixels chegaram à FPGA antes de um acesso aos registradores (ex.: início do PDI).
+ */
+static inline void bridge_barrier()
+{
+#if defined(__arm__)
+	__asm__ volatile("dsb" ::: "memory");
+#else
+	__sync_synchronize();
+#endif
+}
+
+int bridge_open()
+{
+	if (bridge_fd >= 0) {
+		return 0;
+	}
+
+	if ((bridge_fd = open(BRIDGE_DEVICE, O_RDWR)) == -1) {
+		printf("ERROR: could not open \"%s\"...\n", BRIDGE_DEVICE);
+		return -EIO;
+	}
+
+	ctrl_base = bridge_map(BRIDGE_MAP_CTRL, BRIDGE_CTRL_SPAN);
+	pixels_base = bridge_map(BRIDGE_MAP_PIXELS, BRIDGE_PIXELS_SPAN);
+	regs_base = bridge_map(BRIDGE_MAP_REGS, BRIDGE_REGS_SPAN);
+
+	if (ctrl_base == NULL || pixels_base == NULL || regs_base == NULL) {
+		printf("ERROR: mmap() failed...\n");
+		bridge_close();
+		return -EFAULT;
+	}
+
+#if DEBUG == 1
+	printf("Bridge mapeado via %s\n", BRIDGE_DEVICE);
+#endif
+
+	pdi_irq_addr = bridge_lw_addr(PDI_IRQ_BASE);
+	return 0;
+}
+
+void bridge_close()
+{
+	if (bridge_fd < 0) {
+		return;
+	}
+
+	if (pdi_irq_addr != NULL) {
+		pdi_irq_addr[PIO_IRQ_MASK_OFST / sizeof(uint32_t)] = 0x0;
+	}
+
+	if (ctrl_base != NULL) {
+		munmap(ctrl_base, BRIDGE_CTRL_SPAN);
+	}
+	if (pixels_base != NULL) {
+		munmap((void *)pixels_base, BRIDGE_PIXELS_SPAN);
+	}
+	if (regs_base != NULL) {
+		munmap((void *)regs_base, BRIDGE_REGS_SPAN);
+	}
+
+	close(bridge_fd);
+	bridge_fd = -1;
+	ctrl_base = NULL;
+	pixels_base = NULL;
+	regs_base = NULL;
+	pdi_irq_addr = NULL;
+}
+
+// Endereço virtual de um PIO do link; offset é a base do hps_0.h (< BRIDGE_CTRL_SPAN)
+volatile void *bridge_lw_addr(uint32_t offset)
+{
+	return ctrl_base + offset;
+}
+
+// Cada store de 32 bits vira quatro escritas de pixel no hps_bram_window
+void bridge_write_channel(uint8_t channel, const uint8_t *buf, size_t len)
+{
+	volatile uint8_t *base = pixels_base + WINDOW_CHANNEL_OFST(channel);
+	volatile uint32_t *dst = (volatile uint32_t *)base;
+	size_t words = len / sizeof(uint32_t);
+
+	// Little-endian: o pixel de menor endereço vai no byte menos significativo da palavra
+	for (size_t i = 0; i < words; i++) {
+		uint32_t word;
+		memcpy(&word, buf + i * sizeof(uint32_t), sizeof(word));
+		dst[i] = word;
+	}
+
+	// Bytes restantes: o byteenable do barramento limita a escrita ao pixel
+	for (size_t i = words * sizeof(uint32_t); i < len; i++) {
+		base[i] = buf[i];
+	}
+
+	bridge_barrier();
+}
+
+void bridge_read_channel(uint8_t channel, uint8_t *buf, size_t len)
+{
+	volatile uint8_t *base = pixels_base + WINDOW_CHANNEL_OFST(channel);
+	volatile uint32_t *src = (volatile uint32_t *)base;
+
+	bridge_barrier(); // Escritas pendentes antes das leituras
+	size_t words = len / sizeof(uint32_t);
+
+	for (size_t i = 0; i < words; i++) {
+		uint32_t word = src[i];
+		memcpy(buf + i * sizeof(uint32_t), &word, sizeof(word));
+	}
+
+	for (size_t i = words * sizeof(uint32_t); i < len; i++) {
+		buf[i] = base[i];
+	}
+}
+
+// Máscara lida em palavras de 32 bits; o byte n fica no byte lane n % 4
+void bridge_read_mask(uint8_t *buf, size_t len)
+{
+	volatile uint8_t *base = regs_base + WINDOW_MASK_OFST;
+	volatile uint32_t *src = (volatile uint32_t *)base;
+	size_t words = len / sizeof(uint32_t);
+
+	for (size_t i = 0; i < words; i++) {
+		uint32_t word = src[i];
+		memcpy(buf + i * sizeof(uint32_t), &word, sizeof(word));
+	}
+
+	for (size_t i = words * sizeof(uint32_t); i < len; i++) {
+		buf[i] = base[i];
+	}
+}
+
+uint32_t bridge_read_reg(uint32_t reg)
+{
+	return *(volatile uint32_t *)(regs_base + reg);
+}
+
+void bridge_write_reg(uint32_t reg, uint32_t value)
+{
+	*(volatile uint32_t *)(regs_base + reg) = value;
+}
+
+// Prepara a interrupção antes de iniciar o PDI, para não perder um pdi_done rápido
+int bridge_pdi_irq_arm()
+{
+	uint32_t enable = 1;
+
+	if (bridge_fd < 0) {
+		return -ENOTSUP;
+	}
+
+	pdi_irq_addr[PIO_EDGE_CAPTURE_OFST / sizeof(uint32_t)] = 0x1; // Limpa a borda capturada
+	pdi_irq_addr[PIO_IRQ_MASK_OFST / sizeof(uint32_t)] = 0x1;
+
+	// O driver desabilita a linha a cada interrupção; escrever 1 reabilita
+	if (write(bridge_fd, &enable, sizeof(enable)) != sizeof(enable)) {
+		return -EIO;
+	}
+	return 0;
+}
+
+// Dorme até o pdi_done ou até timeout_ms (-ETIMEDOUT)
+int bridge_pdi_irq_wait(int timeout_ms)
+{
+	struct pollfd pfd = {.fd = bridge_fd, .events = POLLIN};
+	uint32_t count;
+
+	if (bridge_fd < 0) {
+		return -ENOTSUP;
+	}
+
+	int ret = poll(&pfd, 1, timeout_ms);
+	if (ret == 0) {
+		return -ETIMEDOUT;
+	}
+	if (ret < 0 || read(bridge_fd, &count, sizeof(count)) != sizeof(count)) {
+		return -EIO;
+	}
+
+	pdi_irq_addr[PIO_EDGE_CAPTURE_OFST / sizeof(uint32_t)] = 0x1;
+	return 0;
+}
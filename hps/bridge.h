@@ -0,0 +1,26 @@
+#ifndef BRIDGE_H
+#define BRIDGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Acesso ao lightweight bridge HPS-to-FPGA pelo driver pdi_bridge (driver/), compartilhado
+ * pelos backends que rodam na placa (pio e par): PIOs do link, janela do hps_bram_window e
+ * espera do pdi_done pela interrupção do PIO pdi_irq (f2h_irq0).
+ */
+
+int bridge_open();
+void bridge_close();
+// Endereço virtual de um periférico no lightweight bridge (ex.: SPI_CTRL_BASE do hps_0.h)
+volatile void *bridge_lw_addr(uint32_t offset);
+
+void bridge_write_channel(uint8_t channel, const uint8_t *buf, size_t len);
+void bridge_read_channel(uint8_t channel, uint8_t *buf, size_t len);
+void bridge_read_mask(uint8_t *buf, size_t len);
+uint32_t bridge_read_reg(uint32_t reg);
+void bridge_write_reg(uint32_t reg, uint32_t value);
+
+int bridge_pdi_irq_arm();
+int bridge_pdi_irq_wait(int timeout_ms);
+
+#endif
@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Driver do lightweight bridge HPS-to-FPGA usado pelo tcc.
+ *
+ * Substitui o mmap de /dev/mem: expõe em /dev/pdi_bridge apenas as regiões dos periféricos
+ * da FPGA, com o atributo de memória adequado a cada uma, e a interrupção do pdi_irq.
+ *
+ * mmap (offset = índice * PAGE_SIZE):
+ *   0 -> PIOs do link (spi_ctrl, spi_miso, par_*, pdi_irq)   strongly-ordered
+ *   1 -> canais R/G/B do hps_bram_window                      write-combining
+ *   2 -> registradores do hps_bram_window                     strongly-ordered
+ *
+ * read/write/poll seguem a semântica do UIO: read() bloqueia até a próxima interrupção e
+ * devolve o contador de eventos (u32), write() de 1 reabilita a linha, desabilitada a cada
+ * interrupção até o usuário limpar o edgecapture do PIO.
+ */
+
+#include <linux/atomic.h>
+#include <linux/fs.h>
+#include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+
+#define PDI_BRIDGE_NAME "pdi_bridge"
+
+enum pdi_bridge_map {
+	PDI_BRIDGE_MAP_CTRL = 0,
+	PDI_BRIDGE_MAP_PIXELS,
+	PDI_BRIDGE_MAP_REGS,
+	PDI_BRIDGE_MAPS
+};
+
+struct pdi_bridge {
+	struct miscdevice misc;
+	struct resource *regions[PDI_BRIDGE_MAPS];
+	int irq;
+	spinlock_t lock;
+	bool irq_disabled;
+	atomic_t event_count;
+	wait_queue_head_t wait;
+};
+
+struct pdi_bridge_file {
+	struct pdi_bridge *pb;
+	s32 event_count; // Último evento entregue a este arquivo
+};
+
+static irqreturn_t pdi_bridge_irq(int irq, void *data)
+{
+	struct pdi_bridge *pb = data;
+
+	// A linha do PIO é de nível: fica desabilitada até o usuário limpar o edgecapture
+	spin_lock(&pb->lock);
+	if (!pb->irq_disabled) {
+		pb->irq_disabled = true;
+		disable_irq_nosync(irq);
+	}
+	spin_unlock(&pb->lock);
+
+	atomic_inc(&pb->event_count);
+	wake_up_interruptible(&pb->wait);
+	return IRQ_HANDLED;
+}
+
+static int pdi_bridge_open(struct inode *inode, struct file *file)
+{
+	struct pdi_bridge *pb = container_of(file->private_data, struct pdi_bridge, misc);
+	struct pdi_bridge_file *pf = kzalloc(sizeof(*pf), GFP_KERNEL);
+
+	if (!pf)
+		return -ENOMEM;
+
+	pf->pb = pb;
+	pf->event_count = atomic_read(&pb->event_count);
+	file->private_data = pf;
+	return 0;
+}
+
+static int pdi_bridge_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static ssize_t pdi_bridge_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+	struct pdi_bridge_file *pf = file->private_data;
+	struct pdi_bridge *pb = pf->pb;
+	s32 event_count;
+	int ret;
+
+	if (count != sizeof(s32))
+		return -EINVAL;
+
+	if (file->f_flags & O_NONBLOCK) {
+		if (atomic_read(&pb->event_count) == pf->event_count)
+			return -EAGAIN;
+	} else {
+		ret = wait_event_interruptible(pb->wait,
+					       atomic_read(&pb->event_count) != pf->event_count);
+		if (ret)
+			return ret;
+	}
+
+	event_count = atomic_read(&pb->event_count);
+	if (copy_to_user(buf, &event_count, sizeof(event_count)))
+		return -EFAULT;
+
+	pf->event_count = event_count;
+	return sizeof(event_count);
+}
+
+static ssize_t pdi_bridge_write(struct file *file, const char __user *buf, size_t count,
+				loff_t *ppos)
+{
+	struct pdi_bridge *pb = ((struct pdi_bridge_file *)file->private_data)->pb;
+	unsigned long flags;
+	s32 enable;
+
+	if (count != sizeof(s32))
+		return -EINVAL;
+
+	if (copy_from_user(&enable, buf, sizeof(enable)))
+		return -EFAULT;
+
+	spin_lock_irqsave(&pb->lock, flags);
+	if (enable && pb->irq_disabled) {
+		pb->irq_disabled = false;
+		enable_irq(pb->irq);
+	} else if (!enable && !pb->irq_disabled) {
+		pb->irq_disabled = true;
+		disable_irq_nosync(pb->irq);
+	}
+	spin_unlock_irqrestore(&pb->lock, flags);
+
+	return sizeof(enable);
+}
+
+static __poll_t pdi_bridge_poll(struct file *file, poll_table *wait)
+{
+	struct pdi_bridge_file *pf = file->private_data;
+	struct pdi_bridge *pb = pf->pb;
+
+	poll_wait(file, &pb->wait, wait);
+	if (atomic_read(&pb->event_count) != pf->event_count)
+		return EPOLLIN | EPOLLRDNORM;
+	return 0;
+}
+
+static int pdi_bridge_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct pdi_bridge *pb = ((struct pdi_bridge_file *)file->private_data)->pb;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	struct resource *res;
+
+	if (vma->vm_pgoff >= PDI_BRIDGE_MAPS)
+		return -EINVAL;
+
+	res = pb->regions[vma->vm_pgoff];
+	if (size > PAGE_ALIGN(resource_size(res)))
+		return -EINVAL;
+
+	// Pixels aceitam agrupamento de escritas; PIOs e registradores têm efeito colateral
+	if (vma->vm_pgoff == PDI_BRIDGE_MAP_PIXELS)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	else
+		vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+
+	return io_remap_pfn_range(vma, vma->vm_start, res->start >> PAGE_SHIFT, size,
+				  vma->vm_page_prot);
+}
+
+static const struct file_operations pdi_bridge_fops = {
+	.owner = THIS_MODULE,
+	.open = pdi_bridge_open,
+	.release = pdi_bridge_release,
+	.read = pdi_bridge_read,
+	.write = pdi_bridge_write,
+	.poll = pdi_bridge_poll,
+	.mmap = pdi_bridge_mmap,
+	.llseek = noop_llseek,
+};
+
+static int pdi_bridge_probe(struct platform_device *pdev)
+{
+	struct pdi_bridge *pb;
+	int i, ret;
+
+	pb = devm_kzalloc(&pdev->dev, sizeof(*pb), GFP_KERNEL);
+	if (!pb)
+		return -ENOMEM;
+
+	for (i = 0; i < PDI_BRIDGE_MAPS; i++) {
+		pb->regions[i] = platform_get_resource(pdev, IORESOURCE_MEM, i);
+		if (!pb->regions[i]) {
+			dev_err(&pdev->dev, "missing reg entry %d\n", i);
+			return -EINVAL;
+		}
+	}
+
+	spin_lock_init(&pb->lock);
+	init_waitqueue_head(&pb->wait);
+	atomic_set(&pb->event_count, 0);
+
+	pb->irq = platform_get_irq(pdev, 0);
+	if (pb->irq < 0)
+		return pb->irq;
+
+	// Começa desabilitada: o usuário arma a interrupção antes de iniciar o PDI
+	pb->irq_disabled = true;
+	irq_set_status_flags(pb->irq, IRQ_NOAUTOEN);
+	ret = devm_request_irq(&pdev->dev, pb->irq, pdi_bridge_irq, 0, PDI_BRIDGE_NAME, pb);
+	if (ret)
+		return ret;
+
+	pb->misc.minor = MISC_DYNAMIC_MINOR;
+	pb->misc.name = PDI_BRIDGE_NAME;
+	pb->misc.fops = &pdi_bridge_fops;
+	pb->misc.parent = &pdev->dev;
+
+	ret = misc_register(&pb->misc);
+	if (ret)
+		return ret;
+
+	platform_set_drvdata(pdev, pb);
+	return 0;
+}
+
+static int pdi_bridge_remove(struct platform_device *pdev)
+{
+	struct pdi_bridge *pb = platform_get_drvdata(pdev);
+
+	misc_deregister(&pb->misc);
+	return 0;
+}
+
+static const struct of_device_id pdi_bridge_of_match[] = {
+	{ .compatible = "tcc,pdi-bridge" },
+	{},
+};
+MODULE_DEVICE_TABLE(of, pdi_bridge_of_match);
+
+static struct platform_driver pdi_bridge_driver = {
+	.probe = pdi_bridge_probe,
+	.remove = pdi_bridge_remove,
+	.driver = {
+		.name = PDI_BRIDGE_NAME,
+		.of_match_table = pdi_bridge_of_match,
+	},
+};
+module_platform_driver(pdi_bridge_driver);
+
+MODULE_DESCRIPTION("HPS-to-FPGA lightweight bridge access for the gesture recognition PDI");
+MODULE_LICENSE("GPL");
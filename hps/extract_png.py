@@ -1,8 +1,7 @@
+import sys
 from PIL import Image
-def txt_to_image(txt_file_path, output_image_path):
-    # Set the known size of the image
-    width = 320
-    height = 240
+def txt_to_image(txt_file_path, output_image_path, height=240, width=320):
+    # Frame geometry of the dump (HEIGHT and WIDTH of the Makefile)
 
     print(f"Image dimensions: {height}x{width}")
 
@@ -44,4 +43,6 @@ def txt_to_image(txt_file_path, output_image_path):
     except Exception as e:
         print(f"Error: {e}")
 
-txt_to_image('./fpga_return/img_r_channel.txt', './fpga_return/three_fingers_up.png')
\ No newline at end of file
+height = int(sys.argv[1]) if len(sys.argv) > 1 else 240
+width = int(sys.argv[2]) if len(sys.argv) > 2 else 320
+txt_to_image('./fpga_return/img_r_channel.txt', './fpga_return/three_fingers_up.png', height, width)
\ No newline at end of file
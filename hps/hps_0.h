@@ -21,52 +21,28 @@
  */
 
 /*
- * Macros for device 'spi_ss', class 'altera_avalon_pio'
- * The macros are prefixed with 'SPI_SS_'.
+ * Macros for device 'spi_ctrl', class 'altera_avalon_pio'
+ * The macros are prefixed with 'SPI_CTRL_'.
  * The prefix is the slave descriptor.
  */
-#define SPI_SS_COMPONENT_TYPE altera_avalon_pio
-#define SPI_SS_COMPONENT_NAME spi_ss
-#define SPI_SS_BASE 0x0
-#define SPI_SS_SPAN 32
-#define SPI_SS_END 0x1f
-#define SPI_SS_BIT_CLEARING_EDGE_REGISTER 0
-#define SPI_SS_BIT_MODIFYING_OUTPUT_REGISTER 0
-#define SPI_SS_CAPTURE 0
-#define SPI_SS_DATA_WIDTH 1
-#define SPI_SS_DO_TEST_BENCH_WIRING 0
-#define SPI_SS_DRIVEN_SIM_VALUE 0
-#define SPI_SS_EDGE_TYPE NONE
-#define SPI_SS_FREQ 50000000
-#define SPI_SS_HAS_IN 0
-#define SPI_SS_HAS_OUT 1
-#define SPI_SS_HAS_TRI 0
-#define SPI_SS_IRQ_TYPE NONE
-#define SPI_SS_RESET_VALUE 0
-
-/*
- * Macros for device 'spi_sck', class 'altera_avalon_pio'
- * The macros are prefixed with 'SPI_SCK_'.
- * The prefix is the slave descriptor.
- */
-#define SPI_SCK_COMPONENT_TYPE altera_avalon_pio
-#define SPI_SCK_COMPONENT_NAME spi_sck
-#define SPI_SCK_BASE 0x10
-#define SPI_SCK_SPAN 32
-#define SPI_SCK_END 0x2f
-#define SPI_SCK_BIT_CLEARING_EDGE_REGISTER 0
-#define SPI_SCK_BIT_MODIFYING_OUTPUT_REGISTER 0
-#define SPI_SCK_CAPTURE 0
-#define SPI_SCK_DATA_WIDTH 1
-#define SPI_SCK_DO_TEST_BENCH_WIRING 0
-#define SPI_SCK_DRIVEN_SIM_VALUE 0
-#define SPI_SCK_EDGE_TYPE NONE
-#define SPI_SCK_FREQ 50000000
-#define SPI_SCK_HAS_IN 0
-#define SPI_SCK_HAS_OUT 1
-#define SPI_SCK_HAS_TRI 0
-#define SPI_SCK_IRQ_TYPE NONE
-#define SPI_SCK_RESET_VALUE 0
+#define SPI_CTRL_COMPONENT_TYPE altera_avalon_pio
+#define SPI_CTRL_COMPONENT_NAME spi_ctrl
+#define SPI_CTRL_BASE 0x0
+#define SPI_CTRL_SPAN 16
+#define SPI_CTRL_END 0xf
+#define SPI_CTRL_BIT_CLEARING_EDGE_REGISTER 0
+#define SPI_CTRL_BIT_MODIFYING_OUTPUT_REGISTER 0
+#define SPI_CTRL_CAPTURE 0
+#define SPI_CTRL_DATA_WIDTH 3
+#define SPI_CTRL_DO_TEST_BENCH_WIRING 0
+#define SPI_CTRL_DRIVEN_SIM_VALUE 0
+#define SPI_CTRL_EDGE_TYPE NONE
+#define SPI_CTRL_FREQ 50000000
+#define SPI_CTRL_HAS_IN 0
+#define SPI_CTRL_HAS_OUT 1
+#define SPI_CTRL_HAS_TRI 0
+#define SPI_CTRL_IRQ_TYPE NONE
+#define SPI_CTRL_RESET_VALUE 4
 
 /*
  * Macros for device 'spi_miso', class 'altera_avalon_pio'
@@ -92,29 +68,91 @@
 #define SPI_MISO_IRQ_TYPE NONE
 #define SPI_MISO_RESET_VALUE 0
 
+
+/*
+ * Macros for device 'par_out', class 'altera_avalon_pio'
+ * The macros are prefixed with 'PAR_OUT_'.
+ * The prefix is the slave descriptor.
+ */
+#define PAR_OUT_COMPONENT_TYPE altera_avalon_pio
+#define PAR_OUT_COMPONENT_NAME par_out
+#define PAR_OUT_BASE 0x40
+#define PAR_OUT_SPAN 16
+#define PAR_OUT_END 0x4f
+#define PAR_OUT_BIT_CLEARING_EDGE_REGISTER 0
+#define PAR_OUT_BIT_MODIFYING_OUTPUT_REGISTER 0
+#define PAR_OUT_CAPTURE 0
+#define PAR_OUT_DATA_WIDTH 9
+#define PAR_OUT_DO_TEST_BENCH_WIRING 0
+#define PAR_OUT_DRIVEN_SIM_VALUE 0
+#define PAR_OUT_EDGE_TYPE NONE
+#define PAR_OUT_FREQ 50000000
+#define PAR_OUT_HAS_IN 0
+#define PAR_OUT_HAS_OUT 1
+#define PAR_OUT_HAS_TRI 0
+#define PAR_OUT_IRQ_TYPE NONE
+#define PAR_OUT_RESET_VALUE 0
+
+/*
+ * Macros for device 'par_in', class 'altera_avalon_pio'
+ * The macros are prefixed with 'PAR_IN_'.
+ * The prefix is the slave descriptor.
+ */
+#define PAR_IN_COMPONENT_TYPE altera_avalon_pio
+#define PAR_IN_COMPONENT_NAME par_in
+#define PAR_IN_BASE 0x50
+#define PAR_IN_SPAN 16
+#define PAR_IN_END 0x5f
+#define PAR_IN_BIT_CLEARING_EDGE_REGISTER 0
+#define PAR_IN_BIT_MODIFYING_OUTPUT_REGISTER 0
+#define PAR_IN_CAPTURE 0
+#define PAR_IN_DATA_WIDTH 9
+#define PAR_IN_DO_TEST_BENCH_WIRING 0
+#define PAR_IN_DRIVEN_SIM_VALUE 0
+#define PAR_IN_EDGE_TYPE NONE
+#define PAR_IN_FREQ 50000000
+#define PAR_IN_HAS_IN 1
+#define PAR_IN_HAS_OUT 0
+#define PAR_IN_HAS_TRI 0
+#define PAR_IN_IRQ_TYPE NONE
+#define PAR_IN_RESET_VALUE 0
+
+/*
+ * Macros for device 'pdi_irq', class 'altera_avalon_pio'
+ * The macros are prefixed with 'PDI_IRQ_'.
+ * The prefix is the slave descriptor.
+ */
+#define PDI_IRQ_COMPONENT_TYPE altera_avalon_pio
+#define PDI_IRQ_COMPONENT_NAME pdi_irq
+#define PDI_IRQ_BASE 0x60
+#define PDI_IRQ_SPAN 16
+#define PDI_IRQ_END 0x6f
+#define PDI_IRQ_BIT_CLEARING_EDGE_REGISTER 1
+#define PDI_IRQ_BIT_MODIFYING_OUTPUT_REGISTER 0
+#define PDI_IRQ_CAPTURE 1
+#define PDI_IRQ_DATA_WIDTH 1
+#define PDI_IRQ_DO_TEST_BENCH_WIRING 0
+#define PDI_IRQ_DRIVEN_SIM_VALUE 0
+#define PDI_IRQ_EDGE_TYPE RISING
+#define PDI_IRQ_FREQ 50000000
+#define PDI_IRQ_HAS_IN 1
+#define PDI_IRQ_HAS_OUT 0
+#define PDI_IRQ_HAS_TRI 0
+#define PDI_IRQ_IRQ 0
+#define PDI_IRQ_IRQ_INTERRUPT_CONTROLLER_ID 0
+#define PDI_IRQ_IRQ_TYPE EDGE
+#define PDI_IRQ_RESET_VALUE 0
+
 /*
- * Macros for device 'spi_mosi', class 'altera_avalon_pio'
- * The macros are prefixed with 'SPI_MOSI_'.
+ * Macros for device 'bram_window', class 'altera_avalon_mm_bridge'
+ * The macros are prefixed with 'BRAM_WINDOW_'.
  * The prefix is the slave descriptor.
  */
-#define SPI_MOSI_COMPONENT_TYPE altera_avalon_pio
-#define SPI_MOSI_COMPONENT_NAME spi_mosi
-#define SPI_MOSI_BASE 0x30
-#define SPI_MOSI_SPAN 32
-#define SPI_MOSI_END 0x4f
-#define SPI_MOSI_BIT_CLEARING_EDGE_REGISTER 0
-#define SPI_MOSI_BIT_MODIFYING_OUTPUT_REGISTER 0
-#define SPI_MOSI_CAPTURE 0
-#define SPI_MOSI_DATA_WIDTH 1
-#define SPI_MOSI_DO_TEST_BENCH_WIRING 0
-#define SPI_MOSI_DRIVEN_SIM_VALUE 0
-#define SPI_MOSI_EDGE_TYPE NONE
-#define SPI_MOSI_FREQ 50000000
-#define SPI_MOSI_HAS_IN 0
-#define SPI_MOSI_HAS_OUT 1
-#define SPI_MOSI_HAS_TRI 0
-#define SPI_MOSI_IRQ_TYPE NONE
-#define SPI_MOSI_RESET_VALUE 0
+#define BRAM_WINDOW_COMPONENT_TYPE altera_avalon_mm_bridge
+#define BRAM_WINDOW_COMPONENT_NAME bram_window
+#define BRAM_WINDOW_BASE 0x80000
+#define BRAM_WINDOW_SPAN 524288
+#define BRAM_WINDOW_END 0xfffff
 
 
 #endif /* _ALTERA_HPS_0_H_ */
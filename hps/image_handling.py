@@ -1,29 +1,42 @@
+import sys
 import cv2 as cv2
 import numpy as np
-img = cv2.imread('./images/three_fingers_up.JPEG')
+
 h = 240
 w = 320
-img = cv2.resize(img, (w, h))
-img_b,  img_g, img_r  = cv2.split(img)
-# cv2.imshow("Red", img_r)
-# cv2.imshow("Green", img_g)
-# cv2.imshow("Blue", img_b)
-hx1 = np.vectorize(hex)
-
-img_r = hx1(img_r.flatten())
-img_g = hx1(img_g.flatten())
-img_b = hx1(img_b.flatten())
-
-img_r_txt = "const uint8_t img_r_channel[IMAGE_WIDTH*IMAGE_HEIGHT] = { "+ ','.join(img_r)+'};'
-img_g_txt = "const uint8_t img_g_channel[IMAGE_WIDTH*IMAGE_HEIGHT] = { "+ ','.join(img_g)+'};'
-img_b_txt = "const uint8_t img_b_channel[IMAGE_WIDTH*IMAGE_HEIGHT] = { "+ ','.join(img_b)+'};'
-
-with open('image.c', 'w') as f:
-    f.write('#include "image.h"\n\n')
-    f.write(img_r_txt)
-    f.write('\n\n')
-    f.write(img_g_txt)
-    f.write('\n\n')
-    f.write(img_b_txt)
-    f.write('\n\n')
-    f.close()
\ No newline at end of file
+
+
+def write_image_c(image_path='./images/three_fingers_up.JPEG', output_path='image.c'):
+    # Writes the R, G and B channels of the resized image as the arrays of image.h
+    img = cv2.imread(image_path)
+    if img is None:
+        raise FileNotFoundError(image_path)
+    img = cv2.resize(img, (w, h))
+    img_b,  img_g, img_r  = cv2.split(img)
+    # cv2.imshow("Red", img_r)
+    # cv2.imshow("Green", img_g)
+    # cv2.imshow("Blue", img_b)
+    hx1 = np.vectorize(hex)
+
+    img_r = hx1(img_r.flatten())
+    img_g = hx1(img_g.flatten())
+    img_b = hx1(img_b.flatten())
+
+    img_r_txt = "const uint8_t img_r_channel[IMAGE_WIDTH*IMAGE_HEIGHT] = { "+ ','.join(img_r)+'};'
+    img_g_txt = "const uint8_t img_g_channel[IMAGE_WIDTH*IMAGE_HEIGHT] = { "+ ','.join(img_g)+'};'
+    img_b_txt = "const uint8_t img_b_channel[IMAGE_WIDTH*IMAGE_HEIGHT] = { "+ ','.join(img_b)+'};'
+
+    with open(output_path, 'w') as f:
+        f.write('#include "image.h"\n\n')
+        f.write(img_r_txt)
+        f.write('\n\n')
+        f.write(img_g_txt)
+        f.write('\n\n')
+        f.write(img_b_txt)
+        f.write('\n\n')
+        f.close()
+
+
+if __name__ == '__main__':
+    # Usage: python3 image_handling.py [image] [output .c]
+    write_image_c(*sys.argv[1:3])
@@ -1,28 +1,219 @@
 #include "image.h"
 #include "spi.h"
 #include "pdi.h"
+#include "pdi_sw.h"
 #include <pthread.h>
 #include <sched.h> // Include for setting thread scheduling policy
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/time.h>
 
 #define GET_MSB_16BIT(x) ((uint8_t)((x) >> 8))
 #define GET_LSB_16BIT(x) ((uint8_t)((x) & 0xFF))
 
+// Quadros processados em sequência (a mesma imagem faz o papel dos quadros da câmera)
+#ifndef PDI_FRAMES
+#define PDI_FRAMES 1
+#endif
+
+// 1 -> cada quadro envia só o recorte em volta da mão do quadro anterior (ver ROI no Makefile)
+#ifndef PDI_ROI
+#define PDI_ROI 0
+#endif
+
+// 1 -> cada quadro também passa pelo PDI em software (pdi_sw.c), que substitui a FPGA se ela não
+// responder (ver SW no Makefile)
+#ifndef PDI_SW
+#define PDI_SW 0
+#endif
+
+// 1 -> a compensação e a conversão para YCbCr rodam no HPS e só os planos Cb e Cr são enviados,
+// nos canais G e B (ver CHROMA no Makefile)
+#ifndef PDI_CHROMA
+#define PDI_CHROMA 0
+#endif
+
+#if IMG_HEIGHT > IMAGE_HEIGHT || IMG_WIDTH > IMAGE_WIDTH
+#error "A geometria dos quadros não cabe na imagem de image.c"
+#endif
+
+// Canais do quadro enviado: recorte IMG_HEIGHT x IMG_WIDTH da imagem de image.c
+static uint8_t frame_channels[3][IMG_HEIGHT * IMG_WIDTH];
+
+// Canais do recorte enviado à FPGA
+static uint8_t roi_channels[3][IMG_HEIGHT * IMG_WIDTH];
+
+#if PDI_CHROMA
+// Planos Cb e Cr do recorte enviado
+static uint8_t roi_chroma[2][IMG_HEIGHT * IMG_WIDTH];
+#endif
+
+// Recorte enviado a cada banco
+static struct pdi_roi sent_roi[2];
+
 // Remove the mutex since we want to avoid preemption and blocking
 // pthread_mutex_t mutex;
 
-static void fill_data_to_send(uint8_t *data_to_send, uint8_t start_byte, const uint8_t *img_data)
+// Recorta as linhas de baixo (onde fica o punho) e as colunas centrais da imagem
+static void crop_channel(uint8_t *dst, const uint8_t *img_data)
+{
+	int row_ofst = IMAGE_HEIGHT - IMG_HEIGHT;
+	int col_ofst = (IMAGE_WIDTH - IMG_WIDTH) / 2;
+
+	for (int row = 0; row < IMG_HEIGHT; row++) {
+		for (int col = 0; col < IMG_WIDTH; col++) {
+			dst[row * IMG_WIDTH + col] =
+				img_data[(row + row_ofst) * IMAGE_WIDTH + col + col_ofst];
+		}
+	}
+}
+
+// Copia o recorte roi do quadro, linha a linha
+static void crop_roi(uint8_t *dst, const uint8_t *frame_data, const struct pdi_roi *roi)
+{
+	for (int row = 0; row < roi->height; row++) {
+		memcpy(dst + row * roi->width, frame_data + (row + roi->y) * IMG_WIDTH + roi->x,
+		       roi->width);
+	}
+}
+
+#if PDI_SW
+/* PDI em software sobre o recorte roi do quadro. Com fpga compara os resultados com os da FPGA,
+ * sem ele os imprime no lugar dos da FPGA
+ */
+static int run_pdi_sw(const struct pdi_roi *roi, const struct pdi_results *fpga)
+{
+	static uint8_t channels[3][IMG_HEIGHT * IMG_WIDTH];
+	static uint8_t mask[IMG_HEIGHT * IMG_WIDTH];
+	int err;
+	struct pdi_sw_frame sw_frame = {.height = roi->height, .width = roi->width};
+	struct pdi_sw_features features;
+	struct pdi_results results;
+	struct timeval begin_time, end_time;
+
+	for (int i = 0; i < 3; i++) {
+		crop_roi(channels[i], frame_channels[i], roi);
+		sw_frame.channel[i] = channels[i];
+	}
+
+	gettimeofday(&begin_time, NULL);
+	pdi_sw_sums(&sw_frame);
+#if PDI_CHROMA
+	// Mesmo caminho da FPGA: planos Cb e Cr e depois direto à binarização
+	static uint8_t chroma[2][IMG_HEIGHT * IMG_WIDTH];
+
+	err = pdi_sw_chroma(&sw_frame, chroma[0], chroma[1]);
+	sw_frame.channel[1] = chroma[0];
+	sw_frame.channel[2] = chroma[1];
+	sw_frame.chroma = 1;
+	if (!err) {
+		err = pdi_sw_run(&sw_frame, mask, &features);
+	}
+#else
+	err = pdi_sw_run(&sw_frame, mask, &features);
+#endif
+	gettimeofday(&end_time, NULL);
+	if (err) {
+		printf("Erro no PDI em software: %d\n", err);
+		return err;
+	}
+
+	pdi_sw_results(&features, &results);
+	printf("PDI em software: %lu us | classificacao %u | area %u | perimetro %u | picos %u\n",
+	       (end_time.tv_sec - begin_time.tv_sec) * 1000000 + end_time.tv_usec -
+		       begin_time.tv_usec,
+	       results.classification, results.hand_area, results.hand_perimeter, results.peaks);
+
+	if (fpga != NULL) {
+		int same = results.classification == fpga->classification &&
+			   results.peaks == fpga->peaks && results.hand_area == fpga->hand_area &&
+			   results.hand_perimeter == fpga->hand_perimeter &&
+			   results.max_distance == fpga->max_distance &&
+			   results.reference_x == fpga->reference_x &&
+			   results.reference_y == fpga->reference_y;
+		printf("PDI em software %s da FPGA (ciclos estimados %u, medidos %u)\n",
+		       same ? "igual ao" : "DIFERENTE do", results.cycles, fpga->cycles);
+	}
+	return 0;
+}
+#endif
+
+// Pacote de um canal: comando, origem (só no envio de recorte), altura, largura e pixels
+static size_t fill_data_to_send(uint8_t *data_to_send, uint8_t start_byte, const uint8_t *img_data,
+				const struct pdi_roi *roi)
 {
-	data_to_send[0] = start_byte;
-	data_to_send[1] = GET_MSB_16BIT(IMG_HEIGHT);
-	data_to_send[2] = GET_LSB_16BIT(IMG_HEIGHT);
-	data_to_send[3] = GET_MSB_16BIT(IMG_WIDTH);
-	data_to_send[4] = GET_LSB_16BIT(IMG_WIDTH);
+	size_t len = 0;
+	size_t pixels = (size_t)roi->width * roi->height;
 
-	for (int i = 0; i < (IMG_HEIGHT * IMG_WIDTH); i++) {
-		data_to_send[5 + i] = img_data[i];
+	data_to_send[len++] = start_byte;
+	if (PDI_ROI) {
+		data_to_send[len++] = GET_MSB_16BIT(roi->y);
+		data_to_send[len++] = GET_LSB_16BIT(roi->y);
+		data_to_send[len++] = GET_MSB_16BIT(roi->x);
+		data_to_send[len++] = GET_LSB_16BIT(roi->x);
+	}
+	data_to_send[len++] = GET_MSB_16BIT(roi->height);
+	data_to_send[len++] = GET_LSB_16BIT(roi->height);
+	data_to_send[len++] = GET_MSB_16BIT(roi->width);
+	data_to_send[len++] = GET_LSB_16BIT(roi->width);
+
+	memcpy(data_to_send + len, img_data, pixels);
+	return len + pixels;
+}
+
+/* Envia os três canais do recorte roi de um quadro para o banco bank; com PDI_CHROMA envia só
+ * o Cb e o Cr do recorte, nos canais G e B
+ */
+static void send_frame(uint8_t bank, const struct pdi_roi *roi)
+{
+	static const uint8_t channels[3] = {IMAGE_CHN_R, IMAGE_CHN_G, IMAGE_CHN_B};
+	static uint8_t pkt[9 + IMG_HEIGHT * IMG_WIDTH];
+	const uint8_t *data[3] = {roi_channels[0], roi_channels[1], roi_channels[2]};
+	size_t pixels = (size_t)roi->width * roi->height;
+	uint8_t op = PDI_ROI ? SEND_ROI_OP_MASK : SEND_IMAGE_OP_MASK;
+	int first = 0;
+
+	for (int i = 0; i < 3; i++) {
+		crop_roi(roi_channels[i], frame_channels[i], roi);
+	}
+	pdi_set_roi(bank, roi);
+	sent_roi[bank & 0x1] = *roi;
+
+#if PDI_CHROMA
+	// Compensação e YCbCr no HPS (NEON): o canal R não vai, um terço a menos de bytes no link
+	struct pdi_sw_frame chroma_frame = {
+		.height = roi->height,
+		.width = roi->width,
+		.channel = {roi_channels[0], roi_channels[1], roi_channels[2]},
+	};
+
+	pdi_sw_sums(&chroma_frame);
+	if (pdi_sw_chroma(&chroma_frame, roi_chroma[0], roi_chroma[1])) {
+		printf("Recorte %ux%u invalido para a conversao\n", roi->width, roi->height);
+	}
+	data[1] = roi_chroma[0];
+	data[2] = roi_chroma[1];
+	first = 1;
+#endif
+
+	if (LINK_USES_WINDOW()) {
+		// Escrita direta nas BRAMs: só os pixels, sem comando nem tamanho
+		spi_write_reg(WINDOW_REG_BANK, bank); // Início do envio: zera as somas do banco
+		for (int i = first; i < 3; i++) {
+			spi_write_channel(channels[i], data[i], pixels);
+		}
+		return;
+	}
+
+	for (int i = first; i < 3; i++) {
+		if (i != first) {
+			spi_send_byte(0x00); // Envia o byte
+		}
+
+		uint8_t start_byte = NO_RETURN_MASK | op | channels[i] | FRAME_BANK_MASK(bank);
+		size_t len = fill_data_to_send(pkt, start_byte, data[i], roi);
+		spi_send_buffer(pkt, len); // Envia o pacote com o slave selecionado
 	}
 }
 
@@ -44,7 +235,7 @@ int main()
 
 	int err = 0;
 
-	err = setup_mem_addr(); // Assumimos que esta função está correta
+	err = spi_open(); // Assumimos que esta função está correta
 	if (err) {
 		printf("Erro ao configurar os enderecos de memoria\n");
 		return err;
@@ -52,71 +243,126 @@ int main()
 
 #if DEBUG == 1
 	printf("DEBUG habilitado!\n");
-	bringup_sequence();
 #endif
 
-	uint8_t start_byte_r_ch = NO_RETURN_MASK | SEND_IMAGE_OP_MASK | IMAGE_CHN_R;
-	uint8_t start_byte_g_ch = NO_RETURN_MASK | SEND_IMAGE_OP_MASK | IMAGE_CHN_G;
-	uint8_t start_byte_b_ch = NO_RETURN_MASK | SEND_IMAGE_OP_MASK | IMAGE_CHN_B;
-
-	uint8_t image_r_ch_pkt[5 + (IMG_HEIGHT * IMG_WIDTH)];
-	uint8_t image_g_ch_pkt[5 + (IMG_HEIGHT * IMG_WIDTH)];
-	uint8_t image_b_ch_pkt[5 + (IMG_HEIGHT * IMG_WIDTH)];
-
-	fill_data_to_send(image_r_ch_pkt, start_byte_r_ch, img_r_channel);
-	fill_data_to_send(image_g_ch_pkt, start_byte_g_ch, img_g_channel);
-	fill_data_to_send(image_b_ch_pkt, start_byte_b_ch, img_b_channel);
+	crop_channel(frame_channels[0], img_r_channel);
+	crop_channel(frame_channels[1], img_g_channel);
+	crop_channel(frame_channels[2], img_b_channel);
 
-	size_t data_len = sizeof(image_r_ch_pkt) / sizeof(image_r_ch_pkt[0]);
+	// O primeiro quadro vai inteiro; com PDI_ROI os seguintes seguem a mão
+	struct pdi_roi roi = PDI_FULL_ROI;
+	int banks = pdi_frame_banks();
+	uint8_t bank = 0;
 
 	// Set the thread to real-time priority
 	set_realtime_priority();
 
 #if DEBUG == 1
 	for (size_t i = 0; i < 10; i++) {
-		printf("0x%X 0x%X 0x%X 0x%X 0x%X \t", image_r_ch_pkt[i], image_r_ch_pkt[i + 1],
-		       image_r_ch_pkt[i + 2], image_r_ch_pkt[i + 3], image_r_ch_pkt[i + 4]);
-		printf("0x%X 0x%X 0x%X 0x%X 0x%X \t", image_g_ch_pkt[i], image_g_ch_pkt[i + 1],
-		       image_g_ch_pkt[i + 2], image_g_ch_pkt[i + 3], image_g_ch_pkt[i + 4]);
-		printf("0x%X 0x%X 0x%X 0x%X 0x%X \n", image_b_ch_pkt[i], image_b_ch_pkt[i + 1],
-		       image_b_ch_pkt[i + 2], image_b_ch_pkt[i + 3], image_b_ch_pkt[i + 4]);
+		for (int c = 0; c < 3; c++) {
+			const uint8_t *chn = frame_channels[c];
+			printf("0x%X 0x%X 0x%X 0x%X 0x%X %c", chn[i], chn[i + 1], chn[i + 2],
+			       chn[i + 3], chn[i + 4], (c == 2) ? '\n' : '\t');
+		}
 	}
 #endif
 
 	gettimeofday(&start_time, NULL);
 	gettimeofday(&begin_time, NULL);
 
-	for (size_t i = 0; i < data_len; i++) {
-		spi_send_byte(image_r_ch_pkt[i]); // Envia o byte
-	}
-
-	spi_send_byte(0x00); // Envia o byte
-
-	for (size_t i = 0; i < data_len; i++) {
-		spi_send_byte(image_g_ch_pkt[i]); // Envia o byte
-	}
-
-	spi_send_byte(0x00); // Envia o byte
-
-	for (size_t i = 0; i < data_len; i++) {
-		spi_send_byte(image_b_ch_pkt[i]); // Envia o byte
-	}
+	send_frame(bank, &roi);
 
 	gettimeofday(&end_time, NULL);
 	printf("Tempo total de envio dos canais da imagem: %lu\n",
 	       (end_time.tv_sec - begin_time.tv_sec) * 1000000 + end_time.tv_usec -
 		       begin_time.tv_usec);
 
+	// A FPGA troca geometrias acima da sintetizada pela sintetizada
+	struct pdi_roi used = {0};
+	pdi_get_roi(&used);
+	if (used.height != roi.height || used.width != roi.width) {
+		printf("Geometria %ux%u recusada pela FPGA (em uso: %ux%u)\n", roi.width, roi.height,
+		       used.width, used.height);
+		spi_close();
+		return -1;
+	}
+
 	gettimeofday(&start_time, NULL);
-	err = execute_pdi();
+
+	/* Com dois bancos o quadro seguinte é enviado para o outro banco enquanto o PDI processa
+	 * o atual. Com um banco o envio espera o PDI liberar os canais (fim da binarização) quando
+	 * a janela informa esse status, senão espera o fim do PDI. Com PDI_ROI o recorte do próximo
+	 * quadro depende da mão deste, então o envio sempre espera o pdi_track_roi() (sem
+	 * sobreposição), igual com e sem janela.
+	 */
+	for (int frame = 0; frame < PDI_FRAMES && !err; frame++) {
+		uint8_t next_bank = (bank + 1) % banks;
+		int has_next = (frame + 1 < PDI_FRAMES);
+		int next_sent = 0;
+		int fpga_done = 1;
+#if PDI_SW
+		// Com um banco o próximo envio pode trocar o recorte durante o PDI
+		struct pdi_roi frame_roi = sent_roi[bank];
+#endif
+
+		err = start_pdi(bank, PDI_CHROMA);
+		if (!err && has_next && !PDI_ROI && (banks > 1 || wait_pdi_frame() == 0)) {
+			send_frame(next_bank, &roi);
+			next_sent = 1;
+		}
+		if (!err) {
+			err = wait_pdi();
+			if (err) {
+				printf("Erro ao aguardar o PDI: %d\n", err);
+			}
+		}
+#if PDI_SW
+		// Sem resposta da FPGA o quadro é processado em software
+		if (err == -ETIMEDOUT) {
+			err = run_pdi_sw(&frame_roi, NULL);
+			fpga_done = 0;
+		}
+#endif
+		if (!err && fpga_done) {
+			err = read_pdi_results();
+		}
+		if (!err && fpga_done) {
+			err = pdi_print_cycles();
+		}
+#if PDI_SW
+		if (!err && fpga_done) {
+			struct pdi_results fpga_results;
+
+			pdi_read_record(&fpga_results);
+			err = run_pdi_sw(&frame_roi, &fpga_results);
+		}
+#endif
+		if (!err && fpga_done && PDI_ROI && has_next) {
+			err = pdi_track_roi(&roi);
+#if DEBUG == 1
+			printf("Recorte do proximo quadro: %ux%u em (%u, %u)\n", roi.width, roi.height,
+			       roi.x, roi.y);
+#endif
+		}
+		if (!err && has_next && !next_sent) {
+			send_frame(next_bank, &roi);
+		}
+		bank = next_bank;
+	}
 
 	gettimeofday(&end_time, NULL);
 
+#if DEBUG == 1
+	printf("Quadros processados: %d (bancos de quadro: %d)\n", PDI_FRAMES, banks);
+#endif
+
 	printf("Tempo de execucao do PDI: %lu\n", (end_time.tv_sec - start_time.tv_sec) * 1000000 +
 							  end_time.tv_usec - start_time.tv_usec);
 	printf("Tempo total de execucao: %lu\n", (end_time.tv_sec - begin_time.tv_sec) * 1000000 +
 							 end_time.tv_usec - begin_time.tv_usec);
 
+	spi_close();
+
 	if (err) {
 		printf("Erro ao executar o PDI\n");
 		return -1;
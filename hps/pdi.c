@@ -1,46 +1,338 @@
 #include "pdi.h"
 
-int execute_pdi()
+// Recebe um inteiro de 32 bits (MSB primeiro) numa única janela de chip select
+static uint32_t receive_u32()
+{
+	uint8_t bytes[4];
+
+	spi_recv_buffer(bytes, sizeof(bytes));
+	return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) |
+	       bytes[3];
+}
+
+// Banco processado pela última execução do PDI e se a espera será por interrupção
+static uint8_t pdi_bank;
+static int pdi_use_irq;
+
+// Recorte enviado a cada banco e recorte processado pela última execução do PDI
+static struct pdi_roi bank_roi[2] = {PDI_FULL_ROI, PDI_FULL_ROI};
+static struct pdi_roi pdi_roi = PDI_FULL_ROI;
+
+// Número de bancos de quadro: com mais de um, o próximo quadro é enviado durante o PDI
+int pdi_frame_banks()
+{
+	uint32_t banks = LINK_USES_WINDOW() ? spi_read_reg(WINDOW_REG_BANKS) : FRAME_BANKS;
+
+	return (banks >= 2) ? 2 : 1;
+}
+
+/* Define a geometria dos quadros. No protocolo SPI ela vai nos bytes de tamanho de cada envio
+ * de imagem, só a janela tem um registrador para ela
+ */
+int pdi_set_geometry(uint16_t height, uint16_t width)
+{
+	if (LINK_USES_WINDOW()) {
+		spi_write_reg(WINDOW_REG_GEOMETRY, ((uint32_t)height << 16) | width);
+	}
+	return 0;
+}
+
+// Lê a geometria em uso pela FPGA
+int pdi_get_geometry(uint16_t *height, uint16_t *width)
+{
+	uint32_t geometry = 0;
+
+	if (LINK_USES_WINDOW()) {
+		geometry = spi_read_reg(WINDOW_REG_GEOMETRY);
+	} else {
+		spi_send_byte(0x00); // Envia o byte
+		spi_send_byte(NO_RETURN_MASK | GEOMETRY_OP_MASK);
+		spi_send_byte(0x00); // Envia o byte
+		geometry = receive_u32();
+	}
+
+	*height = geometry >> 16;
+	*width = geometry & 0xFFFF;
+	return 0;
+}
+
+/* Registra o recorte do próximo envio ao banco bank. No protocolo SPI a origem vai no envio de
+ * recorte (SEND_ROI_OP_MASK); a janela recebe a geometria e a origem nos registradores
+ */
+int pdi_set_roi(uint8_t bank, const struct pdi_roi *roi)
+{
+	bank_roi[bank & 0x1] = *roi;
+
+	if (LINK_USES_WINDOW()) {
+		pdi_set_geometry(roi->height, roi->width);
+		spi_write_reg(WINDOW_REG_ROI, ((uint32_t)roi->y << 16) | roi->x);
+	}
+	return 0;
+}
+
+// Lê o recorte em uso pela FPGA
+int pdi_get_roi(struct pdi_roi *roi)
+{
+	uint32_t origin = 0;
+
+	pdi_get_geometry(&roi->height, &roi->width);
+	if (LINK_USES_WINDOW()) {
+		origin = spi_read_reg(WINDOW_REG_ROI);
+	} else {
+		spi_send_byte(0x00); // Envia o byte
+		spi_send_byte(NO_RETURN_MASK | ROI_OP_MASK);
+		spi_send_byte(0x00); // Envia o byte
+		origin = receive_u32();
+	}
+
+	roi->y = origin >> 16;
+	roi->x = origin & 0xFFFF;
+	return 0;
+}
+
+static inline int mask_bit(const uint8_t *mask, uint32_t i)
+{
+	return (mask[i / 8] >> (i % 8)) & 0x1;
+}
+
+/* Caixa da mão dilatada do último PDI (box_min e box_max da FPGA), na imagem da câmera. Sem
+ * pixels de mão a largura e a altura são 0
+ */
+int pdi_get_hand_box(struct pdi_roi *box)
+{
+	uint32_t box_min, box_max;
+
+	if (LINK_USES_WINDOW()) {
+		box_min = spi_read_reg(WINDOW_REG_BOX_MIN);
+		box_max = spi_read_reg(WINDOW_REG_BOX_MAX);
+	} else {
+		spi_send_byte(0x00); // Envia o byte
+		spi_send_byte(NO_RETURN_MASK | BOX_MIN_OP_MASK);
+		spi_send_byte(0x00); // Envia o byte
+		box_min = receive_u32();
+		spi_send_byte(0x00); // Envia o byte
+		spi_send_byte(NO_RETURN_MASK | BOX_MAX_OP_MASK);
+		spi_send_byte(0x00); // Envia o byte
+		box_max = receive_u32();
+	}
+
+	uint16_t left = box_min & 0xFFFF, top = box_min >> 16;
+	uint16_t right = box_max & 0xFFFF, bottom = box_max >> 16;
+
+	if (left > right || top > bottom) {
+		box->x = pdi_roi.x;
+		box->y = pdi_roi.y;
+		box->width = 0;
+		box->height = 0;
+		return 0;
+	}
+
+	box->x = pdi_roi.x + left;
+	box->y = pdi_roi.y + top;
+	box->width = right - left + 1;
+	box->height = bottom - top + 1;
+	return 0;
+}
+
+/* Próximo recorte a partir da caixa da mão do último PDI, com PDI_ROI_MARGIN pixels de margem e
+ * estendida até a última linha da imagem. Sem pixels de mão volta à imagem inteira
+ */
+int pdi_track_roi(struct pdi_roi *roi)
 {
-	uint8_t start_pdi_byte = NO_RETURN_MASK | PDI_EXEC_OP_MASK;
-	uint8_t received_byte = 0;
+	const struct pdi_roi full = PDI_FULL_ROI;
+	struct pdi_roi box;
+
+	pdi_get_hand_box(&box);
+	if (box.width == 0) {
+		*roi = full;
+		return 0;
+	}
+
+	int x0 = box.x - PDI_ROI_MARGIN;
+	int x1 = box.x + box.width - 1 + PDI_ROI_MARGIN;
+	int y0 = box.y - PDI_ROI_MARGIN;
 
-	// clock_gettime(CLOCK_REALTIME, &start_time);
+	x0 = (x0 < 0) ? 0 : x0;
+	x1 = (x1 > IMG_WIDTH - 1) ? IMG_WIDTH - 1 : x1;
+	y0 = (y0 < 0) ? 0 : y0;
 
-	spi_send_byte(0x00);           // Envia o byte
-	spi_send_byte(start_pdi_byte); // Envia o byte
+	roi->x = x0;
+	roi->y = y0;
+	roi->width = x1 - x0 + 1;
+	roi->height = IMG_HEIGHT - y0;
+	return 0;
+}
 
-	while (1) {
-		received_byte = spi_receive_byte(); // Recebe o byte
-		if (received_byte == 0x00) {
-			continue;
+// Lê os ciclos de clock gastos em cada estágio pelo último PDI
+int pdi_read_cycles(uint32_t cycles[PDI_STAGE_COUNT])
+{
+	for (int stage = 0; stage < PDI_STAGE_COUNT; stage++) {
+		if (LINK_USES_WINDOW()) {
+			cycles[stage] = spi_read_reg(WINDOW_REG_CYCLES(stage));
+		} else {
+			spi_send_byte(0x00); // Envia o byte
+			spi_send_byte(NO_RETURN_MASK | CYCLES_OP_MASK | stage);
+			spi_send_byte(0x00); // Envia o byte
+			cycles[stage] = receive_u32();
 		}
-		break;
 	}
+	return 0;
+}
+
+/* Imprime os ciclos de cada estágio do último PDI e o total do contador de hardware
+ * (cycles_total, da ativação ao fim) com o tempo correspondente no clock da FPGA. A soma
+ * dos estágios vai ao lado só como conferência: os estágios são contíguos e devem bater
+ */
+int pdi_print_cycles()
+{
+	static const char *const names[PDI_STAGE_COUNT] = {"binarizacao", "morfologia",
+							    "contorno", "picos/classificacao"};
+	uint32_t cycles[PDI_STAGE_COUNT];
+	struct pdi_results results;
+	uint64_t sum = 0;
+
+	pdi_read_cycles(cycles);
+	pdi_read_record(&results);
+	printf("Ciclos do PDI:");
+	for (int stage = 0; stage < PDI_STAGE_COUNT; stage++) {
+		printf(" %s %u |", names[stage], cycles[stage]);
+		sum += cycles[stage];
+	}
+	printf(" total %u (%llu us) | soma dos estagios %llu\n", results.cycles,
+	       (unsigned long long)results.cycles * 1000000 / PDI_CLOCK_HZ,
+	       (unsigned long long)sum);
+	return 0;
+}
+
+/* Inicia o PDI sobre o banco bank sem esperar o fim da execução; chroma -> o banco tem só os
+ * planos Cb e Cr (PDI_CHROMA_FRAME_MASK)
+ */
+int start_pdi(uint8_t bank, uint8_t chroma)
+{
+	pdi_bank = bank & 0x1;
+	pdi_roi = bank_roi[pdi_bank];
+	pdi_use_irq = (spi_pdi_irq_arm() == 0);
+
+	if (LINK_USES_WINDOW()) {
+		spi_write_reg(WINDOW_REG_CTRL, WINDOW_CTRL_PDI_RUN |
+					      (pdi_bank ? WINDOW_CTRL_PDI_BANK : 0) |
+					      (chroma ? WINDOW_CTRL_PDI_CHROMA : 0));
+	} else {
+		spi_send_byte(0x00); // Envia o byte
+		spi_send_byte(NO_RETURN_MASK | PDI_EXEC_OP_MASK | FRAME_BANK_MASK(pdi_bank) |
+			      (chroma ? PDI_CHROMA_FRAME_MASK : IMAGE_CHN_DFT));
+	}
+	return 0;
+}
 
-	while (1) {
-		received_byte = spi_receive_byte(); // Recebe o byte
-		if (received_byte == PDI_RUNNING_MASK) {
-			continue;
+// Espera o fim do PDI iniciado por start_pdi()
+int wait_pdi()
+{
+	// Com a interrupção não há polling no link
+	if (pdi_use_irq) {
+		return spi_pdi_irq_wait(PDI_TIMEOUT_MS);
+	}
+
+	if (LINK_USES_WINDOW()) {
+		while (spi_read_reg(WINDOW_REG_CTRL) & WINDOW_CTRL_PDI_RUN) {
 		}
-		break;
+		return 0;
+	}
+
+	// Cada byte de comando devolve o status do PDI na transação seguinte
+	spi_send_byte(0x00); // Envia o byte
+	while (spi_receive_byte() == PDI_RUNNING_MASK) {
+	}
+	return 0;
+}
+
+/* Espera o PDI liberar os canais do banco em processamento (fim da binarização), depois do
+ * que um novo quadro pode ser enviado ao mesmo banco; -ENOTSUP -> sem esse status no link SPI
+ */
+int wait_pdi_frame()
+{
+	if (!LINK_USES_WINDOW()) {
+		return -ENOTSUP;
+	}
+
+	while (spi_read_reg(WINDOW_REG_CTRL) & WINDOW_CTRL_FRAME_BUSY) {
+	}
+	return 0;
+}
+
+static inline uint32_t record_field(const uint8_t *record, int offset, int bytes)
+{
+	uint32_t value = 0;
+
+	for (int i = 0; i < bytes; i++) {
+		value = (value << 8) | record[offset + i];
+	}
+	return value;
+}
+
+/* Lê todos os resultados do último PDI. No protocolo SPI vem num único registro
+ * (RESULTS_OP_MASK) de PDI_RECORD_BYTES bytes, MSB primeiro: classificação (1), picos (2),
+ * área (3), perímetro (3), max_distance (5), ponto de referência x (2) e y (2) e ciclos (4)
+ */
+int pdi_read_record(struct pdi_results *results)
+{
+	if (LINK_USES_WINDOW()) {
+		uint32_t reference = spi_read_reg(WINDOW_REG_REFERENCE);
+
+		results->classification = spi_read_reg(WINDOW_REG_CLASS);
+		results->peaks = spi_read_reg(WINDOW_REG_PEAKS);
+		results->hand_area = spi_read_reg(WINDOW_REG_AREA);
+		results->hand_perimeter = spi_read_reg(WINDOW_REG_PERIMETER);
+		results->max_distance = ((uint64_t)spi_read_reg(WINDOW_REG_DIST_HI) << 32) |
+					spi_read_reg(WINDOW_REG_DIST_LO);
+		results->reference_x = reference & 0xFFFF;
+		results->reference_y = reference >> 16;
+		results->cycles = spi_read_reg(WINDOW_REG_CYCLES_TOTAL);
+		return 0;
 	}
 
-	uint8_t gesture_eval = NO_RETURN_MASK | GESTURE_EVAL_MASK | IMAGE_CHN_DFT;
+	uint8_t record[PDI_RECORD_BYTES];
 
-	// clock_gettime(CLOCK_REALTIME, &start_time);
+	spi_send_byte(0x00); // Envia o byte
+	spi_send_byte(NO_RETURN_MASK | RESULTS_OP_MASK);
+	spi_send_byte(0x00); // Envia o byte
+	spi_recv_buffer(record, sizeof(record));
 
-	spi_send_byte(0x00);         // Envia o byte
-	spi_send_byte(gesture_eval); // Envia o byte
-	spi_send_byte(0x00);         // Envia o byte
+	results->classification = record[0];
+	results->peaks = record_field(record, 1, 2);
+	results->hand_area = record_field(record, 3, 3);
+	results->hand_perimeter = record_field(record, 6, 3);
+	results->max_distance = ((uint64_t)record[9] << 32) | record_field(record, 10, 4);
+	results->reference_x = record_field(record, 14, 2);
+	results->reference_y = record_field(record, 16, 2);
+	results->cycles = record_field(record, 18, 4);
+	return 0;
+}
 
-	uint32_t pdi_result = 0;
-	for (int i = 3; i >= 0; i--) {
-		uint8_t received_byte = spi_receive_byte();
-		pdi_result |= (received_byte << (8 * i));
+#if DEBUG == 1
+// Lê len bytes da máscara do último PDI, com 8 pixels por byte na geometria do recorte
+static void read_mask(uint8_t *buf, size_t len)
+{
+	if (LINK_USES_WINDOW()) {
+		spi_read_mask(buf, len);
+		return;
 	}
 
-	switch (pdi_result) {
+	spi_send_byte(0x00); // Envia o byte
+	spi_send_byte(NO_RETURN_MASK | RECV_MASK_OP_MASK);
+	spi_send_byte(0x00);          // Envia o byte
+	spi_recv_buffer(buf, len); // Recebe a máscara inteira
+}
+#endif
+
+// Lê os resultados do último PDI
+int read_pdi_results()
+{
+	struct pdi_results results;
+
+	pdi_read_record(&results);
+
+	switch (results.classification) {
 	case 1:
 #if DEBUG == 1
 		printf("\nClassification: One Finger Up\n");
@@ -73,16 +365,13 @@ int execute_pdi()
 #endif
 		break;
 	default:
-		printf("\nClassification: Unknown %u\n", pdi_result);
+		printf("\nClassification: Unknown %u\n", results.classification);
 		break;
 	}
 
 #if DEBUG == 1
-	uint8_t img_r_start_byte = NO_RETURN_MASK | RECV_IMAGE_OP_MASK | IMAGE_CHN_R;
+	// O resultado do PDI fica na máscara binária, com 8 pixels por byte
 	uint16_t img_white = 0;
-	spi_send_byte(0x00);             // Envia o byte
-	spi_send_byte(img_r_start_byte); // Envia o byte
-	spi_send_byte(0x00);             // Envia o byte
 
 	// Cria arquivo com a imagem em formato de texto
 	FILE *img_file = fopen("img_r_channel.txt", "w");
@@ -91,10 +380,19 @@ int execute_pdi()
 		return -1;
 	}
 
+	static uint8_t img_mask_readback[(IMG_HEIGHT * IMG_WIDTH + 7) / 8];
+	read_mask(img_mask_readback, ((uint32_t)pdi_roi.width * pdi_roi.height + 7) / 8);
+
+	// A máscara do recorte é posta na posição dele na imagem
 	for (size_t i = 0; i < IMG_HEIGHT * IMG_WIDTH; i++) {
-		uint8_t received_byte = spi_receive_byte(); // Recebe o byte
+		int x = i % IMG_WIDTH - pdi_roi.x;
+		int y = i / IMG_WIDTH - pdi_roi.y;
+		uint8_t received_byte = 0;
+		if (x >= 0 && x < pdi_roi.width && y >= 0 && y < pdi_roi.height) {
+			received_byte = mask_bit(img_mask_readback, y * pdi_roi.width + x);
+		}
 		fprintf(img_file, "%c", received_byte ? '*' : ' ');
-		if (i % 320 == 0 && i != 0) {
+		if (i % IMG_WIDTH == 0 && i != 0) {
 			fprintf(img_file, "\n");
 		}
 
@@ -103,45 +401,38 @@ int execute_pdi()
 			img_white++;
 		}
 	}
-#endif
 
-	uint32_t hand_area_result = 0;
-	spi_send_byte(HAND_AREA_MASK);
-	spi_send_byte(0x00); // Envia o byte
+	printf("\nHand area: %u\n", results.hand_area);
+	printf("\nHand perimeter: %u\n", results.hand_perimeter);
+	printf("\nHand peak: %u\n", results.peaks);
+	printf("\nMax distance: %llu, reference point: (%u, %u), %u cycles\n",
+	       (unsigned long long)results.max_distance, results.reference_x, results.reference_y,
+	       results.cycles);
 
-	for (int i = 3; i >= 0; i--) {
-		uint8_t received_byte = spi_receive_byte();
-		hand_area_result |= (received_byte << (8 * i));
-	}
-
-#if DEBUG == 1
-	printf("\nHand area: %d\n", hand_area_result);
+	struct pdi_roi hand_box;
+	pdi_get_hand_box(&hand_box);
+	printf("\nHand box: %ux%u at (%u, %u)\n", hand_box.width, hand_box.height, hand_box.x,
+	       hand_box.y);
 #endif
+	return 0;
+}
 
-	uint32_t hand_per_result = 0;
-	spi_send_byte(HAND_PER_MASK);
-	spi_send_byte(0x00); // Envia o byte
+// Executa o PDI sobre o banco 0 e lê os resultados
+int execute_pdi()
+{
+	int err = start_pdi(0, 0);
 
-	for (int i = 3; i >= 0; i--) {
-		uint8_t received_byte = spi_receive_byte();
-		hand_per_result |= (received_byte << (8 * i));
+	if (!err) {
+		err = wait_pdi();
 	}
-
-#if DEBUG == 1
-	printf("\nHand perimeter: %d\n", hand_per_result);
-#endif
-
-	uint32_t hand_peak_result = 0;
-	spi_send_byte(HAND_PEAK_MASK);
-	spi_send_byte(0x00); // Envia o byte
-
-	for (int i = 3; i >= 0; i--) {
-		uint8_t received_byte = spi_receive_byte();
-		hand_peak_result |= (received_byte << (8 * i));
+	if (err) {
+		printf("Erro ao aguardar o PDI: %d\n", err);
+		return err;
 	}
 
-#if DEBUG == 1
-	printf("\nHand peak: %d\n", hand_peak_result);
-#endif
-	return 0;
+	err = read_pdi_results();
+	if (!err) {
+		err = pdi_print_cycles();
+	}
+	return err;
 }
\ No newline at end of file
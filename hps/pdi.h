@@ -15,15 +15,110 @@
 #define HAND_AREA_MASK     0b00010000
 #define HAND_PER_MASK      0b00010100
 #define HAND_PEAK_MASK     0b00011000
+#define RECV_MASK_OP_MASK  0b00100000
+#define GEOMETRY_OP_MASK   0b00100100
+#define SEND_ROI_OP_MASK   0b00101000
+#define ROI_OP_MASK        0b00101100
+#define BOX_MIN_OP_MASK    0b00110000
+#define BOX_MAX_OP_MASK    0b00110100
+#define CYCLES_OP_MASK     0b00111000 // Canal da imagem seleciona o estágio (PDI_STAGE_*)
+#define RESULTS_OP_MASK    0b00111100 // Registro com todos os resultados (struct pdi_results)
+
+// Bit 7 do byte de comando seleciona o banco de quadro
+#define FRAME_BANK_MASK(bank) ((uint8_t)(((bank) & 0x1) << 7))
 
 #define IMAGE_CHN_DFT 0b00000000
 #define IMAGE_CHN_R   0b00000001
 #define IMAGE_CHN_G   0b00000010
 #define IMAGE_CHN_B   0b00000011
 
+/* Canal 01 no início do PDI: quadro só de crominância, com o Cb no canal G e o Cr no canal B,
+ * calculados pelo host (ver pdi_sw_chroma() e CHROMA no Makefile)
+ */
+#define PDI_CHROMA_FRAME_MASK IMAGE_CHN_R
+
+/* Geometria dos quadros enviados (ver HEIGHT e WIDTH no Makefile). A FPGA aceita qualquer
+ * geometria até a sintetizada (IMG_HEIGHT e IMG_WIDTH do top.v) e troca tamanhos inválidos pelos
+ * sintetizados, por isso a geometria é lida de volta com pdi_get_geometry()
+ */
+#ifndef IMG_HEIGHT
 #define IMG_HEIGHT 240
-#define IMG_WIDTH  320
+#endif
+#ifndef IMG_WIDTH
+#define IMG_WIDTH 320
+#endif
+#if IMG_HEIGHT * IMG_WIDTH > 131072
+#error "IMG_HEIGHT * IMG_WIDTH excede os 17 bits de endereço das BRAMs"
+#endif
+
+/* Recorte (ROI) da imagem da câmera enviado e processado pela FPGA, em pixels da imagem. O
+ * recorte vai até a última linha da imagem, onde o PDI começa o contorno da mão
+ */
+struct pdi_roi {
+	uint16_t x;
+	uint16_t y;
+	uint16_t width;
+	uint16_t height;
+};
+
+#define PDI_FULL_ROI {0, 0, IMG_WIDTH, IMG_HEIGHT}
+
+// Margem em pixels em volta da mão do quadro anterior ao escolher o próximo recorte
+#ifndef PDI_ROI_MARGIN
+#define PDI_ROI_MARGIN 16
+#endif
+
+// Estágios do PDI com contador de ciclos no img_processing
+#define PDI_STAGE_BINARIZATION 0 // Estados 2 a 4: médias, compensação, YCbCr e binarização
+#define PDI_STAGE_MORPHOLOGY   1 // Estado 7: erosão, dilatação, área e perímetro
+#define PDI_STAGE_CONTOUR      2 // Estado 12: contorno e candidatos a pico
+#define PDI_STAGE_PEAKS        3 // Estados 13 a 15: limiar, picos e classificação
+#define PDI_STAGE_COUNT        4
+
+// Resultados do último PDI, lidos de uma vez com pdi_read_record()
+#define PDI_RECORD_BYTES 22
+struct pdi_results {
+	uint8_t classification;
+	uint16_t peaks;
+	uint32_t hand_area;
+	uint32_t hand_perimeter;
+	uint64_t max_distance; // Maior distância ao quadrado do contorno ao ponto de referência
+	uint16_t reference_x;
+	uint16_t reference_y;
+	uint32_t cycles; // Ciclos de clock do PDI, da ativação ao fim
+};
+
+// Clock do img_processing (clk do top.v, oscilador de 50 MHz)
+#define PDI_CLOCK_HZ 50000000
+
+// Tempo máximo de espera pela interrupção de pdi_done
+#define PDI_TIMEOUT_MS 1000
+
+// Usa a janela de memória quando o backend a oferece (ver WINDOW no Makefile)
+#ifndef USE_WINDOW
+#define USE_WINDOW 1
+#endif
+#define LINK_USES_WINDOW() (USE_WINDOW && spi_has_window())
+
+// Bancos de quadro do bitstream (FRAME_BANKS do top.v); com a janela é lido de WINDOW_REG_BANKS
+#ifndef FRAME_BANKS
+#define FRAME_BANKS 1
+#endif
 
+int pdi_frame_banks();
+int pdi_set_geometry(uint16_t height, uint16_t width);
+int pdi_get_geometry(uint16_t *height, uint16_t *width);
+int pdi_set_roi(uint8_t bank, const struct pdi_roi *roi);
+int pdi_get_roi(struct pdi_roi *roi);
+int pdi_get_hand_box(struct pdi_roi *box);
+int pdi_track_roi(struct pdi_roi *roi);
+int pdi_read_cycles(uint32_t cycles[PDI_STAGE_COUNT]);
+int pdi_read_record(struct pdi_results *results);
+int pdi_print_cycles();
+int start_pdi(uint8_t bank, uint8_t chroma);
+int wait_pdi();
+int wait_pdi_frame();
+int read_pdi_results();
 int execute_pdi();
 
 #endif
\ No newline at end of file
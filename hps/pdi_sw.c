@@ -0,0 +1,699 @@
+#include "pdi_sw.h"
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PDI_SW_NEON 1
+#else
+#define PDI_SW_NEON 0
+#endif
+
+#define PDI_SW_ADDR_MASK 0x1FFFF        // Endereços da BRAM têm 17 bits
+#define PDI_SW_DIST_MASK 0x7FFFFFFFFULL // max_distance e distance_buffer têm 35 bits
+#define PDI_SW_SUM_MASK  0x1FFFFFF      // Somas dos canais têm 25 bits
+
+// Geometria do quadro em processamento, fixada no início do PDI como no img_processing
+static struct pdi_sw_geometry {
+	uint32_t width;
+	uint32_t height;
+	uint32_t pixels;
+	uint32_t last_pixel;
+	uint32_t last_row; // Endereço do primeiro pixel da última linha
+} geometry;
+
+// Saída dos estágios de compensação do estado 4, que não é escrita na BRAM
+static uint8_t compensated[PDI_SW_CHN_COUNT][PDI_SW_MAX_PIXELS];
+
+// Cb e Cr do terceiro estágio do estado 4
+static uint8_t chroma[2][PDI_SW_MAX_PIXELS];
+
+// Candidatos a pico (máximos locais da distância radial) guardados durante o contorno
+static struct pdi_sw_peak_candidate {
+	uint32_t point;
+	uint64_t distance;
+} candidates[PDI_SW_PEAK_CANDIDATES];
+
+static const int8_t directions[8][2] = {
+	{-1, -1}, {-1, 0}, {-1, 1}, {0, 1}, {1, 1}, {1, 0}, {1, -1}, {0, -1},
+};
+
+// Endereço do contorno limitado ao último pixel do quadro, como no img_processing
+static inline uint32_t frame_index(uint32_t addr)
+{
+	addr &= PDI_SW_ADDR_MASK;
+	return (addr <= geometry.last_pixel) ? addr : geometry.last_pixel;
+}
+
+// Posição vizinha de addr na direção dir, com a aritmética modular de 17 bits do RTL
+static inline uint32_t step_addr(uint32_t addr, int dir)
+{
+	addr += directions[dir][0] * (int32_t)geometry.width;
+	addr += directions[dir][1];
+	return addr & PDI_SW_ADDR_MASK;
+}
+
+// Somas dos canais como acumuladas pelo bram_controller no envio de um quadro inteiro
+void pdi_sw_sums(struct pdi_sw_frame *frame)
+{
+	uint32_t pixels = (uint32_t)frame->height * frame->width;
+
+	for (int c = 0; c < PDI_SW_CHN_COUNT; c++) {
+		const uint8_t *src = frame->channel[c];
+		uint32_t sum = 0;
+		uint32_t i = 0;
+
+#if PDI_SW_NEON
+		uint32x4_t acc = vdupq_n_u32(0);
+		for (; i + 16 <= pixels; i += 16) {
+			acc = vpadalq_u16(acc, vpaddlq_u8(vld1q_u8(src + i)));
+		}
+		uint64x2_t acc64 = vpaddlq_u32(acc);
+		sum = vgetq_lane_u64(acc64, 0) + vgetq_lane_u64(acc64, 1);
+#endif
+		for (; i < pixels; i++) {
+			sum += src[i];
+		}
+		frame->sum[c] = sum & PDI_SW_SUM_MASK;
+	}
+}
+
+/* Compensação de um canal: dst = src * mean / max_mean, com max_mean > 0. Com NEON a divisão
+ * pelo divisor constante vira multiplicação (Granlund e Montgomery, numeradores de 16 bits):
+ * q = (t + ((n - t) >> sh1)) >> sh2, com t a metade alta de n * m
+ */
+static void compensate_channel(uint8_t *dst, const uint8_t *src, uint8_t mean, uint8_t max_mean)
+{
+	uint32_t i = 0;
+
+#if PDI_SW_NEON
+	int l = 0;
+	while ((1u << l) < max_mean) {
+		l++;
+	}
+	uint16x4_t m = vdup_n_u16(((((1u << l) - max_mean) << 16) / max_mean) + 1);
+	int16x8_t sh1 = vdupq_n_s16((l > 0) ? -1 : 0);
+	int16x8_t sh2 = vdupq_n_s16((l > 0) ? 1 - l : 0);
+	uint8x8_t mean_vec = vdup_n_u8(mean);
+
+	for (; i + 8 <= geometry.pixels; i += 8) {
+		uint16x8_t n = vmull_u8(vld1_u8(src + i), mean_vec);
+		uint16x8_t t = vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(n), m), 16),
+					    vshrn_n_u32(vmull_u16(vget_high_u16(n), m), 16));
+		uint16x8_t q = vaddq_u16(t, vshlq_u16(vsubq_u16(n, t), sh1));
+		vst1_u8(dst + i, vmovn_u16(vshlq_u16(q, sh2)));
+	}
+#endif
+	for (; i < geometry.pixels; i++) {
+		uint16_t temp = src[i] * mean;
+		dst[i] = temp / max_mean;
+	}
+}
+
+/* Estados 2 a 4: médias dos canais (somas do envio) e primeiro estágio do pipeline do estado 4.
+ * Como nas antigas passadas separadas, o penúltimo pixel segue sem compensação.
+ */
+static void illumination_compensation(const struct pdi_sw_frame *frame)
+{
+	uint8_t mean[PDI_SW_CHN_COUNT];
+	uint8_t max_mean;
+
+	// O divisor do estado 2 calcula 8 bits de quociente, então a média satura em 255
+	for (int c = 0; c < PDI_SW_CHN_COUNT; c++) {
+		uint32_t quotient = frame->sum[c] / geometry.pixels;
+
+		mean[c] = (quotient > 255) ? 255 : quotient;
+	}
+
+	if (mean[PDI_SW_CHN_R] > mean[PDI_SW_CHN_G] && mean[PDI_SW_CHN_R] > mean[PDI_SW_CHN_B]) {
+		max_mean = mean[PDI_SW_CHN_R];
+	} else if (mean[PDI_SW_CHN_G] > mean[PDI_SW_CHN_R] &&
+		   mean[PDI_SW_CHN_G] > mean[PDI_SW_CHN_B]) {
+		max_mean = mean[PDI_SW_CHN_G];
+	} else {
+		max_mean = mean[PDI_SW_CHN_B];
+	}
+
+	for (int c = 0; c < PDI_SW_CHN_COUNT; c++) {
+		if (max_mean) {
+			compensate_channel(compensated[c], frame->channel[c], mean[c], max_mean);
+		} else {
+			// Divisor combinacional: divisão por zero resulta em todos os bits em 1
+			memset(compensated[c], 0xFF, geometry.pixels);
+		}
+		if (geometry.pixels >= 2) {
+			uint32_t i = geometry.last_pixel - 1;
+			compensated[c][i] = frame->channel[c][i];
+		}
+	}
+}
+
+#if PDI_SW_NEON
+// 128 + (kr * r + kg * g + kb * b) >> 8 nos 8 bits de Cb ou Cr, para 8 pixels
+static inline uint8x8_t chroma_neon(int16x8_t r, int16x8_t g, int16x8_t b, int16_t kr, int16_t kg,
+				    int16_t kb)
+{
+	int16x8_t acc = vmulq_n_s16(r, kr);
+
+	acc = vmlaq_n_s16(acc, g, kg);
+	acc = vmlaq_n_s16(acc, b, kb);
+	return vmovn_u16(vreinterpretq_u16_s16(vaddq_s16(vshrq_n_s16(acc, 8), vdupq_n_s16(128))));
+}
+
+static inline int16x8_t widen_neon(uint8x8_t v)
+{
+	return vreinterpretq_s16_u16(vmovl_u8(v));
+}
+#endif
+
+/* Estado 4 (terceiro estágio): conversão para Cb/Cr. O último pixel não é binarizado pelo RTL:
+ * vira mão se o R compensado for maior que 0, o que é gravado como um Cb/Cr dentro ou fora das
+ * faixas de pele para que a binarização o trate como os demais
+ */
+static void chroma_planes(uint8_t *cb, uint8_t *cr)
+{
+	const uint8_t *red = compensated[PDI_SW_CHN_R];
+	const uint8_t *green = compensated[PDI_SW_CHN_G];
+	const uint8_t *blue = compensated[PDI_SW_CHN_B];
+	uint32_t i = 0;
+
+#if PDI_SW_NEON
+	for (; i + 16 <= geometry.last_pixel; i += 16) {
+		uint8x16_t r = vld1q_u8(red + i);
+		uint8x16_t g = vld1q_u8(green + i);
+		uint8x16_t b = vld1q_u8(blue + i);
+		int16x8_t r_lo = widen_neon(vget_low_u8(r)), r_hi = widen_neon(vget_high_u8(r));
+		int16x8_t g_lo = widen_neon(vget_low_u8(g)), g_hi = widen_neon(vget_high_u8(g));
+		int16x8_t b_lo = widen_neon(vget_low_u8(b)), b_hi = widen_neon(vget_high_u8(b));
+
+		vst1q_u8(cb + i, vcombine_u8(chroma_neon(r_lo, g_lo, b_lo, -38, -74, 112),
+					     chroma_neon(r_hi, g_hi, b_hi, -38, -74, 112)));
+		vst1q_u8(cr + i, vcombine_u8(chroma_neon(r_lo, g_lo, b_lo, 112, -94, -18),
+					     chroma_neon(r_hi, g_hi, b_hi, 112, -94, -18)));
+	}
+#endif
+	for (; i < geometry.last_pixel; i++) {
+		int32_t r = red[i];
+		int32_t g = green[i];
+		int32_t b = blue[i];
+
+		cb[i] = 128 + ((uint32_t)(-(r * 38) - (g * 74) + (b * 112)) >> 8);
+		cr[i] = 128 + ((uint32_t)((r * 112) - (g * 94) - (b * 18)) >> 8);
+	}
+
+	int hand = red[geometry.last_pixel] != 0;
+	cb[geometry.last_pixel] = hand ? PDI_SW_CB_MIN : 0;
+	cr[geometry.last_pixel] = hand ? PDI_SW_CR_MIN : 0;
+}
+
+// Estado 4 (último estágio): binarização de todos os pixels pelas faixas de Cb e Cr
+static void skin_mask(const uint8_t *cb, const uint8_t *cr, uint8_t *mask)
+{
+	uint32_t i = 0;
+
+#if PDI_SW_NEON
+	for (; i + 16 <= geometry.pixels; i += 16) {
+		uint8x16_t cb_vec = vld1q_u8(cb + i);
+		uint8x16_t cr_vec = vld1q_u8(cr + i);
+
+		uint8x16_t skin = vcgeq_u8(cb_vec, vdupq_n_u8(PDI_SW_CB_MIN));
+		skin = vandq_u8(skin, vcleq_u8(cb_vec, vdupq_n_u8(PDI_SW_CB_MAX)));
+		skin = vandq_u8(skin, vcgeq_u8(cr_vec, vdupq_n_u8(PDI_SW_CR_MIN)));
+		skin = vandq_u8(skin, vcleq_u8(cr_vec, vdupq_n_u8(PDI_SW_CR_MAX)));
+		vst1q_u8(mask + i, skin);
+	}
+#endif
+	for (; i < geometry.pixels; i++) {
+		mask[i] = (cb[i] >= PDI_SW_CB_MIN && cb[i] <= PDI_SW_CB_MAX && cr[i] >= PDI_SW_CR_MIN &&
+			   cr[i] <= PDI_SW_CR_MAX)
+				  ? 255
+				  : 0;
+	}
+}
+
+#if PDI_SW_NEON
+// Peso de cada pixel no byte da máscara empacotada, para 16 pixels
+static const uint8_t bit_weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+#endif
+
+// Bits dos pixels válidos da palavra word de uma linha com width pixels
+static inline uint64_t valid_bits(uint32_t word, uint32_t width)
+{
+	uint32_t first = word * 64;
+
+	if (first + 64 <= width) {
+		return ~0ULL;
+	}
+	return (first < width) ? (1ULL << (width - first)) - 1 : 0;
+}
+
+// Empacota a máscara (0 ou 255 por pixel) em 1 bit por pixel
+void pdi_sw_pack(struct pdi_sw_bitmap *bitmap, const uint8_t *mask, uint16_t height, uint16_t width)
+{
+	bitmap->height = height;
+	bitmap->width = width;
+
+	for (uint32_t row = 0; row < height; row++) {
+		uint64_t *words = bitmap->row[row];
+		const uint8_t *src = mask + row * width;
+		uint32_t col = 0;
+
+		memset(words, 0, sizeof(bitmap->row[row]));
+#if PDI_SW_NEON
+		// 16 pixels viram 16 bits somando os pesos dos bytes em 255 aos pares
+		uint8x16_t weights = vld1q_u8(bit_weights);
+		for (; col + 16 <= width; col += 16) {
+			uint8x16_t bits = vandq_u8(vld1q_u8(src + col), weights);
+			uint8x8_t sum = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+			sum = vpadd_u8(sum, sum);
+			sum = vpadd_u8(sum, sum);
+			uint64_t pixels = vget_lane_u8(sum, 0) | (vget_lane_u8(sum, 1) << 8);
+			words[col / 64] |= pixels << (col % 64);
+		}
+#endif
+		for (; col < width; col++) {
+			words[col / 64] |= (uint64_t)(src[col] & 0x1) << (col % 64);
+		}
+	}
+}
+
+// Desempacota a máscara em 0 ou 255 por pixel
+void pdi_sw_unpack(const struct pdi_sw_bitmap *bitmap, uint8_t *mask)
+{
+	for (uint32_t row = 0; row < bitmap->height; row++) {
+		const uint64_t *words = bitmap->row[row];
+		uint8_t *dst = mask + row * bitmap->width;
+		uint32_t col = 0;
+
+#if PDI_SW_NEON
+		uint8x16_t weights = vld1q_u8(bit_weights);
+		for (; col + 16 <= bitmap->width; col += 16) {
+			uint16_t pixels = words[col / 64] >> (col % 64);
+			uint8x16_t bytes = vcombine_u8(vdup_n_u8(pixels & 0xFF), vdup_n_u8(pixels >> 8));
+			vst1q_u8(dst + col, vtstq_u8(bytes, weights));
+		}
+#endif
+		for (; col < bitmap->width; col++) {
+			dst[col] = ((words[col / 64] >> (col % 64)) & 0x1) ? 255 : 0;
+		}
+	}
+}
+
+/* Kernel em cruz sobre a máscara empacotada, 64 pixels por operação: os vizinhos de cima e de
+ * baixo são as palavras das linhas vizinhas e os laterais a palavra deslocada de um bit, com o
+ * bit que entra vindo da palavra ao lado. Como no estado 7, só o interior é processado e as
+ * bordas mantêm o valor de src
+ */
+static void cross_kernel(struct pdi_sw_bitmap *dst, const struct pdi_sw_bitmap *src, int dilate)
+{
+	const uint32_t words = (src->width + 63) / 64;
+	uint64_t interior[PDI_SW_ROW_WORDS];
+
+	for (uint32_t w = 0; w < words; w++) {
+		interior[w] = valid_bits(w, src->width - 1) & ~valid_bits(w, 1);
+	}
+
+	dst->height = src->height;
+	dst->width = src->width;
+	memcpy(dst->row[0], src->row[0], sizeof(src->row[0]));
+	for (uint32_t row = 1; row + 1 < src->height; row++) {
+		const uint64_t *up = src->row[row - 1];
+		const uint64_t *center = src->row[row];
+		const uint64_t *down = src->row[row + 1];
+
+		for (uint32_t w = 0; w < words; w++) {
+			uint64_t west = (center[w] << 1) | ((w > 0) ? center[w - 1] >> 63 : 0);
+			uint64_t east = (center[w] >> 1) | ((w + 1 < words) ? center[w + 1] << 63 : 0);
+			uint64_t value = dilate ? (up[w] | down[w] | west | center[w] | east)
+						: (up[w] & down[w] & west & center[w] & east);
+
+			dst->row[row][w] = (value & interior[w]) | (center[w] & ~interior[w]);
+		}
+	}
+	if (src->height > 1) {
+		memcpy(dst->row[src->height - 1], src->row[src->height - 1], sizeof(src->row[0]));
+	}
+}
+
+void pdi_sw_erode(struct pdi_sw_bitmap *dst, const struct pdi_sw_bitmap *src)
+{
+	cross_kernel(dst, src, 0);
+}
+
+void pdi_sw_dilate(struct pdi_sw_bitmap *dst, const struct pdi_sw_bitmap *src)
+{
+	cross_kernel(dst, src, 1);
+}
+
+// Pixels de mão, por contagem de bits
+uint32_t pdi_sw_area(const struct pdi_sw_bitmap *bitmap)
+{
+	const uint32_t words = (bitmap->width + 63) / 64;
+	uint32_t area = 0;
+
+	for (uint32_t row = 0; row < bitmap->height; row++) {
+		for (uint32_t w = 0; w < words; w++) {
+			area += __builtin_popcountll(bitmap->row[row][w]);
+		}
+	}
+	return area;
+}
+
+/* Perímetro como no estado 7: transições entre pixels consecutivos na ordem de varredura, com o
+ * último pixel de uma linha antes do primeiro da seguinte e um pixel 0 antes do primeiro
+ */
+uint32_t pdi_sw_perimeter(const struct pdi_sw_bitmap *bitmap)
+{
+	const uint32_t words = (bitmap->width + 63) / 64;
+	const uint32_t last_col = bitmap->width - 1;
+	uint32_t perimeter = 0;
+	uint64_t previous = 0;
+
+	for (uint32_t row = 0; row < bitmap->height; row++) {
+		const uint64_t *word = bitmap->row[row];
+
+		for (uint32_t w = 0; w < words; w++) {
+			uint64_t shifted = (word[w] << 1) | previous;
+
+			perimeter += __builtin_popcountll((word[w] ^ shifted) & valid_bits(w, bitmap->width));
+			previous = word[w] >> 63;
+		}
+		previous = (word[last_col / 64] >> (last_col % 64)) & 0x1;
+	}
+	return perimeter;
+}
+
+// Máscaras do estado 7: binarizada (entrada), erodida e dilatada (saída)
+static struct pdi_sw_bitmap bitmap;
+static struct pdi_sw_bitmap eroded;
+
+/* Ciclos do estado 7: a varredura vai de duas linhas antes da primeira linha binarizada com mão
+ * (da linha 0 se ela começa antes da linha 4) até três linhas depois da última (limitada à
+ * altura + 1), mais três ciclos para esvaziar o pipeline; sem mão é pulada
+ */
+static uint32_t morphology_cycles(const struct pdi_sw_bitmap *binarized)
+{
+	const uint32_t words = (binarized->width + 63) / 64;
+	int first_row = -1, last_row = -1;
+
+	for (uint32_t row = 0; row < binarized->height; row++) {
+		uint64_t any = 0;
+
+		for (uint32_t w = 0; w < words; w++) {
+			any |= binarized->row[row][w];
+		}
+		if (any) {
+			first_row = (first_row < 0) ? (int)row : first_row;
+			last_row = row;
+		}
+	}
+	if (first_row < 0) {
+		return 1;
+	}
+
+	int height = geometry.height;
+	int start_row = (first_row >= 4) ? first_row - 2 : 0;
+	int stop_row = (last_row + 5 < height + 1) ? last_row + 5 : height + 1;
+	return (stop_row - start_row + 1) * geometry.width + 3;
+}
+
+/* Estado 7: erosão seguida de dilatação com kernel em cruz sobre a máscara, numa única
+ * varredura. Apenas o interior da imagem é processado; bordas mantêm o valor binarizado.
+ */
+static void morphology(uint8_t *mask, struct pdi_sw_features *features)
+{
+	pdi_sw_pack(&bitmap, mask, geometry.height, geometry.width);
+	features->cycles[PDI_STAGE_MORPHOLOGY] = morphology_cycles(&bitmap);
+	pdi_sw_erode(&eroded, &bitmap);
+	pdi_sw_dilate(&bitmap, &eroded);
+	pdi_sw_unpack(&bitmap, mask);
+}
+
+// Caixa da mão dilatada: primeira e última linha e colunas extremas com bits em 1
+static void hand_box(const struct pdi_sw_bitmap *dilated, struct pdi_sw_features *features)
+{
+	const uint32_t words = (dilated->width + 63) / 64;
+
+	features->box_left = 0xFFFF;
+	features->box_top = 0xFFFF;
+	features->box_right = 0;
+	features->box_bottom = 0;
+
+	for (uint32_t row = 0; row < dilated->height; row++) {
+		const uint64_t *word = dilated->row[row];
+		int first = -1, last = -1;
+
+		for (uint32_t w = 0; w < words; w++) {
+			if (word[w]) {
+				first = (first < 0) ? (int)(w * 64 + __builtin_ctzll(word[w])) : first;
+				last = w * 64 + 63 - __builtin_clzll(word[w]);
+			}
+		}
+		if (first < 0) {
+			continue;
+		}
+
+		features->box_left = (first < features->box_left) ? first : features->box_left;
+		features->box_right = (last > features->box_right) ? last : features->box_right;
+		if (features->box_top == 0xFFFF) {
+			features->box_top = row;
+		}
+		features->box_bottom = row;
+	}
+}
+
+/* Área, perímetro e caixa da mão (calculados no estado 7 sobre os pixels dilatados) e estados
+ * 12 a 15:
+ * contorno a partir da última linha, picos da distância radial e classificação.
+ */
+static void features_from_mask(const uint8_t *mask, struct pdi_sw_features *features)
+{
+	uint8_t previous_pixel = (geometry.last_row > 0) ? mask[geometry.last_row - 1] : 0;
+	uint32_t init_x = 0;
+	uint32_t start_x = 0;
+	uint32_t reference_x = 0;
+
+	features->hand_area = pdi_sw_area(&bitmap);
+	features->hand_perimeter = pdi_sw_perimeter(&bitmap);
+	features->max_distance = 0;
+	features->peaks = 0;
+	features->classification = 0;
+	hand_box(&bitmap, features);
+
+	// Estado 7 na última linha: bordas da mão que definem o início do contorno e a referência
+	for (uint32_t k = geometry.last_row; k < geometry.pixels; k++) {
+		uint8_t pixel = mask[k];
+
+		// O último pixel não atualiza o init_x usado pela transição para o estado 12
+		if (k == geometry.last_pixel) {
+			start_x = init_x;
+		}
+
+		if (pixel != previous_pixel) {
+			if (init_x == 0 && pixel == 255) {
+				init_x = k >> 1;
+			} else if (init_x != 0 && pixel == 0) {
+				reference_x =
+					(((k >> 1) + init_x) - geometry.last_row) & PDI_SW_ADDR_MASK;
+			}
+		}
+
+		previous_pixel = pixel;
+	}
+
+	// Estado 12
+	uint32_t first_edge = (start_x << 1) & PDI_SW_ADDR_MASK;
+	uint32_t edge_candidate = first_edge;
+	uint32_t current_x = ((start_x << 1) - (geometry.last_row - 1)) & PDI_SW_ADDR_MASK;
+	uint32_t current_y = geometry.height - 1;
+	uint32_t current_direction = 0;
+	uint32_t buffer_index = 0;
+	uint64_t prev_distance = 0;
+	uint64_t prev_prev_distance = 0;
+	uint32_t candidate_count = 0;
+	uint32_t contour_cycles = 0;
+	int tracing = 1;
+
+	while (tracing) {
+		uint64_t dx = (current_x > reference_x) ? (current_x - reference_x)
+							: (reference_x - current_x);
+		uint64_t dy = (current_y > geometry.height - 1) ? (current_y - (geometry.height - 1))
+								: ((geometry.height - 1) - current_y);
+		uint64_t distance = (dx * dx + dy * dy) & PDI_SW_DIST_MASK;
+		uint32_t prev_edge = edge_candidate;
+
+		/* Máximo local no ponto anterior; descartado se já estiver abaixo do limiar do máximo
+		 * parcial, que só cresce até o estado 13
+		 */
+		if (buffer_index >= 2 && prev_prev_distance <= prev_distance &&
+		    prev_distance >= distance &&
+		    (prev_distance + 1) * 1000 > features->max_distance * 510 &&
+		    candidate_count < PDI_SW_PEAK_CANDIDATES) {
+			candidates[candidate_count].point = buffer_index - 1;
+			candidates[candidate_count].distance = prev_distance;
+			candidate_count++;
+		}
+
+		if (distance > features->max_distance) {
+			features->max_distance = distance;
+		}
+		if (buffer_index == 0) {
+			prev_prev_distance = distance;
+		} else if (buffer_index == 1) {
+			prev_distance = distance;
+		} else {
+			prev_prev_distance = prev_distance;
+			prev_distance = distance;
+		}
+		contour_cycles++; // aux_index 000
+		if (buffer_index++ >= PDI_SW_CONTOUR_POINTS - 1) {
+			break;
+		}
+
+		tracing = 0;
+		for (uint32_t direction_index = 0; direction_index < 8; direction_index++) {
+			int dir = (current_direction + direction_index) % 8;
+			edge_candidate = step_addr(prev_edge, dir);
+
+			contour_cycles += 2; // aux_index 001 e 010
+			if (mask[frame_index(edge_candidate)] == 0) {
+				continue;
+			}
+
+			// aux_index 011: um vizinho por clock
+			int is_edge = 0;
+			for (int neighbor = 0; neighbor < 8; neighbor++) {
+				contour_cycles++;
+				if (mask[frame_index(step_addr(edge_candidate, neighbor))] == 0) {
+					is_edge = 1;
+					break;
+				}
+			}
+			if (!is_edge) {
+				continue;
+			}
+
+			current_direction = (current_direction + direction_index + 6) % 8;
+			current_x = edge_candidate % geometry.width;
+			current_y = edge_candidate / geometry.width;
+			tracing = (edge_candidate != first_edge) && (current_y < geometry.height - 1);
+			break;
+		}
+	}
+
+	features->cycles[PDI_STAGE_CONTOUR] = contour_cycles;
+
+	// Estado 13: o limiar fica em peak_threshold e max_distance mantém o máximo
+	uint64_t threshold = ((features->max_distance * 510) & PDI_SW_DIST_MASK) / 1000;
+
+	// Estado 14: limiar e espaçamento mínimo aplicados aos candidatos, em ordem
+	uint32_t prev_index = 0;
+	for (uint32_t i = 0; i < candidate_count; i++) {
+		if (candidates[i].distance >= threshold && (candidates[i].point - prev_index) > 10) {
+			features->peaks = (features->peaks + 1) & 0x3FF;
+			prev_index = candidates[i].point;
+		}
+	}
+
+	// Estados 13 e 15, um candidato por clock e o fim da lista no estado 14
+	features->cycles[PDI_STAGE_PEAKS] = candidate_count + 3;
+	features->reference_x = reference_x;
+	features->reference_y = geometry.height - 1;
+
+	// Estado 15
+	uint32_t perimeter = features->hand_perimeter;
+	uint32_t peaks = features->peaks;
+	if (perimeter > 440 && perimeter < 660 && peaks == 1) {
+		features->classification = 1;
+	} else if (perimeter > 440 && perimeter < 660 && peaks == 2) {
+		features->classification = 2;
+	} else if (perimeter > 440 && perimeter < 660 && peaks == 3) {
+		features->classification = 3;
+	} else if (perimeter > 610 && peaks == 4) {
+		features->classification = 4;
+	} else if (perimeter >= 687 && peaks == 5) {
+		features->classification = 5;
+	} else if (perimeter < 381) {
+		features->classification = 6;
+	} else {
+		features->classification = 7;
+	}
+}
+
+// Geometria do quadro fixada no início do PDI, como no estado 0
+static int set_geometry(const struct pdi_sw_frame *frame)
+{
+	if (frame->height == 0 || frame->width == 0 || frame->height > PDI_SW_MAX_HEIGHT ||
+	    frame->width > PDI_SW_MAX_WIDTH) {
+		return -EINVAL;
+	}
+
+	geometry.width = frame->width;
+	geometry.height = frame->height;
+	geometry.pixels = geometry.width * geometry.height;
+	geometry.last_pixel = geometry.pixels - 1;
+	geometry.last_row = geometry.pixels - geometry.width;
+	return 0;
+}
+
+/* Planos Cb e Cr do quadro RGB frame (somas preenchidas), com a compensação e a conversão do
+ * img_processing, para o envio só de crominância: com eles a FPGA chega à mesma máscara
+ */
+int pdi_sw_chroma(const struct pdi_sw_frame *frame, uint8_t *cb, uint8_t *cr)
+{
+	int err = set_geometry(frame);
+
+	if (err) {
+		return err;
+	}
+	illumination_compensation(frame);
+	chroma_planes(cb, cr);
+	return 0;
+}
+
+/* Executa o PDI sobre frame, deixando em mask (height x width bytes) a máscara final com 0 ou
+ * 255 por pixel; -EINVAL se a geometria for vazia ou maior que a sintetizada. Um quadro
+ * de crominância (frame->chroma) vai direto à binarização
+ */
+int pdi_sw_run(const struct pdi_sw_frame *frame, uint8_t *mask, struct pdi_sw_features *features)
+{
+	int err = set_geometry(frame);
+
+	if (err) {
+		return err;
+	}
+
+	if (frame->chroma) {
+		skin_mask(frame->channel[PDI_SW_CHN_G], frame->channel[PDI_SW_CHN_B], mask);
+		// Estado 0 direto para o 4: um pixel por clock e quatro ciclos para esvaziar o pipeline
+		features->cycles[PDI_STAGE_BINARIZATION] = geometry.pixels + 4;
+	} else {
+		illumination_compensation(frame);
+		chroma_planes(chroma[0], chroma[1]);
+		skin_mask(chroma[0], chroma[1], mask);
+		/* Estado 2 (um bit das médias por clock), estado 3, um pixel por clock no estado 4 e
+		 * quatro ciclos para esvaziar o pipeline
+		 */
+		features->cycles[PDI_STAGE_BINARIZATION] = geometry.pixels + 13;
+	}
+	morphology(mask, features);
+	features_from_mask(mask, features);
+
+	features->cycles_total = 0;
+	for (int stage = 0; stage < PDI_STAGE_COUNT; stage++) {
+		features->cycles_total += features->cycles[stage];
+	}
+	return 0;
+}
+
+// Resultados no formato de pdi_read_record()
+void pdi_sw_results(const struct pdi_sw_features *features, struct pdi_results *results)
+{
+	results->classification = features->classification;
+	results->peaks = features->peaks;
+	results->hand_area = features->hand_area;
+	results->hand_perimeter = features->hand_perimeter;
+	results->max_distance = features->max_distance;
+	results->reference_x = features->reference_x;
+	results->reference_y = features->reference_y;
+	results->cycles = features->cycles_total;
+}
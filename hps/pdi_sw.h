@@ -0,0 +1,90 @@
+#ifndef PDI_SW_H
+#define PDI_SW_H
+
+#include "pdi.h"
+
+/* PDI em software: o pipeline do img_processing (estados 2 a 15) executado no HPS, com as mesmas
+ * larguras de registrador, fórmulas em ponto fixo e efeitos de borda do RTL, para que máscara e
+ * resultados sejam iguais aos da FPGA. Serve de alternativa quando a FPGA está ocupada e de
+ * referência para o hardware. Compilado com NEON (-mfpu=neon), as somas, a compensação e a
+ * binarização processam 8 ou 16 pixels por instrução. A morfologia, a área e o perímetro usam a
+ * máscara empacotada (struct pdi_sw_bitmap), 64 pixels por palavra.
+ *
+ * No envio só de crominância (PDI_CHROMA_FRAME_MASK) o host faz a compensação e a conversão com
+ * pdi_sw_chroma() e envia os planos Cb e Cr nos canais G e B; o img_processing vai direto à
+ * binarização.
+ */
+
+// Maior quadro processado, o sintetizado no top.v (IMG_HEIGHT e IMG_WIDTH)
+#define PDI_SW_MAX_HEIGHT 240
+#define PDI_SW_MAX_WIDTH  320
+#define PDI_SW_MAX_PIXELS (PDI_SW_MAX_HEIGHT * PDI_SW_MAX_WIDTH)
+
+#define PDI_SW_CONTOUR_POINTS  4096 // CONTOUR_POINTS do top.v
+#define PDI_SW_PEAK_CANDIDATES 256  // PEAK_CANDIDATES do top.v
+
+// Faixas de Cb e Cr binarizadas como mão (stream_bit do img_processing)
+#define PDI_SW_CB_MIN 90
+#define PDI_SW_CB_MAX 120
+#define PDI_SW_CR_MIN 139
+#define PDI_SW_CR_MAX 170
+
+enum pdi_sw_channel {
+	PDI_SW_CHN_R = 0,
+	PDI_SW_CHN_G,
+	PDI_SW_CHN_B,
+	PDI_SW_CHN_COUNT
+};
+
+/* Quadro de entrada, com os canais contíguos em height x width pixels. Num quadro de
+ * crominância (chroma em 1) o canal G tem o Cb e o B o Cr de pdi_sw_chroma(), e R e as somas
+ * não são usados
+ */
+struct pdi_sw_frame {
+	uint16_t height;
+	uint16_t width;
+	const uint8_t *channel[PDI_SW_CHN_COUNT];
+	// Somas dos canais, acumuladas pelo bram_controller no envio (ver pdi_sw_sums())
+	uint32_t sum[PDI_SW_CHN_COUNT];
+	uint8_t chroma;
+};
+
+// Resultados do PDI, com os registradores do img_processing
+struct pdi_sw_features {
+	uint32_t hand_area;
+	uint32_t hand_perimeter;
+	uint64_t max_distance;
+	uint32_t peaks;
+	uint32_t classification;
+	// Caixa da mão dilatada: esquerda e topo em 0xFFFF sem pixels de mão
+	uint16_t box_left;
+	uint16_t box_top;
+	uint16_t box_right;
+	uint16_t box_bottom;
+	// Ciclos de clock que o img_processing gasta em cada estágio (PDI_STAGE_*)
+	uint32_t cycles[PDI_STAGE_COUNT];
+	uint32_t cycles_total;
+	uint16_t reference_x;
+	uint16_t reference_y;
+};
+
+// Máscara empacotada: pixel x da linha y no bit x % 64 de row[y][x / 64], bits além de width em 0
+#define PDI_SW_ROW_WORDS ((PDI_SW_MAX_WIDTH + 63) / 64)
+struct pdi_sw_bitmap {
+	uint16_t height;
+	uint16_t width;
+	uint64_t row[PDI_SW_MAX_HEIGHT][PDI_SW_ROW_WORDS];
+};
+
+void pdi_sw_pack(struct pdi_sw_bitmap *bitmap, const uint8_t *mask, uint16_t height, uint16_t width);
+void pdi_sw_unpack(const struct pdi_sw_bitmap *bitmap, uint8_t *mask);
+void pdi_sw_erode(struct pdi_sw_bitmap *dst, const struct pdi_sw_bitmap *src);
+void pdi_sw_dilate(struct pdi_sw_bitmap *dst, const struct pdi_sw_bitmap *src);
+uint32_t pdi_sw_area(const struct pdi_sw_bitmap *bitmap);
+uint32_t pdi_sw_perimeter(const struct pdi_sw_bitmap *bitmap);
+void pdi_sw_sums(struct pdi_sw_frame *frame);
+int pdi_sw_chroma(const struct pdi_sw_frame *frame, uint8_t *cb, uint8_t *cr);
+int pdi_sw_run(const struct pdi_sw_frame *frame, uint8_t *mask, struct pdi_sw_features *features);
+void pdi_sw_results(const struct pdi_sw_features *features, struct pdi_results *results);
+
+#endif
@@ -1,173 +1,159 @@
 #include "spi.h"
 /* Protocolo:
- * Byte 1 -> Comando -> Retorno FPGA [7-6] | Operação [5-2] | Canal da imagem [1-0]
+ * Byte 1 -> Comando -> Banco de quadro [7] | Operação [5-2] | Canal da imagem [1-0]
  * Bytes 2-3 -> Altura da imagem
  * Bytes 3-4 -> Largura da imagem
  * Bytes restantes -> Pixels da imagem
  *
- * Retorno FPGA: 00 -> Sem retorno | 01 -> PDI em execução,
+ * Banco de quadro: banco acessado pelo envio/recebimento de imagem e processado pelo PDI.
+ *
+ * Retorno FPGA [7-6] (devolvido após cada byte de comando): 00 -> Sem retorno |
+ * 01 -> PDI em execução. O PDI roda em segundo plano e o link segue aceitando comandos,
  *
  * Operação: 0000 -> Nenhuma operação | 0001 -> Envio de imagem | 0010 -> Recebimento de
- * imagem | 0011 -> Execução de PDI | 0111 -> Classificação do gesto,
+ * imagem | 0011 -> Execução de PDI | 0111 -> Classificação do gesto | 1000 -> Recebimento
+ * da máscara binária (altura * largura / 8 bytes, 8 pixels por byte, com o PDI parado) |
+ * 1001 -> Geometria em uso (altura << 16 | largura) | 1010 -> Envio de recorte (ROI): linha e
+ * coluna do recorte na imagem da câmera (2 bytes cada) antes da altura e da largura |
+ * 1011 -> Origem do recorte em uso (y << 16 | x) | 1100 -> Canto superior esquerdo da mão
+ * dilatada (topo << 16 | esquerda, 0xFFFF sem mão) | 1101 -> Canto inferior direito da mão
+ * (base << 16 | direita) | 1110 -> Ciclos de clock do estágio do PDI no canal da imagem
+ * (00 binarização, 01 morfologia, 10 contorno, 11 picos e classificação) | 1111 -> Registro
+ * com todos os resultados (22 bytes, ver pdi_read_record()),
+ *
+ * Altura e largura: definem a geometria dos quadros seguintes; 0 ou valores acima do quadro
+ * sintetizado são trocados pelo tamanho sintetizado,
  *
  * Canal da imagem: 00 -> Canal padrão (R) | 01 -> Canal 1 (R) | 02 -> Canal 2(G) |
  * 11 -> Canal 3 (B).
  */
 
-#define ONE_CYC_DELAY 1
-// Configurações para o bridge HPS-to-FPGA
-#define HW_REGS_BASE  (ALT_STM_OFST)
-#define HW_REGS_SPAN  (0x04000000) // 64 MB com espaço de endereçamento de 32 bits
-#define HW_REGS_MASK  (HW_REGS_SPAN - 1)
-
-#define ONE_SECOND_NS (1000000000)
-
-// Diretiva de compilação para DEBUG
+// Backend selecionado em tempo de compilação (ver TRANSPORT no Makefile)
+#if defined(SPI_TRANSPORT_EMU)
+static const struct spi_transport *transport = &spi_emu_transport;
+#elif defined(SPI_TRANSPORT_SIM)
+static const struct spi_transport *transport = &spi_sim_transport;
+#elif defined(SPI_TRANSPORT_PAR)
+static const struct spi_transport *transport = &spi_par_transport;
+#else
+static const struct spi_transport *transport = &spi_pio_transport;
+#endif
 
-static struct spi {
-	uint32_t *sck_addr;
-	uint32_t *ss_addr;
-	uint32_t *mosi_addr;
-	uint32_t *miso_addr;
-} spi_fields = {0};
-// Funções inline para controlar os pinos do SPI
-static inline void set_mosi(uint8_t bit)
+int spi_open()
 {
-	*(spi_fields.mosi_addr) = bit;
+#if DEBUG == 1
+	printf("Transporte SPI: %s\n", transport->name);
+#endif
+	return transport->open();
 }
 
-static inline void toggle_sck()
+void spi_close()
 {
-	*(spi_fields.sck_addr) ^= 0x1;
+	transport->close();
 }
 
-static inline void set_ss()
+const char *spi_transport_name()
 {
-	*(spi_fields.ss_addr) = 0x1;
+	return transport->name;
 }
 
-static inline void clear_ss()
+// Função para transmitir um byte via SPI
+void spi_send_byte(uint8_t byte)
 {
-	*(spi_fields.ss_addr) = 0x0;
+	transport->send(byte);
 }
 
-static inline void set_sck()
+// Função para receber um byte via SPI (leitura do pino MISO)
+uint8_t spi_receive_byte()
 {
-	*(spi_fields.sck_addr) = 0x1;
+	return transport->recv();
 }
 
-static inline void clear_sck()
+// Transmite um pacote completo mantendo o slave selecionado entre os bytes
+void spi_send_buffer(const uint8_t *buf, size_t len)
 {
-	*(spi_fields.sck_addr) = 0x0;
+	if (transport->send_buffer) {
+		transport->send_buffer(buf, len);
+		return;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		transport->send(buf[i]);
+	}
 }
 
-int bringup_sequence()
+// Recebe len bytes mantendo o slave selecionado entre os bytes
+void spi_recv_buffer(uint8_t *buf, size_t len)
 {
-	// Testa a sequência de inicialização do SPI
-
-	set_sck(); // Ativa o clock SPI
-
-	set_mosi(0x1); // Ativa o MOSI
-
-	clear_sck(); // Desativa o clock SPI
-
-	set_mosi(0x0); // Desativa o MOSI
-
-	clear_ss(); // Seleciona o slave
-
-	// Inicializa o slave select
-	set_ss(); // Libera o slave após a transferência
+	if (transport->recv_buffer) {
+		transport->recv_buffer(buf, len);
+		return;
+	}
 
-	return 0;
+	for (size_t i = 0; i < len; i++) {
+		buf[i] = transport->recv();
+	}
 }
 
-static inline void spi_change_to_default()
+// Indica se o backend expõe a janela de memória do hps_bram_window
+int spi_has_window()
 {
-	*(spi_fields.mosi_addr) = 0x0;
-	*(spi_fields.sck_addr) = 0x0;
-	*(spi_fields.ss_addr) = 0x1;
+	return transport->write_channel && transport->read_channel && transport->read_reg &&
+	       transport->write_reg;
 }
 
-int setup_mem_addr()
+// Escreve um canal da imagem diretamente na BRAM
+int spi_write_channel(uint8_t channel, const uint8_t *buf, size_t len)
 {
+	if (!spi_has_window()) {
+		return -ENOTSUP;
+	}
 
-	void *virtual_base;
-	int fd;
-
-	// map the address space for the LED registers into user space so we can interact with them.
-	// we'll actually map in the entire CSR span of the HPS since we want to access various
-	// registers within that span
+	transport->write_channel(channel, buf, len);
+	return 0;
+}
 
-	if ((fd = open("/dev/mem", (O_RDWR | O_SYNC))) == -1) {
-		printf("ERROR: could not open \"/dev/mem\"...\n");
-		return -EIO;
+// Lê um canal da imagem diretamente da BRAM
+int spi_read_channel(uint8_t channel, uint8_t *buf, size_t len)
+{
+	if (!spi_has_window()) {
+		return -ENOTSUP;
 	}
 
-	virtual_base =
-		mmap(NULL, HW_REGS_SPAN, (PROT_READ | PROT_WRITE), MAP_SHARED, fd, HW_REGS_BASE);
+	transport->read_channel(channel, buf, len);
+	return 0;
+}
 
-	if (virtual_base == MAP_FAILED) {
-		printf("ERROR: mmap() failed...\n");
-		close(fd);
-		return -EFAULT;
+// Lê a máscara binária deixada pelo último PDI
+int spi_read_mask(uint8_t *buf, size_t len)
+{
+	if (!spi_has_window() || !transport->read_mask) {
+		return -ENOTSUP;
 	}
 
-#if DEBUG == 1
-	printf("Endereco virtual do bridge: 0x%X\n", (unsigned int)virtual_base);
-#endif
-
-	spi_fields.miso_addr =
-		virtual_base + ((unsigned long)(ALT_LWFPGASLVS_OFST + SPI_MISO_BASE) &
-				(unsigned long)(HW_REGS_MASK));
-	spi_fields.mosi_addr =
-		virtual_base + ((unsigned long)(ALT_LWFPGASLVS_OFST + SPI_MOSI_BASE) &
-				(unsigned long)(HW_REGS_MASK));
-	spi_fields.sck_addr = virtual_base + ((unsigned long)(ALT_LWFPGASLVS_OFST + SPI_SCK_BASE) &
-					      (unsigned long)(HW_REGS_MASK));
-	spi_fields.ss_addr = virtual_base + ((unsigned long)(ALT_LWFPGASLVS_OFST + SPI_SS_BASE) &
-					     (unsigned long)(HW_REGS_MASK));
-
-	spi_change_to_default();
+	transport->read_mask(buf, len);
 	return 0;
 }
-static inline void delay(uint32_t cyc)
+
+uint32_t spi_read_reg(uint32_t reg)
 {
-	uint32_t cycles = cyc;
-	while (cycles--) {
-	}
+	return transport->read_reg ? transport->read_reg(reg) : 0;
 }
-// Função para transmitir um byte via SPI
-void spi_send_byte(uint8_t byte)
+
+void spi_write_reg(uint32_t reg, uint32_t value)
 {
-	clear_ss();                    // Seleciona o slave
-	for (int i = 7; i >= 0; i--) { // SPI é geralmente MSB first
-		clear_sck();           // Troca o clock
-		// delay(ONE_CYC_DELAY);  // Troca o clock
-
-		set_mosi((byte >> i) & 0x1); // Envia o bit atual
-		set_sck();                   // Troca de volta o clock
-					     // delay(ONE_CYC_DELAY);
+	if (transport->write_reg) {
+		transport->write_reg(reg, value);
 	}
-	spi_change_to_default(); // Volta para o estado inicial
 }
 
-// Função para receber um byte via SPI (leitura do pino MISO)
-uint8_t spi_receive_byte()
+// Habilita a espera do PDI por interrupção; -ENOTSUP -> usar polling
+int spi_pdi_irq_arm()
 {
-	uint8_t received_byte = 0;
-
-	clear_ss();                    // Seleciona o slave
-	for (int i = 7; i >= 0; i--) { //  é geralmente MSB first
-		clear_sck();           // Troca o clock
-		delay(ONE_CYC_DELAY);
-
-		set_sck(); // Troca o clock de volta
-		uint8_t bit = (*(spi_fields.miso_addr) & 0x1);
-		delay(ONE_CYC_DELAY);
-
-		received_byte |= (bit << i);
-	}
+	return transport->pdi_irq_arm ? transport->pdi_irq_arm() : -ENOTSUP;
+}
 
-	spi_change_to_default(); // Volta para o estado inicial
-	return received_byte;
-}
\ No newline at end of file
+int spi_pdi_irq_wait(int timeout_ms)
+{
+	return transport->pdi_irq_wait ? transport->pdi_irq_wait(timeout_ms) : -ENOTSUP;
+}
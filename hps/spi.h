@@ -4,14 +4,7 @@
 #include <stdint.h>
 
 #include <stdio.h>
-#include "hps_0.h"
-#include "hwlib.h"
-#include "soc_cv_av/socal/alt_gpio.h"
-#include "soc_cv_av/socal/hps.h"
-#include "soc_cv_av/socal/socal.h"
 #include "errno.h"
-#include <fcntl.h>
-#include <sys/mman.h>
 #include <sys/time.h>
 
 #include <unistd.h>
@@ -24,9 +17,100 @@
 		((byte) & 0x01 ? '1' : '0')
 #define UNUSED(x) (void)(x)
 
+/* Backend de transporte do link HPS <-> FPGA.
+ *
+ * open  -> Prepara o meio físico e deixa o link no estado padrão
+ * send  -> Transmite um byte (o byte devolvido pela FPGA é descartado)
+ * recv  -> Transmite 0x00 e retorna o byte devolvido pela FPGA
+ * close -> Libera os recursos do backend
+ *
+ * Opcionais (NULL -> laço de send/recv byte a byte):
+ * send_buffer -> Transmite um pacote inteiro numa única janela de chip select
+ * recv_buffer -> Recebe len bytes numa única janela de chip select
+ *
+ * Opcionais (NULL -> sem janela de memória, usar o protocolo SPI):
+ * write_channel -> Escreve len pixels no canal (IMAGE_CHN_*) a partir do endereço 0
+ * read_channel  -> Lê len pixels do canal (IMAGE_CHN_*) a partir do endereço 0
+ * read_mask     -> Lê len bytes da máscara binária (8 pixels por byte) a partir do byte 0
+ * read_reg      -> Lê um registrador WINDOW_REG_* do hps_bram_window
+ * write_reg     -> Escreve um registrador WINDOW_REG_* do hps_bram_window
+ *
+ * Opcionais (NULL -> espera do PDI por polling):
+ * pdi_irq_arm  -> Habilita a interrupção de pdi_done; chamado antes de iniciar o PDI
+ * pdi_irq_wait -> Bloqueia até pdi_done ou timeout_ms (-ETIMEDOUT)
+ */
+struct spi_transport {
+	const char *name;
+	int (*open)(void);
+	void (*send)(uint8_t byte);
+	uint8_t (*recv)(void);
+	void (*close)(void);
+	void (*send_buffer)(const uint8_t *buf, size_t len);
+	void (*recv_buffer)(uint8_t *buf, size_t len);
+	void (*write_channel)(uint8_t channel, const uint8_t *buf, size_t len);
+	void (*read_channel)(uint8_t channel, uint8_t *buf, size_t len);
+	void (*read_mask)(uint8_t *buf, size_t len);
+	uint32_t (*read_reg)(uint32_t reg);
+	void (*write_reg)(uint32_t reg, uint32_t value);
+	int (*pdi_irq_arm)(void);
+	int (*pdi_irq_wait)(int timeout_ms);
+};
+
+/* Janela Avalon-MM (hps_bram_window) em BRAM_WINDOW_BASE no lightweight bridge:
+ * address[18:17] -> 00 canal R | 01 canal G | 10 canal B | 11 registradores e máscara
+ */
+#define WINDOW_CHANNEL_SPAN 0x20000
+#define WINDOW_REGS_OFST    0x60000
+// Máscara binária, relativa a WINDOW_REGS_OFST (só leitura): pixel 8 * n + i no bit i do byte n
+#define WINDOW_MASK_OFST    0x4000
+// Canal padrão (00) é o R, como no bram_controller
+#define WINDOW_CHANNEL_OFST(chn) ((((chn) & 0x3) ? ((chn) & 0x3) - 1 : 0) * WINDOW_CHANNEL_SPAN)
+
+#define WINDOW_REG_AREA      0x00
+#define WINDOW_REG_PERIMETER 0x04
+#define WINDOW_REG_PEAKS     0x08
+#define WINDOW_REG_CLASS     0x0C
+#define WINDOW_REG_CTRL      0x10 // Escrita: bit 0 inicia o PDI | Leitura: bit 0 = PDI em execução
+#define WINDOW_REG_BANK      0x14 // Banco dos acessos aos canais; a escrita zera as somas dele
+#define WINDOW_REG_BANKS     0x18 // Número de bancos de quadro (FRAME_BANKS do top.v)
+#define WINDOW_REG_GEOMETRY  0x1C // Geometria dos quadros: altura << 16 | largura
+#define WINDOW_REG_ROI       0x20 // Origem do recorte na imagem da câmera: y << 16 | x
+#define WINDOW_REG_BOX_MIN   0x24 // Canto superior esquerdo da mão: topo << 16 | esquerda
+#define WINDOW_REG_BOX_MAX   0x28 // Canto inferior direito da mão: base << 16 | direita
+#define WINDOW_REG_CYCLES(stage) (0x2C + 4 * (stage)) // Ciclos do estágio (PDI_STAGE_*)
+#define WINDOW_REG_DIST_LO   0x3C // max_distance[31:0]
+#define WINDOW_REG_DIST_HI   0x40 // max_distance[34:32]
+#define WINDOW_REG_REFERENCE 0x44 // Ponto de referência do contorno: y << 16 | x
+#define WINDOW_REG_CYCLES_TOTAL 0x48 // Ciclos do último PDI, da ativação ao fim
+
+#define WINDOW_CTRL_PDI_RUN    0x1
+#define WINDOW_CTRL_PDI_BANK   0x2 // Banco processado pelo PDI
+#define WINDOW_CTRL_FRAME_BUSY 0x4 // Canais do banco ainda em uso (até o fim da binarização)
+#define WINDOW_CTRL_PDI_CHROMA 0x8 // Quadro só com Cb (canal G) e Cr (canal B)
+
+// Bit-bang sobre os PIOs do lightweight bridge (/dev/mem), usado na placa
+extern const struct spi_transport spi_pio_transport;
+// Byte inteiro por escrita nos PIOs par_out/par_in, com strobe (parallel_slave.v)
+extern const struct spi_transport spi_par_transport;
+// Emulação em software do data_transfer_controller e do img_processing
+extern const struct spi_transport spi_emu_transport;
+// Co-simulação Verilator do subsistema SPI do top.v (pdi_sim_top.v), ver spi_sim.cpp
+extern const struct spi_transport spi_sim_transport;
+
 uint8_t spi_receive_byte();
 void spi_send_byte(uint8_t byte);
-int setup_mem_addr();
-int bringup_sequence();
+void spi_send_buffer(const uint8_t *buf, size_t len);
+void spi_recv_buffer(uint8_t *buf, size_t len);
+int spi_has_window();
+int spi_write_channel(uint8_t channel, const uint8_t *buf, size_t len);
+int spi_read_channel(uint8_t channel, uint8_t *buf, size_t len);
+int spi_read_mask(uint8_t *buf, size_t len);
+uint32_t spi_read_reg(uint32_t reg);
+void spi_write_reg(uint32_t reg, uint32_t value);
+int spi_pdi_irq_arm();
+int spi_pdi_irq_wait(int timeout_ms);
+int spi_open();
+void spi_close();
+const char *spi_transport_name();
 
-#endif
\ No newline at end of file
+#endif
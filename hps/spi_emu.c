@@ -0,0 +1,596 @@
+#include "spi.h"
+#include "pdi.h"
+#include "pdi_sw.h"
+#include <string.h>
+
+/* Backend de emulação: reproduz em software o lado FPGA do link, permitindo compilar e medir
+ * main.c e execute_pdi() nativamente (x86 Linux) sem a DE10.
+ *
+ * - data_transfer_controller: máquina de estados byte a byte, com o mesmo atraso de um byte do
+ *   spi_slave (o byte devolvido numa transação é o spi_byte_out deixado pela transação anterior).
+ * - bram_controller: FRAME_BANKS bancos de três canais de EMU_IMG_SIZE bytes, com a
+ *   soma de cada canal acumulada durante o envio, e a máscara binária de 1 bit por pixel
+ *   (guardada aqui como 0/255 por pixel e empacotada na leitura).
+ * - img_processing: estados 2 a 15 pelo PDI em software (pdi_sw.c), com as larguras de
+ *   registrador e os efeitos de borda do RTL, para que as features sejam as mesmas da placa.
+ * - hps_bram_window: acesso direto aos canais, à máscara e aos registradores de resultado.
+ *
+ * Como no RTL, os buffers têm o tamanho do quadro sintetizado (EMU_IMG_HEIGHT x EMU_IMG_WIDTH) e
+ * a geometria em uso vem dos bytes de tamanho do envio ou de WINDOW_REG_GEOMETRY.
+ *
+ * O PDI emulado roda por inteiro no início e só sinaliza pdi_done após EMU_PDI_BUSY_POLLS
+ * transações; nesse intervalo o outro banco aceita o próximo quadro, como no RTL. O banco em
+ * processamento é liberado na metade desse intervalo, como ao fim da binarização no RTL.
+ */
+
+#define EMU_IMG_HEIGHT 240 // IMG_HEIGHT do top.v
+#define EMU_IMG_WIDTH  320 // IMG_WIDTH do top.v
+#define EMU_IMG_SIZE   (EMU_IMG_HEIGHT * EMU_IMG_WIDTH)
+#define EMU_LAST_PIXEL (EMU_IMG_SIZE - 1)
+#define EMU_ADDR_MASK  0x1FFFF       // Endereços da BRAM têm 17 bits
+#define EMU_SUM_MASK   0x1FFFFFF      // Somas dos canais têm 25 bits
+#define EMU_MASK_WORDS (EMU_IMG_SIZE / 32) // Palavras de 32 bits do bram_mask_storage
+#define EMU_MASK_BYTES (EMU_IMG_SIZE / 8)
+
+// Transações em que o PDI emulado permanece "em execução" antes de sinalizar pdi_done
+#define EMU_PDI_BUSY_POLLS 16
+
+enum emu_channel {
+	EMU_CHN_R = 0,
+	EMU_CHN_G,
+	EMU_CHN_B,
+	EMU_CHN_COUNT
+};
+
+static struct emu_dtc {
+	uint8_t state;
+	uint8_t size_byte_count;
+	uint16_t img_height;
+	uint16_t img_width;
+	uint16_t img_height_count;
+	uint16_t img_width_count;
+	uint8_t spi_byte_out;
+	uint32_t bram_addr;
+	uint8_t bram_channel;
+	uint8_t bram_bank;
+	uint8_t bram_mask;
+	uint8_t int_count;
+	uint32_t int_data;
+	uint8_t record_count;
+	uint8_t record_data[PDI_RECORD_BYTES];
+	uint8_t pdi_active;
+	uint8_t pdi_bank;
+	uint8_t pdi_chroma;
+	int pdi_busy_polls;
+	uint16_t frame_height;
+	uint16_t frame_width;
+	uint16_t img_roi_y;
+	uint16_t img_roi_x;
+	uint16_t roi_y;
+	uint16_t roi_x;
+} dtc;
+
+// Geometria do quadro em processamento, fixada no início do PDI como no img_processing
+static struct emu_geometry {
+	uint32_t width;
+	uint32_t height;
+	uint32_t pixels;
+	uint32_t last_pixel;
+	uint32_t last_row; // Endereço do primeiro pixel da última linha
+} geometry;
+
+// Banco dos acessos aos canais pela janela (registrador WINDOW_REG_BANK)
+static uint8_t window_bank;
+
+// Resultados do img_processing, calculados pelo PDI em software (pdi_sw.c)
+static struct pdi_sw_features features;
+
+static uint8_t bram[FRAME_BANKS][EMU_CHN_COUNT][EMU_IMG_SIZE];
+
+// Somas dos canais, zeradas no início de cada envio (bram_sum_clear)
+static uint32_t channel_sum[FRAME_BANKS][EMU_CHN_COUNT];
+
+// Canais do banco em processamento pelo img_processing
+static uint8_t (*frame)[EMU_IMG_SIZE] = bram[0];
+static uint32_t *frame_sum = channel_sum[0];
+
+// Máscara binária escrita pelo PDI (0 ou 255 por pixel); os canais RGB são só lidos
+static uint8_t mask[EMU_IMG_SIZE];
+
+static inline uint32_t bram_index(uint32_t addr)
+{
+	addr &= EMU_ADDR_MASK;
+	return (addr <= EMU_LAST_PIXEL) ? addr : EMU_LAST_PIXEL;
+}
+
+// Tamanhos 0 ou acima do quadro sintetizado viram o tamanho sintetizado
+static inline uint16_t clamp_size(uint16_t size, uint16_t max_size)
+{
+	return (size == 0 || size > max_size) ? max_size : size;
+}
+
+// Origem recuada para que o recorte caiba no quadro sintetizado
+static inline uint16_t clamp_origin(uint16_t origin, uint16_t size, uint16_t max_size)
+{
+	return ((uint32_t)origin + size > max_size) ? max_size - size : origin;
+}
+
+static inline enum emu_channel channel_from_bits(uint8_t bits)
+{
+	switch (bits & 0x3) {
+	case 0x2:
+		return EMU_CHN_G;
+	case 0x3:
+		return EMU_CHN_B;
+	default:
+		return EMU_CHN_R;
+	}
+}
+
+// Byte addr da máscara como na porta COM do bram_controller: pixel 8 * addr + i no bit i
+static uint8_t mask_byte(uint32_t addr)
+{
+	uint32_t word = addr >> 2;
+	uint32_t base;
+	uint8_t byte = 0;
+
+	word = (word < EMU_MASK_WORDS) ? word : EMU_MASK_WORDS - 1;
+	base = word * 32 + (addr & 0x3) * 8;
+	for (int i = 0; i < 8; i++) {
+		byte |= (mask[base + i] ? 1 : 0) << i;
+	}
+	return byte;
+}
+
+static void emu_run_pdi()
+{
+	struct pdi_sw_frame pdi_frame = {
+		.height = geometry.height,
+		.width = geometry.width,
+		.channel = {frame[EMU_CHN_R], frame[EMU_CHN_G], frame[EMU_CHN_B]},
+		.sum = {frame_sum[EMU_CHN_R], frame_sum[EMU_CHN_G], frame_sum[EMU_CHN_B]},
+		.chroma = dtc.pdi_chroma,
+	};
+
+	pdi_sw_run(&pdi_frame, mask, &features);
+}
+
+// Com um único banco o bit de banco é ignorado
+static inline uint8_t frame_bank(uint8_t bank)
+{
+	return (FRAME_BANKS > 1) ? (bank & 0x1) : 0;
+}
+
+// Canais ainda lidos pelo PDI (pdi_frame_busy); liberados na metade da execução emulada
+static inline int frame_busy()
+{
+	return dtc.pdi_active && dtc.pdi_busy_polls > EMU_PDI_BUSY_POLLS / 2;
+}
+
+// Como no bram_controller, o banco em processamento não é acessível pela porta COM
+static inline int bank_in_use(uint8_t bank)
+{
+	return frame_busy() && frame_bank(bank) == dtc.pdi_bank;
+}
+
+/* Início do PDI pelo link ou pela janela; ignorado enquanto o PDI está em execução. chroma ->
+ * quadro com Cb no canal G e Cr no canal B
+ */
+static void emu_start_pdi(uint8_t bank, uint8_t chroma)
+{
+	if (dtc.pdi_active) {
+		return;
+	}
+
+	dtc.pdi_active = 1;
+	dtc.pdi_bank = frame_bank(bank);
+	dtc.pdi_chroma = chroma;
+	dtc.pdi_busy_polls = EMU_PDI_BUSY_POLLS;
+	frame = bram[dtc.pdi_bank];
+	frame_sum = channel_sum[dtc.pdi_bank];
+	geometry.width = dtc.frame_width;
+	geometry.height = dtc.frame_height;
+	geometry.pixels = geometry.width * geometry.height;
+	geometry.last_pixel = geometry.pixels - 1;
+	geometry.last_row = geometry.pixels - geometry.width;
+	emu_run_pdi();
+}
+
+static void dtc_init_values()
+{
+	dtc.state = 0;
+	dtc.size_byte_count = 0;
+	dtc.img_height = 0;
+	dtc.img_width = 0;
+	dtc.img_height_count = 0;
+	dtc.img_width_count = 0;
+	dtc.spi_byte_out = 0;
+	dtc.bram_addr = EMU_ADDR_MASK;
+	dtc.bram_channel = 0;
+	dtc.bram_mask = 0;
+	dtc.int_count = 0;
+	dtc.record_count = 0;
+}
+
+// Registro da operação 1111, no formato de pdi_read_record()
+static void dtc_load_record()
+{
+	const uint64_t fields[][2] = {
+		{features.classification, 1}, {features.peaks, 2},
+		{features.hand_area, 3},      {features.hand_perimeter, 3},
+		{features.max_distance, 5},   {features.reference_x, 2},
+		{features.reference_y, 2},    {features.cycles_total, 4},
+	};
+	int offset = 0;
+
+	for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+		for (int i = fields[f][1] - 1; i >= 0; i--) {
+			dtc.record_data[offset++] = fields[f][0] >> (8 * i);
+		}
+	}
+}
+
+// Escrita de um pixel pela porta COM, somado ao canal como no bram_controller
+static void bram_write_pixel(uint8_t bank, enum emu_channel channel, uint32_t addr, uint8_t value)
+{
+	uint32_t *sum = &channel_sum[bank][channel];
+
+	bram[bank][channel][bram_index(addr)] = value;
+	*sum = (*sum + value) & EMU_SUM_MASK;
+}
+
+// Início de um envio: zera as somas dos canais first a last do banco, se ele estiver livre
+static void bram_clear_sums(uint8_t bank, enum emu_channel first, enum emu_channel last)
+{
+	if (bank_in_use(bank)) {
+		return;
+	}
+	for (int channel = first; channel <= last; channel++) {
+		channel_sum[bank][channel] = 0;
+	}
+}
+
+// Um ciclo de spi_cycle_done do data_transfer_controller
+static void dtc_step(uint8_t byte_in)
+{
+	enum emu_channel channel = channel_from_bits(dtc.bram_channel);
+	uint8_t bank = frame_bank(dtc.bram_bank);
+
+	switch (dtc.state) {
+	case 0: // Recebe o byte de comando; o bit 7 seleciona o banco
+		switch ((byte_in >> 2) & 0xF) {
+		case 0x1:
+			dtc.state = 1;
+			dtc.size_byte_count = 4;
+			dtc.img_roi_y = 0;
+			dtc.img_roi_x = 0;
+			dtc.bram_channel = byte_in & 0x3;
+			dtc.bram_bank = byte_in >> 7;
+			break;
+		case 0xA: // Envio de recorte: origem antes da altura e da largura
+			dtc.state = 1;
+			dtc.size_byte_count = 8;
+			dtc.bram_channel = byte_in & 0x3;
+			dtc.bram_bank = byte_in >> 7;
+			break;
+		case 0x2:
+			dtc.state = 3;
+			dtc.bram_addr = 0;
+			dtc.bram_channel = byte_in & 0x3;
+			dtc.bram_bank = byte_in >> 7;
+			break;
+		case 0x3:
+			emu_start_pdi(byte_in >> 7, (byte_in & 0x3) == PDI_CHROMA_FRAME_MASK);
+			break;
+		case 0x8:
+			dtc.state = 3;
+			dtc.bram_addr = 0;
+			dtc.bram_mask = 1;
+			break;
+		case 0x9:
+			dtc.state = 5;
+			dtc.int_data = ((uint32_t)dtc.frame_height << 16) | dtc.frame_width;
+			break;
+		case 0xB:
+			dtc.state = 5;
+			dtc.int_data = ((uint32_t)dtc.roi_y << 16) | dtc.roi_x;
+			break;
+		case 0xC:
+			dtc.state = 5;
+			dtc.int_data = ((uint32_t)features.box_top << 16) | features.box_left;
+			break;
+		case 0xD:
+			dtc.state = 5;
+			dtc.int_data = ((uint32_t)features.box_bottom << 16) | features.box_right;
+			break;
+		case 0xE:
+			dtc.state = 5;
+			dtc.int_data = features.cycles[byte_in & 0x3];
+			break;
+		case 0xF:
+			dtc.state = 6;
+			dtc_load_record();
+			break;
+		case 0x4:
+			dtc.state = 5;
+			dtc.int_data = features.hand_area;
+			break;
+		case 0x5:
+			dtc.state = 5;
+			dtc.int_data = features.hand_perimeter;
+			break;
+		case 0x6:
+			dtc.state = 5;
+			dtc.int_data = features.peaks;
+			break;
+		case 0x7:
+			dtc.state = 5;
+			dtc.int_data = features.classification;
+			break;
+		default:
+			dtc_init_values();
+			break;
+		}
+
+		// Status do PDI para o próximo byte
+		dtc.spi_byte_out = dtc.pdi_active ? PDI_RUNNING_MASK : NO_RETURN_MASK;
+		break;
+	case 1: // Recebe os bytes de tamanho da imagem
+		if (dtc.size_byte_count == 8) {
+			dtc.img_roi_y = (dtc.img_roi_y & 0x00FF) | (byte_in << 8);
+		} else if (dtc.size_byte_count == 7) {
+			dtc.img_roi_y = (dtc.img_roi_y & 0xFF00) | byte_in;
+		} else if (dtc.size_byte_count == 6) {
+			dtc.img_roi_x = (dtc.img_roi_x & 0x00FF) | (byte_in << 8);
+		} else if (dtc.size_byte_count == 5) {
+			dtc.img_roi_x = (dtc.img_roi_x & 0xFF00) | byte_in;
+		} else if (dtc.size_byte_count == 4) {
+			dtc.img_height = (dtc.img_height & 0x00FF) | (byte_in << 8);
+		} else if (dtc.size_byte_count == 3) {
+			dtc.img_height = (dtc.img_height & 0xFF00) | byte_in;
+		} else if (dtc.size_byte_count == 2) {
+			dtc.img_width = (dtc.img_width & 0x00FF) | (byte_in << 8);
+		} else if (dtc.size_byte_count == 1) {
+			dtc.img_width = (dtc.img_width & 0xFF00) | byte_in;
+		}
+
+		if (dtc.size_byte_count-- <= 1) {
+			dtc.state = 2;
+			bram_clear_sums(bank, channel, channel);
+			dtc.img_height_count = dtc.img_height;
+			dtc.img_width_count = (dtc.img_width & 0xFF00) | byte_in;
+			dtc.frame_height = clamp_size(dtc.img_height, EMU_IMG_HEIGHT);
+			dtc.frame_width = clamp_size(dtc.img_width_count, EMU_IMG_WIDTH);
+			dtc.roi_y = clamp_origin(dtc.img_roi_y, dtc.frame_height, EMU_IMG_HEIGHT);
+			dtc.roi_x = clamp_origin(dtc.img_roi_x, dtc.frame_width, EMU_IMG_WIDTH);
+		}
+		break;
+	case 2: // Recebe os pixels de um canal e escreve na BRAM
+		dtc.bram_addr = (dtc.bram_addr + 1) & EMU_ADDR_MASK;
+		if (!bank_in_use(bank)) {
+			bram_write_pixel(bank, channel, dtc.bram_addr, byte_in);
+		}
+
+		if (dtc.img_width_count-- <= 1) {
+			dtc.img_width_count = dtc.img_width;
+			if (dtc.img_height_count-- <= 1) {
+				dtc.state = 0;
+			}
+		}
+		break;
+	case 3: { // Envia os dados da BRAM ou da máscara (a máscara pertence ao PDI em execução)
+		// A máscara tem a geometria do último PDI, as imagens a do último envio
+		uint32_t last_pixel = dtc.bram_mask ? geometry.last_pixel
+						    : (uint32_t)dtc.frame_height * dtc.frame_width - 1;
+
+		if (dtc.bram_mask) {
+			dtc.spi_byte_out = dtc.pdi_active ? 0 : mask_byte(dtc.bram_addr);
+		} else {
+			dtc.spi_byte_out =
+				bank_in_use(bank) ? 0 : bram[bank][channel][bram_index(dtc.bram_addr)];
+		}
+		if (dtc.bram_addr++ >= (dtc.bram_mask ? last_pixel >> 3 : last_pixel)) {
+			dtc.state = 0;
+			dtc.bram_mask = 0;
+		}
+		break;
+	}
+	case 5: // Envia um inteiro de 32 bits, MSB primeiro
+		if (dtc.int_count <= 3) {
+			dtc.spi_byte_out = dtc.int_data >> (8 * (3 - dtc.int_count));
+		}
+		if (dtc.int_count == 3) {
+			dtc.state = 0;
+		}
+		dtc.int_count = (dtc.int_count + 1) & 0x7;
+		break;
+	case 6: // Envia o registro de resultados, MSB primeiro
+		dtc.spi_byte_out = dtc.record_data[dtc.record_count];
+		if (++dtc.record_count == PDI_RECORD_BYTES) {
+			dtc.state = 0;
+		}
+		break;
+	default:
+		dtc_init_values();
+		break;
+	}
+}
+
+// pdi_done é tratado entre duas transações, sem alterar o estado do link
+static void emu_pdi_tick()
+{
+	if (dtc.pdi_active && --dtc.pdi_busy_polls <= 0) {
+		dtc.pdi_active = 0;
+	}
+}
+
+static uint8_t emu_transfer(uint8_t byte_out)
+{
+	uint8_t byte_in = dtc.spi_byte_out;
+
+	emu_pdi_tick();
+	dtc_step(byte_out);
+	return byte_in;
+}
+
+static int emu_open()
+{
+	memset(bram, 0, sizeof(bram));
+	memset(channel_sum, 0, sizeof(channel_sum));
+	memset(mask, 0, sizeof(mask));
+	memset(&features, 0, sizeof(features));
+	memset(&dtc, 0, sizeof(dtc));
+	dtc_init_values();
+	dtc.frame_height = EMU_IMG_HEIGHT;
+	dtc.frame_width = EMU_IMG_WIDTH;
+	geometry.last_pixel = EMU_LAST_PIXEL;
+	window_bank = 0;
+	frame = bram[0];
+	frame_sum = channel_sum[0];
+	return 0;
+}
+
+static void emu_send_byte(uint8_t byte)
+{
+	emu_transfer(byte);
+}
+
+static uint8_t emu_receive_byte()
+{
+	return emu_transfer(0x00);
+}
+
+static void emu_close()
+{
+}
+
+// Como no hps_bram_window, acessos ao banco em processamento são ignorados
+static void emu_write_channel(uint8_t channel, const uint8_t *buf, size_t len)
+{
+	size_t n = len < EMU_IMG_SIZE ? len : EMU_IMG_SIZE;
+
+	if (bank_in_use(window_bank)) {
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		bram_write_pixel(frame_bank(window_bank), channel_from_bits(channel), i, buf[i]);
+	}
+}
+
+static void emu_read_channel(uint8_t channel, uint8_t *buf, size_t len)
+{
+	size_t n = len < EMU_IMG_SIZE ? len : EMU_IMG_SIZE;
+
+	if (bank_in_use(window_bank)) {
+		memset(buf, 0, len);
+		return;
+	}
+
+	memcpy(buf, bram[frame_bank(window_bank)][channel_from_bits(channel)], n);
+	memset(buf + n, 0, len - n);
+}
+
+// Como no hps_bram_window, a máscara só é lida com o PDI parado
+static void emu_read_mask(uint8_t *buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		buf[i] = (dtc.pdi_active || i >= EMU_MASK_BYTES) ? 0 : mask_byte(i);
+	}
+}
+
+static uint32_t emu_read_reg(uint32_t reg)
+{
+	switch (reg) {
+	case WINDOW_REG_AREA:
+		return features.hand_area;
+	case WINDOW_REG_PERIMETER:
+		return features.hand_perimeter;
+	case WINDOW_REG_PEAKS:
+		return features.peaks;
+	case WINDOW_REG_CLASS:
+		return features.classification;
+	case WINDOW_REG_CTRL:
+		emu_pdi_tick(); // Cada leitura de status conta como uma espera pelo PDI
+		return (dtc.pdi_active ? WINDOW_CTRL_PDI_RUN : 0) |
+		       (dtc.pdi_bank ? WINDOW_CTRL_PDI_BANK : 0) |
+		       (frame_busy() ? WINDOW_CTRL_FRAME_BUSY : 0) |
+		       (dtc.pdi_chroma ? WINDOW_CTRL_PDI_CHROMA : 0);
+	case WINDOW_REG_BANK:
+		return frame_bank(window_bank);
+	case WINDOW_REG_BANKS:
+		return FRAME_BANKS;
+	case WINDOW_REG_GEOMETRY:
+		return ((uint32_t)dtc.frame_height << 16) | dtc.frame_width;
+	case WINDOW_REG_ROI:
+		return ((uint32_t)dtc.roi_y << 16) | dtc.roi_x;
+	case WINDOW_REG_BOX_MIN:
+		return ((uint32_t)features.box_top << 16) | features.box_left;
+	case WINDOW_REG_BOX_MAX:
+		return ((uint32_t)features.box_bottom << 16) | features.box_right;
+	case WINDOW_REG_CYCLES(PDI_STAGE_BINARIZATION):
+	case WINDOW_REG_CYCLES(PDI_STAGE_MORPHOLOGY):
+	case WINDOW_REG_CYCLES(PDI_STAGE_CONTOUR):
+	case WINDOW_REG_CYCLES(PDI_STAGE_PEAKS):
+		return features.cycles[(reg - WINDOW_REG_CYCLES(0)) / 4];
+	case WINDOW_REG_DIST_LO:
+		return features.max_distance & 0xFFFFFFFF;
+	case WINDOW_REG_DIST_HI:
+		return features.max_distance >> 32;
+	case WINDOW_REG_REFERENCE:
+		return ((uint32_t)features.reference_y << 16) | features.reference_x;
+	case WINDOW_REG_CYCLES_TOTAL:
+		return features.cycles_total;
+	default:
+		return 0;
+	}
+}
+
+// O PDI iniciado pela janela não altera o estado do data_transfer_controller
+static void emu_write_reg(uint32_t reg, uint32_t value)
+{
+	if (reg == WINDOW_REG_CTRL && (value & WINDOW_CTRL_PDI_RUN)) {
+		emu_start_pdi((value & WINDOW_CTRL_PDI_BANK) ? 1 : 0,
+			      (value & WINDOW_CTRL_PDI_CHROMA) ? 1 : 0);
+	} else if (reg == WINDOW_REG_BANK) {
+		window_bank = value & 0x1;
+		bram_clear_sums(frame_bank(window_bank), EMU_CHN_R, EMU_CHN_B);
+	} else if (reg == WINDOW_REG_GEOMETRY) {
+		dtc.frame_height = clamp_size(value >> 16, EMU_IMG_HEIGHT);
+		dtc.frame_width = clamp_size(value & 0xFFFF, EMU_IMG_WIDTH);
+	} else if (reg == WINDOW_REG_ROI) {
+		dtc.roi_y = clamp_origin(value >> 16, dtc.frame_height, EMU_IMG_HEIGHT);
+		dtc.roi_x = clamp_origin(value & 0xFFFF, dtc.frame_width, EMU_IMG_WIDTH);
+	}
+}
+
+static int emu_pdi_irq_arm()
+{
+	return 0;
+}
+
+// pdi_done chega após EMU_PDI_BUSY_POLLS ciclos de espera, sem tráfego no link
+static int emu_pdi_irq_wait(int timeout_ms)
+{
+	UNUSED(timeout_ms);
+
+	while (dtc.pdi_active) {
+		emu_pdi_tick();
+	}
+	return 0;
+}
+
+const struct spi_transport spi_emu_transport = {
+	.name = "emu",
+	.open = emu_open,
+	.send = emu_send_byte,
+	.recv = emu_receive_byte,
+	.close = emu_close,
+	.write_channel = emu_write_channel,
+	.read_channel = emu_read_channel,
+	.read_mask = emu_read_mask,
+	.read_reg = emu_read_reg,
+	.write_reg = emu_write_reg,
+	.pdi_irq_arm = emu_pdi_irq_arm,
+	.pdi_irq_wait = emu_pdi_irq_wait,
+};
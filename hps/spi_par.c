@@ -0,0 +1,113 @@
+#include "spi.h"
+#include "bridge.h"
+#include "hps_0.h"
+
+/* Backend paralelo: cada byte do protocolo vai inteiro para o parallel_slave da FPGA.
+ *
+ * par_out [8:0] -> {strobe, byte}: o strobe troca de valor a cada byte enviado
+ * par_in  [8:0] <- {ack, byte}: ack copia o strobe depois que o byte foi entregue ao
+ *                  data_transfer_controller; byte é o que seria devolvido em MISO
+ *
+ * O fluxo de comandos, tamanho e pixels é o mesmo do SPI, então o data_transfer_controller
+ * não muda. Envios não esperam o ack: o parallel_slave compara o strobe uma vez por ciclo de
+ * clock, então cada escrita no PIO precisa durar ao menos um ciclo, o que supõe que o bridge
+ * não entregue duas escritas no mesmo ciclo.
+ */
+
+#define PAR_STROBE 0x100
+#define PAR_DATA   0xFF
+
+static struct par {
+	volatile uint32_t *out_addr;
+	volatile uint32_t *in_addr;
+	uint32_t strobe; // Último valor de strobe enviado (0 ou PAR_STROBE)
+} par_fields = {0};
+
+static int par_open()
+{
+	int err = bridge_open();
+	if (err) {
+		return err;
+	}
+
+	par_fields.out_addr = bridge_lw_addr(PAR_OUT_BASE);
+	par_fields.in_addr = bridge_lw_addr(PAR_IN_BASE);
+
+	// Continua a partir do strobe atual para não gerar um byte espúrio
+	par_fields.strobe = *(par_fields.out_addr) & PAR_STROBE;
+	return 0;
+}
+
+static void par_close()
+{
+	if (par_fields.out_addr == NULL) {
+		return;
+	}
+
+	bridge_close();
+	par_fields = (struct par){0};
+}
+
+static inline void par_write(uint8_t byte)
+{
+	par_fields.strobe ^= PAR_STROBE;
+	*(par_fields.out_addr) = par_fields.strobe | byte;
+}
+
+static inline uint8_t par_wait_ack()
+{
+	uint32_t in;
+
+	do {
+		in = *(par_fields.in_addr);
+	} while ((in & PAR_STROBE) != par_fields.strobe);
+
+	return in & PAR_DATA;
+}
+
+static void par_send_byte(uint8_t byte)
+{
+	par_write(byte);
+}
+
+static uint8_t par_receive_byte()
+{
+	par_write(0x00);
+	return par_wait_ack();
+}
+
+static void par_send_buffer(const uint8_t *buf, size_t len)
+{
+	volatile uint32_t *out = par_fields.out_addr;
+	uint32_t strobe = par_fields.strobe;
+
+	for (size_t i = 0; i < len; i++) {
+		strobe ^= PAR_STROBE;
+		*out = strobe | buf[i];
+	}
+	par_fields.strobe = strobe;
+}
+
+static void par_recv_buffer(uint8_t *buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		buf[i] = par_receive_byte();
+	}
+}
+
+const struct spi_transport spi_par_transport = {
+	.name = "par",
+	.open = par_open,
+	.send = par_send_byte,
+	.recv = par_receive_byte,
+	.close = par_close,
+	.send_buffer = par_send_buffer,
+	.recv_buffer = par_recv_buffer,
+	.write_channel = bridge_write_channel,
+	.read_channel = bridge_read_channel,
+	.read_mask = bridge_read_mask,
+	.read_reg = bridge_read_reg,
+	.write_reg = bridge_write_reg,
+	.pdi_irq_arm = bridge_pdi_irq_arm,
+	.pdi_irq_wait = bridge_pdi_irq_wait,
+};
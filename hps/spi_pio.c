@@ -0,0 +1,234 @@
+#include "spi.h"
+#include "bridge.h"
+#include "hps_0.h"
+
+/* Backend bit-bang: SCK, MOSI e SS dividem o PIO spi_ctrl (bits 0, 1 e 2) e MISO é um PIO de
+ * 1 bit, todos no lightweight bridge HPS-to-FPGA (ver bridge.c). Cada meio ciclo de SCK é um
+ * único store; as 16 palavras de cada byte são pré-calculadas em send_words.
+ */
+
+// Bits do PIO spi_ctrl (ver top.v)
+#define SPI_CTRL_SCK  0x1
+#define SPI_CTRL_MOSI 0x2
+#define SPI_CTRL_SS   0x4
+
+// Diretiva de compilação para DEBUG
+
+static struct spi {
+	volatile uint32_t *ctrl_addr;
+	volatile uint32_t *miso_addr;
+	uint32_t ctrl; // Cópia do último valor escrito em spi_ctrl
+} spi_fields = {0};
+
+// Palavras de spi_ctrl para um byte: SCK baixo (com o bit em MOSI) e SCK alto, MSB primeiro
+static uint8_t send_words[256][16];
+
+static inline void write_ctrl(uint32_t value)
+{
+	spi_fields.ctrl = value;
+	*(spi_fields.ctrl_addr) = value;
+}
+
+// Funções inline para controlar os pinos do SPI
+static inline void set_mosi(uint8_t bit)
+{
+	write_ctrl(bit ? (spi_fields.ctrl | SPI_CTRL_MOSI) : (spi_fields.ctrl & ~SPI_CTRL_MOSI));
+}
+
+static inline void set_ss()
+{
+	write_ctrl(spi_fields.ctrl | SPI_CTRL_SS);
+}
+
+static inline void clear_ss()
+{
+	write_ctrl(spi_fields.ctrl & ~SPI_CTRL_SS);
+}
+
+static inline void set_sck()
+{
+	write_ctrl(spi_fields.ctrl | SPI_CTRL_SCK);
+}
+
+static inline void clear_sck()
+{
+	write_ctrl(spi_fields.ctrl & ~SPI_CTRL_SCK);
+}
+
+static void build_send_words()
+{
+	for (int byte = 0; byte < 256; byte++) {
+		for (int i = 7; i >= 0; i--) {
+			uint8_t mosi = ((byte >> i) & 0x1) ? SPI_CTRL_MOSI : 0x0;
+			send_words[byte][2 * (7 - i)] = mosi;                    // SS e SCK baixos
+			send_words[byte][2 * (7 - i) + 1] = mosi | SPI_CTRL_SCK; // Borda de subida
+		}
+	}
+}
+
+#if DEBUG == 1
+static int bringup_sequence()
+{
+	// Testa a sequência de inicialização do SPI
+
+	set_sck(); // Ativa o clock SPI
+
+	set_mosi(0x1); // Ativa o MOSI
+
+	clear_sck(); // Desativa o clock SPI
+
+	set_mosi(0x0); // Desativa o MOSI
+
+	clear_ss(); // Seleciona o slave
+
+	// Inicializa o slave select
+	set_ss(); // Libera o slave após a transferência
+
+	return 0;
+}
+#endif
+
+static inline void spi_change_to_default()
+{
+	write_ctrl(SPI_CTRL_SS); // MOSI e SCK baixos, slave liberado
+}
+
+static int setup_mem_addr()
+{
+	int err = bridge_open();
+	if (err) {
+		return err;
+	}
+
+	spi_fields.miso_addr = bridge_lw_addr(SPI_MISO_BASE);
+	spi_fields.ctrl_addr = bridge_lw_addr(SPI_CTRL_BASE);
+
+	build_send_words();
+	spi_change_to_default();
+
+#if DEBUG == 1
+	bringup_sequence();
+#endif
+	return 0;
+}
+
+static void pio_close()
+{
+	if (spi_fields.ctrl_addr == NULL) {
+		return;
+	}
+
+	spi_change_to_default();
+	bridge_close();
+	spi_fields = (struct spi){0};
+}
+
+// Função para transmitir um byte via SPI
+static void pio_send_byte(uint8_t byte)
+{
+	volatile uint32_t *ctrl = spi_fields.ctrl_addr;
+	const uint8_t *words = send_words[byte];
+
+	// A primeira palavra já seleciona o slave (SS baixo); SPI é geralmente MSB first
+	for (int i = 0; i < 16; i++) {
+		*ctrl = words[i];
+	}
+	spi_change_to_default(); // Volta para o estado inicial
+}
+
+// Função para receber um byte via SPI (leitura do pino MISO)
+static uint8_t pio_receive_byte()
+{
+	uint8_t received_byte = 0;
+
+	clear_ss();                    // Seleciona o slave
+	for (int i = 7; i >= 0; i--) { //  é geralmente MSB first
+		clear_sck();           // Troca o clock
+		set_sck();             // Troca o clock de volta
+		uint8_t bit = (*(spi_fields.miso_addr) & 0x1);
+
+		received_byte |= (bit << i);
+	}
+
+	spi_change_to_default(); // Volta para o estado inicial
+	return received_byte;
+}
+
+/* Versões em pacote: o SS fica em nível baixo durante todo o buffer (o spi_slave recarrega o
+ * byte de saída ao fim de cada byte) e o laço de bits é desenrolado.
+ */
+#define PIO_SEND_WORDS(ctrl, words)                                                                \
+	do {                                                                                       \
+		*(ctrl) = (words)[0];                                                              \
+		*(ctrl) = (words)[1];                                                              \
+		*(ctrl) = (words)[2];                                                              \
+		*(ctrl) = (words)[3];                                                              \
+		*(ctrl) = (words)[4];                                                              \
+		*(ctrl) = (words)[5];                                                              \
+		*(ctrl) = (words)[6];                                                              \
+		*(ctrl) = (words)[7];                                                              \
+		*(ctrl) = (words)[8];                                                              \
+		*(ctrl) = (words)[9];                                                              \
+		*(ctrl) = (words)[10];                                                             \
+		*(ctrl) = (words)[11];                                                             \
+		*(ctrl) = (words)[12];                                                             \
+		*(ctrl) = (words)[13];                                                             \
+		*(ctrl) = (words)[14];                                                             \
+		*(ctrl) = (words)[15];                                                             \
+	} while (0)
+
+#define PIO_RECV_BIT(byte, i)                                                                      \
+	do {                                                                                       \
+		*ctrl = 0x0;                                                                       \
+		*ctrl = SPI_CTRL_SCK;                                                              \
+		(byte) |= (*miso & 0x1) << (i);                                                    \
+	} while (0)
+
+static void pio_send_buffer(const uint8_t *buf, size_t len)
+{
+	volatile uint32_t *ctrl = spi_fields.ctrl_addr;
+
+	for (size_t n = 0; n < len; n++) {
+		PIO_SEND_WORDS(ctrl, send_words[buf[n]]);
+	}
+	spi_change_to_default(); // Volta para o estado inicial
+}
+
+static void pio_recv_buffer(uint8_t *buf, size_t len)
+{
+	volatile uint32_t *ctrl = spi_fields.ctrl_addr;
+	volatile uint32_t *miso = spi_fields.miso_addr;
+
+	for (size_t n = 0; n < len; n++) {
+		uint32_t byte = 0;
+
+		PIO_RECV_BIT(byte, 7);
+		PIO_RECV_BIT(byte, 6);
+		PIO_RECV_BIT(byte, 5);
+		PIO_RECV_BIT(byte, 4);
+		PIO_RECV_BIT(byte, 3);
+		PIO_RECV_BIT(byte, 2);
+		PIO_RECV_BIT(byte, 1);
+		PIO_RECV_BIT(byte, 0);
+
+		buf[n] = byte;
+	}
+	spi_change_to_default(); // Volta para o estado inicial
+}
+
+const struct spi_transport spi_pio_transport = {
+	.name = "pio",
+	.open = setup_mem_addr,
+	.send = pio_send_byte,
+	.recv = pio_receive_byte,
+	.close = pio_close,
+	.send_buffer = pio_send_buffer,
+	.recv_buffer = pio_recv_buffer,
+	.write_channel = bridge_write_channel,
+	.read_channel = bridge_read_channel,
+	.read_mask = bridge_read_mask,
+	.read_reg = bridge_read_reg,
+	.write_reg = bridge_write_reg,
+	.pdi_irq_arm = bridge_pdi_irq_arm,
+	.pdi_irq_wait = bridge_pdi_irq_wait,
+};
@@ -0,0 +1,243 @@
+/* Backend de co-simulação: o subsistema SPI do top.v (fpga/simulation/verilator/pdi_sim_top.v,
+ * com spi_slave, data_transfer_controller, bram_controller e img_processing) compilado pelo
+ * Verilator (ou pelo fpga/simulation/minivl) e dirigido bit a bit como o bit-bang do spi_pio.c.
+ * main.c e pdi.c rodam sem alterações sobre o protocolo SPI (não há janela de memória no modelo).
+ *
+ * Cada meio ciclo de SCK dura sim_sck_half ciclos de clk (PDI_SIM_SCK_HALF no ambiente, padrão
+ * SIM_SCK_HALF). Ao fim de cada PDI são impressos os ciclos com pdi_active e os contadores de
+ * estágio do img_processing; spi_close() imprime o total da simulação.
+ */
+#include <cstdlib>
+
+#include "Vpdi_sim_top.h"
+#include "verilated.h"
+
+extern "C" {
+#include "pdi.h"
+}
+
+// Menor meio período em que o spi_slave vê as bordas de SCK (sck e mosi passam por registradores)
+#define SIM_SCK_HALF 4
+
+// Ciclos de clk em reset ao abrir o modelo
+#define SIM_RESET_CYCLES 16
+
+static VerilatedContext *context;
+static Vpdi_sim_top *top;
+static int sim_sck_half = SIM_SCK_HALF;
+
+static struct sim_stats {
+	uint64_t cycles;      // Ciclos de clk simulados
+	uint64_t link_cycles; // Ciclos com o link transferindo bytes
+	uint64_t link_bytes;
+	uint32_t frames;      // Execuções do PDI terminadas
+	uint64_t pdi_cycles;  // Ciclos com pdi_active, somados sobre os quadros
+	uint64_t pdi_start;
+	uint8_t pdi_active;
+} stats;
+
+// Fim de um PDI: ciclos medidos pelo harness e contadores latchados pelo img_processing
+static void sim_frame_done()
+{
+	uint64_t cycles = stats.cycles - stats.pdi_start;
+
+	stats.frames++;
+	stats.pdi_cycles += cycles;
+	printf("[sim] PDI %u: %llu ciclos com pdi_active | img_processing %u (binarizacao %u | "
+	       "morfologia %u | contorno %u | picos/classificacao %u)\n",
+	       stats.frames, (unsigned long long)cycles, top->cycles_total,
+	       top->cycles_binarization, top->cycles_morphology, top->cycles_contour,
+	       top->cycles_peaks);
+}
+
+// Um ciclo de clk; as BRAMs são escritas e lidas na borda de descida
+static void sim_tick()
+{
+	top->clk = 0;
+	top->eval();
+	context->timeInc(1);
+	top->clk = 1;
+	top->eval();
+	context->timeInc(1);
+	stats.cycles++;
+
+	if (top->pdi_active && !stats.pdi_active) {
+		stats.pdi_start = stats.cycles;
+	} else if (!top->pdi_active && stats.pdi_active) {
+		sim_frame_done();
+	}
+	stats.pdi_active = top->pdi_active;
+}
+
+static void sim_run(int cycles)
+{
+	while (cycles-- > 0) {
+		sim_tick();
+	}
+}
+
+/* Um byte com o slave já selecionado, MSB primeiro: MOSI muda com SCK baixo e MISO é lido depois
+ * da borda de subida, como em pio_receive_byte()
+ */
+static uint8_t sim_shift_byte(uint8_t byte_out)
+{
+	uint8_t byte_in = 0;
+
+	for (int i = 7; i >= 0; i--) {
+		top->mosi = (byte_out >> i) & 0x1;
+		top->sck = 0;
+		sim_run(sim_sck_half);
+		top->sck = 1;
+		sim_run(sim_sck_half);
+		byte_in |= (top->miso & 0x1) << i;
+	}
+	return byte_in;
+}
+
+// Volta ao estado do spi_change_to_default(): MOSI e SCK baixos, slave liberado
+static void sim_release()
+{
+	top->sck = 0;
+	top->mosi = 0;
+	top->ss = 1;
+	sim_run(sim_sck_half);
+}
+
+// Um byte sob SS baixo; SS volta a nível alto depois dele, como em pio_send_byte()
+static uint8_t sim_transfer(uint8_t byte_out)
+{
+	uint64_t start = stats.cycles;
+	uint8_t byte_in;
+
+	top->ss = 0;
+	byte_in = sim_shift_byte(byte_out);
+	sim_release();
+
+	stats.link_cycles += stats.cycles - start;
+	stats.link_bytes++;
+	return byte_in;
+}
+
+static int sim_open()
+{
+	const char *sck_half = getenv("PDI_SIM_SCK_HALF");
+
+	if (sck_half != NULL && atoi(sck_half) >= SIM_SCK_HALF) {
+		sim_sck_half = atoi(sck_half);
+	}
+
+	context = new VerilatedContext;
+	top = new Vpdi_sim_top{context};
+	stats = (struct sim_stats){};
+
+	// Reset em nível baixo com o slave liberado, como no spi_change_to_default()
+	top->rst = 0;
+	top->ss = 1;
+	top->sck = 0;
+	top->mosi = 0;
+	sim_run(SIM_RESET_CYCLES);
+	top->rst = 1;
+	sim_run(SIM_RESET_CYCLES);
+
+#if DEBUG == 1
+	printf("[sim] pdi_sim_top, meio periodo de SCK de %d ciclos\n", sim_sck_half);
+#endif
+	return 0;
+}
+
+static void sim_send_byte(uint8_t byte)
+{
+	sim_transfer(byte);
+}
+
+static uint8_t sim_receive_byte()
+{
+	return sim_transfer(0x00);
+}
+
+/* Versões em pacote, como pio_send_buffer() e pio_recv_buffer(): SS fica em nível baixo durante
+ * todo o buffer, então o spi_slave precisa recarregar o byte de saída entre os bytes
+ */
+static void sim_send_buffer(const uint8_t *buf, size_t len)
+{
+	uint64_t start = stats.cycles;
+
+	top->ss = 0;
+	for (size_t i = 0; i < len; i++) {
+		sim_shift_byte(buf[i]);
+	}
+	sim_release();
+
+	stats.link_cycles += stats.cycles - start;
+	stats.link_bytes += len;
+}
+
+static void sim_recv_buffer(uint8_t *buf, size_t len)
+{
+	uint64_t start = stats.cycles;
+
+	top->ss = 0;
+	for (size_t i = 0; i < len; i++) {
+		buf[i] = sim_shift_byte(0x00);
+	}
+	sim_release();
+
+	stats.link_cycles += stats.cycles - start;
+	stats.link_bytes += len;
+}
+
+static void sim_close()
+{
+	if (top == NULL) {
+		return;
+	}
+
+	printf("[sim] %llu ciclos (%llu us a %d MHz) | link %llu ciclos em %llu bytes | %u PDI, "
+	       "%llu ciclos por quadro\n",
+	       (unsigned long long)stats.cycles,
+	       (unsigned long long)(stats.cycles * 1000000 / PDI_CLOCK_HZ), PDI_CLOCK_HZ / 1000000,
+	       (unsigned long long)stats.link_cycles, (unsigned long long)stats.link_bytes,
+	       stats.frames, (unsigned long long)(stats.frames ? stats.pdi_cycles / stats.frames : 0));
+
+	top->final();
+	delete top;
+	delete context;
+	top = NULL;
+	context = NULL;
+}
+
+// pdi_done chega ao HPS pelo PIO pdi_irq; aqui o modelo roda até pdi_active cair
+static int sim_pdi_irq_arm()
+{
+	return 0;
+}
+
+static int sim_pdi_irq_wait(int timeout_ms)
+{
+	uint64_t limit = stats.cycles + (uint64_t)timeout_ms * (PDI_CLOCK_HZ / 1000);
+
+	while (top->pdi_active) {
+		if (stats.cycles >= limit) {
+			return -ETIMEDOUT;
+		}
+		sim_tick();
+	}
+	return 0;
+}
+
+const struct spi_transport spi_sim_transport = {
+	.name = "sim",
+	.open = sim_open,
+	.send = sim_send_byte,
+	.recv = sim_receive_byte,
+	.close = sim_close,
+	.send_buffer = sim_send_buffer,
+	.recv_buffer = sim_recv_buffer,
+	.write_channel = NULL,
+	.read_channel = NULL,
+	.read_mask = NULL,
+	.read_reg = NULL,
+	.write_reg = NULL,
+	.pdi_irq_arm = sim_pdi_irq_arm,
+	.pdi_irq_wait = sim_pdi_irq_wait,
+};
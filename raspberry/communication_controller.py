@@ -4,6 +4,16 @@ import numpy as np
 import spidev
 
 class CommunicationController:
+    # Stages of img_processing with a cycle counter and its clock (clk of top.v)
+    PDI_STAGES = ("binarization", "morphology", "contour", "peaks/classification")
+    FPGA_CLOCK_HZ = 50000000
+    # Result record of op 1111: (field, bytes)
+    RECORD_FIELDS = (("classification", 1), ("peaks", 2), ("area", 3), ("perimeter", 3),
+                     ("max_distance", 5), ("reference_x", 2), ("reference_y", 2), ("cycles", 4))
+    RECORD_BYTES = 22
+    # Cb and Cr ranges binarized as skin by img_processing (stream_bit)
+    CB_RANGE = (90, 120)
+    CR_RANGE = (139, 170)
 
     def __init__(self, height: int, width: int) -> None:
         self.spi = spidev.SpiDev()
@@ -13,6 +23,8 @@ class CommunicationController:
 
         self.height = height
         self.width = width
+        # Crop (x, y, w, h) of the last upload, the whole frame by default
+        self.roi = (0, 0, width, height)
 
     def sendbyte(self, byte_to_send: list[int]) -> list[int]:
         # time.sleep(self.delay_time)
@@ -21,7 +33,7 @@ class CommunicationController:
         # print("Byte enviado:  {:08b}".format(byte_to_send), "Byte recebido: {:08b}".format(received))
         return received
 
-    def send_img(self, img: np.ndarray, channel: int = 0b10) -> np.ndarray:
+    def send_img(self, img: np.ndarray, channel: int = 0b10, origin: tuple = None) -> np.ndarray:
         initial_time = time.time()
 
         height, width = img.shape[0:2]
@@ -32,9 +44,19 @@ class CommunicationController:
         #                 int(height_bytes[0]), int(height_bytes[1]),
         #                 int(width_bytes[0]), int(width_bytes[1])])
 
-        self.spi.writebytes([0, int(0b00000100 | channel),
-                        int(height_bytes[0]), int(height_bytes[1]),
-                        int(width_bytes[0]), int(width_bytes[1])])
+        if origin is None:
+            self.spi.writebytes([0, int(0b00000100 | channel),
+                            int(height_bytes[0]), int(height_bytes[1]),
+                            int(width_bytes[0]), int(width_bytes[1])])
+        else:
+            # ROI upload (1010): row and column of the crop before its height and width
+            y_bytes = self.toUnint8(origin[1], 2)
+            x_bytes = self.toUnint8(origin[0], 2)
+            self.spi.writebytes([0, int(0b00101000 | channel),
+                            int(y_bytes[0]), int(y_bytes[1]),
+                            int(x_bytes[0]), int(x_bytes[1]),
+                            int(height_bytes[0]), int(height_bytes[1]),
+                            int(width_bytes[0]), int(width_bytes[1])])
 
         # self.spi.xfer([0])
         # print(0)
@@ -76,7 +98,8 @@ class CommunicationController:
 
         pixels_array = []
 
-        for i in range(76800):
+        height, width = self.roi[3], self.roi[2]
+        for i in range(height * width):
             result = self.spi.xfer([0])
             # print(result)
             # print(i, bin(result[0]))
@@ -97,34 +120,100 @@ class CommunicationController:
         #     pixels_array.extend(result)
         
         pixels_array = np.array(pixels_array, dtype=np.uint8)
-        new_img = pixels_array.reshape(240, 320)
+        new_img = pixels_array.reshape(height, width)
 
         self.spi.writebytes([0])
         return new_img
     
-    def send_rgb_img(self, img: np.ndarray) -> None:
+    def crop(self, img: np.ndarray, roi: tuple = None) -> tuple:
+        # Only the crop (x, y, w, h) is sent and processed
+        origin = None
+        self.roi = (0, 0, self.width, self.height)
+        if roi is not None:
+            x, y, w, h = roi
+            img = img[y:y + h, x:x + w]
+            origin = (x, y)
+            self.roi = roi
+        return img, origin
+
+    def send_rgb_img(self, img: np.ndarray, roi: tuple = None) -> None:
         initial_time = time.time()
 
+        img, origin = self.crop(img, roi)
         channel_b, channel_g, channel_r = cv2.split(img)
 
         print("Sending red")
-        self.send_img(channel_r, 0b01)
+        self.send_img(channel_r, 0b01, origin)
         # time.sleep(2)
         print("Sending green")
-        self.send_img(channel_g, 0b10)
+        self.send_img(channel_g, 0b10, origin)
         # time.sleep(2)
         print("Sending blue")
-        self.send_img(channel_b, 0b11)
+        self.send_img(channel_b, 0b11, origin)
         # time.sleep(2)
 
         send_time = time.time() - initial_time
         print(f"All channels sended in: {send_time}")
 
-    def run_pdi(self) -> None:
+    def chroma_planes(self, img: np.ndarray) -> tuple:
+        # Cb and Cr of the BGR image with the fixed point compensation and conversion of
+        # img_processing (integer means from the upload sums, penultimate pixel uncompensated),
+        # so that the FPGA binarizes them into the same mask
+        height, width = img.shape[0:2]
+        channel_b, channel_g, channel_r = (c.flatten().astype(np.int32) for c in cv2.split(img))
+        pixels = height * width
+
+        means = [int(c.sum()) // pixels for c in (channel_r, channel_g, channel_b)]
+        mean_r, mean_g, mean_b = means
+        if mean_r > mean_g and mean_r > mean_b:
+            max_mean = mean_r
+        elif mean_g > mean_r and mean_g > mean_b:
+            max_mean = mean_g
+        else:
+            max_mean = mean_b
+
+        compensated = []
+        for channel, mean in zip((channel_r, channel_g, channel_b), means):
+            # The combinational divider gives all ones when dividing by zero
+            comp = (channel * mean) // max_mean if max_mean else np.full_like(channel, 0xFF)
+            if pixels >= 2:
+                comp[-2] = channel[-2]
+            compensated.append(comp & 0xFF)
+        r, g, b = compensated
+
+        cb = (128 + ((-38 * r - 74 * g + 112 * b) >> 8)) & 0xFF
+        cr = (128 + ((112 * r - 94 * g - 18 * b) >> 8)) & 0xFF
+        # The RGB path does not binarize the last pixel, it is skin when its compensated red is
+        # not 0: encode that as a Cb/Cr inside or outside the skin ranges
+        skin = r[-1] != 0
+        cb[-1] = self.CB_RANGE[0] if skin else 0
+        cr[-1] = self.CR_RANGE[0] if skin else 0
+
+        return (cb.astype(np.uint8).reshape(height, width),
+                cr.astype(np.uint8).reshape(height, width))
+
+    def send_chroma_img(self, img: np.ndarray, roi: tuple = None) -> None:
+        # Chroma upload: compensation and YCbCr run here and only Cb (green channel) and Cr
+        # (blue channel) go through the link, a third less bytes; start it with run_pdi(True)
+        initial_time = time.time()
+
+        img, origin = self.crop(img, roi)
+        channel_cb, channel_cr = self.chroma_planes(img)
+
+        print("Sending Cb")
+        self.send_img(channel_cb, 0b10, origin)
+        print("Sending Cr")
+        self.send_img(channel_cr, 0b11, origin)
+
+        send_time = time.time() - initial_time
+        print(f"Chroma channels sended in: {send_time}")
+
+    def run_pdi(self, chroma: bool = False) -> None:
 
         initial_time = time.time()
 
-        self.spi.writebytes([0, int(0b00001100), 0, 0])
+        # Channel bits 01 start PDI on a chroma frame (send_chroma_img)
+        self.spi.writebytes([0, int(0b00001100 | (0b01 if chroma else 0b00)), 0, 0])
 
         print("PDI on FPGA")
         pdi_running = False
@@ -141,6 +230,83 @@ class CommunicationController:
         pdi_time = time.time() - initial_time
         print(f"PDI in FPGA finished in: {pdi_time}")
         
+    def recive_geometry(self) -> tuple[int, int]:
+        # Geometry in use by the FPGA (op 1001): sizes above the synthesized frame are replaced
+        self.spi.writebytes([0, int(0b00100100), 0])
+        received = self.spi.readbytes(4)
+        self.spi.writebytes([0])
+        geometry = int.from_bytes(received, "big")
+        return geometry >> 16, geometry & 0xFFFF
+
+    def recive_mask(self) -> np.ndarray:
+        # Binary mask of the last PDI (1000), 8 pixels per byte, with the crop geometry
+        height, width = self.roi[3], self.roi[2]
+        self.spi.writebytes([0, int(0b00100000), 0])
+        packed = []
+        remaining = (height * width + 7) // 8
+        while remaining:  # spidev transfers up to 4096 bytes
+            chunk = min(remaining, 4096)
+            packed.extend(self.spi.readbytes(chunk))
+            remaining -= chunk
+        packed = np.array(packed, dtype=np.uint8)
+        self.spi.writebytes([0])
+        bits = np.unpackbits(packed, bitorder="little")[:height * width]
+        return bits.reshape(height, width)
+
+    def recive_hand_box(self) -> tuple:
+        # Dilated hand box of the last PDI (1100 top left, 1101 bottom right) in the camera image
+        corners = []
+        for op in (0b00110000, 0b00110100):
+            self.spi.writebytes([0, int(op), 0])
+            received = self.spi.readbytes(4)
+            self.spi.writebytes([0])
+            corners.append(int.from_bytes(received, "big"))
+        top, left = corners[0] >> 16, corners[0] & 0xFFFF
+        bottom, right = corners[1] >> 16, corners[1] & 0xFFFF
+        if left > right or top > bottom:  # No hand pixels
+            return None
+        return (self.roi[0] + left, self.roi[1] + top, right - left + 1, bottom - top + 1)
+
+    def next_roi(self, box: tuple, margin: int = 16) -> tuple:
+        # Hand box of the last PDI plus a margin, down to the last row where the contour starts
+        if box is None:
+            return (0, 0, self.width, self.height)
+        x0 = max(box[0] - margin, 0)
+        x1 = min(box[0] + box[2] - 1 + margin, self.width - 1)
+        y0 = max(box[1] - margin, 0)
+        return (x0, y0, x1 - x0 + 1, self.height - y0)
+
+    def recive_cycles(self) -> list[int]:
+        # Clock cycles of each PDI stage in the last frame (op 1110, stage in the channel bits)
+        cycles = []
+        for stage in range(len(self.PDI_STAGES)):
+            self.spi.writebytes([0, int(0b00111000 | stage), 0])
+            received = self.spi.readbytes(4)
+            self.spi.writebytes([0])
+            cycles.append(int.from_bytes(received, "big"))
+        return cycles
+
+    def print_cycles(self) -> list[int]:
+        cycles = self.recive_cycles()
+        stages = " | ".join(f"{name} {count}" for name, count in zip(self.PDI_STAGES, cycles))
+        # Hardware counter from activation to the end; the sum of the stages is only a check
+        total = self.recive_results()["cycles"]
+        print(f"FPGA cycles: {stages} | total {total} ({total * 1e6 / self.FPGA_CLOCK_HZ:.0f} us)"
+              f" | stage sum {sum(cycles)}")
+        return cycles
+
+    def recive_results(self) -> dict:
+        # Every result of the last PDI in one transaction (op 1111), MSB first
+        self.spi.writebytes([0, int(0b00111100), 0])
+        record = bytes(self.spi.readbytes(self.RECORD_BYTES))
+        self.spi.writebytes([0])
+        results = {}
+        offset = 0
+        for name, size in self.RECORD_FIELDS:
+            results[name] = int.from_bytes(record[offset:offset + size], "big")
+            offset += size
+        return results
+
     def recive_int_32bits(self, command: int = 0b00) -> int:
         self.spi.writebytes([0, int(0b00010000 | (command<<2)), 0])
         received = []
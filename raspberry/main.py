@@ -47,31 +47,40 @@ def rasp_pdi(img):
     print(f"PDI in rasp finished in: {mean_time}")
     # cv2.imshow("rpi_img", img)
 
-def fpga_pdi(img, height, width):
+def fpga_pdi(img, height, width, roi=None, chroma=False):
     global com
     initial_time = time.time()
     com = CommunicationController(height, width)
 
-    com.send_rgb_img(img)
+    # chroma -> only the Cb and Cr planes, computed here, are sent
+    if chroma:
+        com.send_chroma_img(img, roi)
+    else:
+        com.send_rgb_img(img, roi)
+
+    fpga_height, fpga_width = com.recive_geometry()
+    if (fpga_width, fpga_height) != com.roi[2:4]:
+        print(f"FPGA refused geometry {com.roi[2]}x{com.roi[3]}, using {fpga_width}x{fpga_height}")
+        com.close_communication()
+        return
 
     print("Image send")
     time.sleep(2)
 
-    com.run_pdi()
+    com.run_pdi(chroma)
     # time.sleep(2)
 
-    new_img_r = com.recive_img(0b01)
-    new_img_g = com.recive_img(0b10)
-    new_img_b = com.recive_img(0b11)
-    new_img = cv2.merge([new_img_b, new_img_g, new_img_r])
-    
-    hand_area = com.recive_int_32bits(0b00)
-    hand_perimeter = com.recive_int_32bits(0b01)
-    print(f"FPGA - Area: {hand_area}, Perimeter: {hand_perimeter}")
-    peaks = com.recive_int_32bits(0b10)
-    print(f"FPGA - peaks: {peaks}")
+    # Binary mask of the hand, 0/1 per pixel
+    mask = com.recive_mask()
 
-    classification = com.recive_int_32bits(0b11)
+    results = com.recive_results()
+    print(f"FPGA - Area: {results['area']}, Perimeter: {results['perimeter']}")
+    print(f"FPGA - peaks: {results['peaks']}")
+    print(f"FPGA - max distance: {results['max_distance']}, "
+          f"reference point: ({results['reference_x']}, {results['reference_y']}), "
+          f"cycles: {results['cycles']}")
+
+    classification = results["classification"]
     # print(classification)
     if (classification == 1):
         print("FPGA Classification: One finger up")
@@ -88,15 +97,23 @@ def fpga_pdi(img, height, width):
     else:
         print("FPGA Classification: Not recognized")
 
+    com.print_cycles()
+
+    # Crop of the next frame around the hand of this one
+    next_roi = com.next_roi(com.recive_hand_box())
+    print(f"FPGA - next ROI: {next_roi}")
+
     com.close_communication()
 
     fpga_time = time.time() - initial_time
     print(f"FPGA finished in: {fpga_time}")
-    cv2.imshow("fpga_img", new_img)
+    cv2.imshow("fpga_img", mask * 255)
+    return next_roi
 
 def main():
     height = 240
     width = 320
+    frames = 3
 
     img_select = 2
 
@@ -121,7 +138,12 @@ def main():
     # cv2.waitKey(0)
     # cv2.destroyAllWindows()
 
-    fpga_pdi(img, height, width)
+    # The same image stands in for the camera: each frame is cropped around the hand found in the
+    # previous one, the first one (and any frame after a refused geometry) is the full image
+    roi = None
+    for frame in range(frames):
+        print(f"Frame {frame + 1}, ROI: {roi}")
+        roi = fpga_pdi(img, height, width, roi)
 
     print("\n")
 
@@ -49,32 +49,77 @@ class RaspPDI:
 
         return mask
     
+    # Packed binary masks: one bit per pixel, pixel x of a row in bit x % 64 of word x // 64 and
+    # the bits past the width at 0, so the kernels below handle 64 pixels per word operation
+    def pack_mask(self, img: np.ndarray) -> np.ndarray:
+        height, width = img.shape[0:2]
+        words = (width + 63) // 64
+        packed = np.zeros((height, words * 8), dtype=np.uint8)
+        packed[:, :(width + 7) // 8] = np.packbits(img > 0, axis=1, bitorder='little')
+        return packed.view('<u8')
+
+    def unpack_mask(self, packed: np.ndarray, width: int) -> np.ndarray:
+        bits = np.unpackbits(packed.view(np.uint8), axis=1, bitorder='little')[:, :width]
+        return bits * np.uint8(255)
+
+    def valid_bits(self, width: int) -> np.ndarray:
+        # Bits of the pixels inside the row, word by word
+        bits = np.zeros((width + 63) // 64 * 64, dtype=np.uint8)
+        bits[:width] = 1
+        return np.packbits(bits, bitorder='little').view('<u8')
+
+    def popcount(self, words: np.ndarray) -> int:
+        if hasattr(np, "bitwise_count"):
+            return int(np.bitwise_count(words).sum())
+        return int(np.unpackbits(words.view(np.uint8)).sum())
+
+    def cross_kernel(self, packed: np.ndarray, width: int, dilate: bool) -> np.ndarray:
+        # 5-point cross from the rows above and below and the words shifted by one bit, with the
+        # bit shifted in taken from the neighbouring word. Pixels outside the image count as 1 in
+        # the erosion and 0 in the dilation, like the default borders of cv2.erode/cv2.dilate
+        one = np.uint64(1)
+        msb = np.uint64(63)
+        valid = self.valid_bits(width)
+        outside = np.uint64(0) if dilate else np.uint64(1)
+        fill = np.uint64(0) if dilate else ~np.uint64(0)
+        height = packed.shape[0]
+
+        src = packed | (~valid & fill)
+        edge_row = np.full((1, src.shape[1]), fill, dtype=np.uint64)
+        edge_col = np.full((height, 1), outside, dtype=np.uint64)
+        up = np.vstack((edge_row, src[:-1]))
+        down = np.vstack((src[1:], edge_row))
+        west = (src << one) | np.hstack((edge_col, src[:, :-1] >> msb))
+        east = (src >> one) | (np.hstack((src[:, 1:], edge_col)) << msb)
+
+        if dilate:
+            return (up | down | west | src | east) & valid
+        return up & down & west & src & east & valid
+
     def filtering(self, img):
-        kernel = np.array([
-            [0, 1, 0],
-            [1, 1, 1],
-            [0, 1, 0]
-        ], dtype=np.uint8)
+        width = img.shape[1]
+        packed = self.pack_mask(img)
 
-        eroded_img = cv2.erode(img, kernel, iterations=1)
-        dilated_img = cv2.dilate(eroded_img, kernel, iterations=1)
+        eroded = self.cross_kernel(packed, width, dilate=False)
+        dilated = self.cross_kernel(eroded, width, dilate=True)
 
-        return dilated_img
+        return self.unpack_mask(dilated, width)
     
     def hand_area_perimeter(self, img):
-        area = 0
-        perimeter = 0
-        prev_pixel = 0
-        
+        # Area by popcount; perimeter as the transitions between consecutive pixels in scan
+        # order, with the last pixel of a row before the first of the next and a 0 before the first
         height, width = img.shape[0:2]
-        
-        for i in range(height):
-            for j in range(width):
-                if img[i, j] == 255:
-                    area += 1
-                if img[i, j] != prev_pixel:
-                    perimeter += 1
-                prev_pixel = img[i, j]
+        one = np.uint64(1)
+        packed = self.pack_mask(img)
+        valid = self.valid_bits(width)
+
+        last_pixels = (packed[:, (width - 1) // 64] >> np.uint64((width - 1) % 64)) & one
+        row_carry = np.concatenate(([0], last_pixels[:-1])).astype(np.uint64)
+        carry = np.hstack((row_carry[:, None], packed[:, :-1] >> np.uint64(63)))
+        transitions = (packed ^ ((packed << one) | carry)) & valid
+
+        area = self.popcount(packed)
+        perimeter = self.popcount(transitions)
                 
         return area, perimeter
     